@@ -0,0 +1,393 @@
+/*** batch driver, solves many SCP instances on a pool of worker threads
+
+A loader thread reads the instances in order into a bounded queue, so that the next
+instances are loaded while the workers solve the current ones. Each worker owns its
+result handle and writes one line per instance as soon as its solve is done.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "batch.h"
+
+typedef struct {
+	char *path;
+	int upperbound;
+} batch_job;
+
+// instance loaded (and presolved) for jobs[job], inst is NULL if loading failed
+typedef struct {
+	int job;
+	scp_instance *inst;
+	scp_instance *orig; 	// instance inst was presolved from, or NULL
+	double load_t;
+} loaded_instance;
+
+typedef struct {
+	const batch_options *opt;
+	batch_job *jobs;
+	int num_jobs;
+
+	loaded_instance *queue; 	// ring buffer filled by the loader
+	int queue_cap, queue_head, queue_size;
+	unsigned char loading_done;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty, not_full;
+
+	FILE *out;
+	pthread_mutex_t out_lock;
+	int num_failed;
+} batch_ctx;
+
+
+static double elapsed(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) * 1e-9;
+}
+
+
+static int compare_jobs(const void *a, const void *b)
+{
+	return strcmp(((const batch_job *) a)->path, ((const batch_job *) b)->path);
+}
+
+
+static void free_jobs(batch_job *jobs, int num_jobs)
+{
+	int i;
+
+	for (i = 0; i < num_jobs; i++) {
+		free(jobs[i].path);
+	}
+	free(jobs);
+}
+
+
+/* Appends job for path to the job list.
+Returns 0 on success, otherwise returns -1. */
+static int add_job(batch_job **jobs, int *num_jobs, int *cap, const char *path, int upperbound)
+{
+	batch_job *p;
+
+	if (*num_jobs == *cap) {
+		*cap = *cap ? 2 * *cap : 64;
+		if ((p = (batch_job *) realloc(*jobs, *cap * sizeof(batch_job))) == NULL) {
+			perror("Error realloc");
+			return -1;
+		}
+		*jobs = p;
+	}
+	if (((*jobs)[*num_jobs].path = strdup(path)) == NULL) {
+		perror("Error malloc");
+		return -1;
+	}
+	(*jobs)[*num_jobs].upperbound = upperbound;
+	(*num_jobs)++;
+	return 0;
+}
+
+
+/* Collects the jobs of a directory or manifest file.
+Returns number of jobs, or -1 on failure. */
+static int read_jobs(const char *input, int upperbound, batch_job **jobs)
+{
+	int num_jobs = 0, cap = 0, ub;
+	char *line = NULL, *path, *end, *save_ptr;
+	size_t line_size = 0;
+	struct stat st;
+	struct dirent *entry;
+	DIR *dir;
+	FILE *fp;
+
+	*jobs = NULL;
+	if (stat(input, &st)) {
+		perror(input);
+		return -1;
+	}
+
+	if (S_ISDIR(st.st_mode)) {
+		if ((dir = opendir(input)) == NULL) {
+			perror(input);
+			return -1;
+		}
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry->d_name[0] == '.') continue;
+			if ((path = (char *) malloc(strlen(input) + strlen(entry->d_name) + 2)) == NULL) {
+				perror("Error malloc");
+				closedir(dir);
+				free_jobs(*jobs, num_jobs);
+				return -1;
+			}
+			sprintf(path, "%s/%s", input, entry->d_name);
+			if (stat(path, &st) == 0 && S_ISREG(st.st_mode)
+				&& add_job(jobs, &num_jobs, &cap, path, upperbound)) {
+				free(path);
+				closedir(dir);
+				free_jobs(*jobs, num_jobs);
+				return -1;
+			}
+			free(path);
+		}
+		closedir(dir);
+		qsort(*jobs, num_jobs, sizeof(batch_job), compare_jobs);
+		return num_jobs;
+	}
+
+	if ((fp = fopen(input, "r")) == NULL) {
+		perror(input);
+		return -1;
+	}
+	while (getline(&line, &line_size, fp) != -1) {
+		if ((end = strchr(line, '#')) != NULL) *end = '\0';
+		if ((path = strtok_r(line, " \t\r\n", &save_ptr)) == NULL) continue;
+		ub = upperbound;
+		if ((end = strtok_r(NULL, " \t\r\n", &save_ptr)) != NULL) ub = atoi(end);
+		if (add_job(jobs, &num_jobs, &cap, path, ub)) {
+			free_jobs(*jobs, num_jobs);
+			num_jobs = -1;
+			break;
+		}
+	}
+	free(line);
+	fclose(fp);
+	return num_jobs;
+}
+
+
+static scp_instance *load_instance(const char *path)
+{
+	size_t len = strlen(path);
+
+	if (len > 5 && strcmp(path + len - 5, ".scpb") == 0) {
+		return load_scp_instance_bin_r(path);
+	}
+	return load_scp_instance_mmap_r(path);
+}
+
+
+// writes s as JSON string
+static void write_json_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(out, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			fprintf(out, "\\u%04x", *s);
+		} else {
+			fputc(*s, out);
+		}
+	}
+	fputc('"', out);
+}
+
+
+/* Writes result line of one instance. status is "ok", "load_error" or "solve_error",
+the remaining fields only apply to solved instances. */
+static void write_result(batch_ctx *ctx, const char *path, const char *status, double bound,
+	int num_itr, double load_t, double wall_t, double cpu_t)
+{
+	struct rusage usage;
+	const char *method = ctx->opt->use_basic ? "bsm" : "sps";
+	unsigned char solved = strcmp(status, "ok") == 0;
+	FILE *out = ctx->out;
+
+	// peak resident memory of the whole process so far, not of this instance
+	getrusage(RUSAGE_SELF, &usage);
+
+	pthread_mutex_lock(&ctx->out_lock);
+	if (ctx->opt->format == BATCH_JSONL) {
+		fprintf(out, "{\"instance\":");
+		write_json_string(out, path);
+		fprintf(out, ",\"method\":\"%s\",\"status\":\"%s\"", method, status);
+		if (solved) {
+			fprintf(out, ",\"bound\":%.6f,\"iterations\":%d", bound, num_itr);
+		}
+		fprintf(out, ",\"load_s\":%.6f,\"wall_s\":%.6f,\"cpu_s\":%.6f,\"process_peak_rss_kb\":%ld}\n",
+			load_t, wall_t, cpu_t, usage.ru_maxrss);
+	} else if (solved) {
+		fprintf(out, "%s,%s,%s,%.6f,%d,%.6f,%.6f,%.6f,%ld\n", path, method, status,
+			bound, num_itr, load_t, wall_t, cpu_t, usage.ru_maxrss);
+	} else {
+		fprintf(out, "%s,%s,%s,,,%.6f,,,%ld\n", path, method, status, load_t, usage.ru_maxrss);
+	}
+	fflush(out);
+	if (!solved) ctx->num_failed++;
+	pthread_mutex_unlock(&ctx->out_lock);
+}
+
+
+static void *loader_main(void *arg)
+{
+	int i;
+	loaded_instance item;
+	struct timespec begin_t, end_t;
+	batch_ctx *ctx = (batch_ctx *) arg;
+
+	for (i = 0; i < ctx->num_jobs; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &begin_t);
+		item.job = i;
+		item.inst = load_instance(ctx->jobs[i].path);
+		item.orig = NULL;
+		if (ctx->opt->presolve && item.inst != NULL) {
+			item.orig = item.inst;
+			if ((item.inst = presolve_scp_instance_r(item.orig, NULL)) == NULL) {
+				free_scp_instance_r(item.orig);
+				item.orig = NULL;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end_t);
+		item.load_t = elapsed(&begin_t, &end_t);
+
+		pthread_mutex_lock(&ctx->lock);
+		while (ctx->queue_size == ctx->queue_cap) {
+			pthread_cond_wait(&ctx->not_full, &ctx->lock);
+		}
+		ctx->queue[(ctx->queue_head + ctx->queue_size) % ctx->queue_cap] = item;
+		ctx->queue_size++;
+		pthread_cond_signal(&ctx->not_empty);
+		pthread_mutex_unlock(&ctx->lock);
+	}
+
+	pthread_mutex_lock(&ctx->lock);
+	ctx->loading_done = 1;
+	pthread_cond_broadcast(&ctx->not_empty);
+	pthread_mutex_unlock(&ctx->lock);
+	return NULL;
+}
+
+
+static void *worker_main(void *arg)
+{
+	loaded_instance item;
+	scp_result *res;
+	scp_params params;
+	double bound;
+	struct timespec begin_t, end_t, cpu_begin, cpu_end;
+	clockid_t cpu_clock;
+	batch_ctx *ctx = (batch_ctx *) arg;
+
+	for (;;) {
+		pthread_mutex_lock(&ctx->lock);
+		while (ctx->queue_size == 0 && !ctx->loading_done) {
+			pthread_cond_wait(&ctx->not_empty, &ctx->lock);
+		}
+		if (ctx->queue_size == 0) {
+			pthread_mutex_unlock(&ctx->lock);
+			break;
+		}
+		item = ctx->queue[ctx->queue_head];
+		ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_cap;
+		ctx->queue_size--;
+		pthread_cond_signal(&ctx->not_full);
+		pthread_mutex_unlock(&ctx->lock);
+
+		if (item.inst == NULL) {
+			write_result(ctx, ctx->jobs[item.job].path, "load_error", 0, 0, item.load_t, 0, 0);
+			continue;
+		}
+		if ((res = create_scp_result(item.inst)) == NULL) {
+			write_result(ctx, ctx->jobs[item.job].path, "solve_error", 0, 0, item.load_t, 0, 0);
+			free_scp_instance_r(item.inst);
+			free_scp_instance_r(item.orig);
+			continue;
+		}
+
+		params = ctx->opt->params;
+		params.upperbound = ctx->jobs[item.job].upperbound;
+
+		// thread cpu time misses the OpenMP threads of the solve, which the process cpu time
+		// covers (along with the concurrent solves of the other workers)
+		cpu_clock = params.num_threads == 1 ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID;
+		clock_gettime(CLOCK_MONOTONIC, &begin_t);
+		clock_gettime(cpu_clock, &cpu_begin);
+		if (ctx->opt->use_basic) {
+			bound = basic_subgradient_ex(item.inst, res, &params);
+		} else {
+			bound = spectral_projected_subgradient_ex(item.inst, res, &params);
+		}
+		clock_gettime(cpu_clock, &cpu_end);
+		clock_gettime(CLOCK_MONOTONIC, &end_t);
+
+		write_result(ctx, ctx->jobs[item.job].path, bound < 0 ? "solve_error" : "ok", bound,
+			get_num_itr_r(res), item.load_t, elapsed(&begin_t, &end_t),
+			elapsed(&cpu_begin, &cpu_end));
+
+		free_scp_result(res);
+		free_scp_instance_r(item.inst);
+		free_scp_instance_r(item.orig);
+	}
+	return NULL;
+}
+
+
+/* Solves every instance of input, which is either a directory (all regular files in
+name order) or a manifest file (one "path [upperbound]" per line, # starts a comment).
+Up to num_workers instances are loaded ahead of the workers, and a result line is written
+to out as each solve finishes.
+Returns 0 if all instances were solved, otherwise returns -1. */
+int run_batch(const char *input, const batch_options *opt, FILE *out)
+{
+	int i, num_workers, num_started, ret = -1;
+	pthread_t loader, *workers = NULL;
+	batch_ctx ctx;
+
+	memset(&ctx, 0, sizeof(batch_ctx));
+	ctx.opt = opt;
+	ctx.out = out;
+	if ((ctx.num_jobs = read_jobs(input, opt->params.upperbound, &ctx.jobs)) < 0) goto cleanup;
+
+	num_workers = opt->num_workers > 0 ? opt->num_workers : 1;
+	ctx.queue_cap = num_workers;
+	if ((ctx.queue = (loaded_instance *) malloc(ctx.queue_cap * sizeof(loaded_instance))) == NULL
+		|| (workers = (pthread_t *) malloc(num_workers * sizeof(pthread_t))) == NULL) {
+		perror("Error malloc");
+		goto cleanup;
+	}
+	pthread_mutex_init(&ctx.lock, NULL);
+	pthread_mutex_init(&ctx.out_lock, NULL);
+	pthread_cond_init(&ctx.not_empty, NULL);
+	pthread_cond_init(&ctx.not_full, NULL);
+
+	if (opt->format == BATCH_CSV) {
+		fprintf(out, "instance,method,status,bound,iterations,load_s,wall_s,cpu_s,process_peak_rss_kb\n");
+	}
+
+	if (pthread_create(&loader, NULL, loader_main, &ctx)) {
+		perror("Error pthread_create");
+		goto destroy;
+	}
+	for (num_started = 0; num_started < num_workers; num_started++) {
+		if (pthread_create(&workers[num_started], NULL, worker_main, &ctx)) {
+			perror("Error pthread_create");
+			break;
+		}
+	}
+	if (num_started == 0) {
+		// nobody drains the queue, run one worker here
+		worker_main(&ctx);
+	}
+	for (i = 0; i < num_started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	pthread_join(loader, NULL);
+	ret = ctx.num_failed ? -1 : 0;
+
+destroy:
+	pthread_mutex_destroy(&ctx.lock);
+	pthread_mutex_destroy(&ctx.out_lock);
+	pthread_cond_destroy(&ctx.not_empty);
+	pthread_cond_destroy(&ctx.not_full);
+
+cleanup:
+	if (ctx.num_jobs > 0) free_jobs(ctx.jobs, ctx.num_jobs);
+	free(ctx.queue);
+	free(workers);
+	return ret;
+}
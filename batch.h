@@ -0,0 +1,31 @@
+/*** batch driver, solves many SCP instances on a pool of worker threads ***/
+
+#ifndef Batch_h
+#define Batch_h
+
+#include <stdio.h>
+#include "subgradient.h"
+
+#define BATCH_CSV 	1
+#define BATCH_JSONL 	2
+
+typedef struct {
+	scp_params params; 		// solver settings, upperbound is the default for BSM
+	unsigned char use_basic; 	// basic subgradient instead of SPS
+	int num_workers; 		// concurrent solves
+	unsigned char format; 		// BATCH_CSV or BATCH_JSONL
+	unsigned char presolve; 	// presolve each instance, counted in its load time
+} batch_options;
+
+/* Solves every instance of input, which is either a directory (all regular files in
+name order) or a manifest file (one "path [upperbound]" per line, # starts a comment).
+Up to num_workers instances are loaded ahead of the workers, and a result line is written
+to out as each solve finishes. Its cpu_s is the cpu time of the solving thread if
+params.num_threads is 1, otherwise of the whole process during the solve (OpenMP threads
+included, and so are concurrent solves of other workers); process_peak_rss_kb is the peak
+resident memory of the process when the line is written, a high-water mark of the batch
+so far rather than a figure of the instance.
+Returns 0 if all instances were solved, otherwise returns -1. */
+int run_batch(const char *input, const batch_options *opt, FILE *out);
+
+#endif /* Batch_h */
@@ -0,0 +1,216 @@
+/*** check of the bounds of fixed subproblems against brute force
+
+usage: check_fixing [-n instances] [-f fixings] [-s seed]
+
+Small random instances (up to 14 columns) are solved under random column fixings by SPS
+and BSM, on the instance itself (also read into the compact layout), its fixable presolve
+and the reordered presolve. A bound above the optimum of the fixed subproblem, found by
+enumerating all column subsets, cuts off that subproblem in branch and bound and is
+reported. Subproblems with an uncoverable row have no optimum and are skipped. Also checks
+that the instances of the full presolve refuse fixings. Returns 1 if anything was reported.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "subgradient.h"
+
+#define MAX_ROW     8
+#define MAX_COL     14
+#define MAX_COST    20
+#define MAX_ITR     500
+#define BOUND_TOL   1e-6
+
+static int num_row, num_col;
+static int costs[MAX_COL];
+static int row_cols[MAX_ROW];   // bit mask of the columns of each row
+static int fixing[MAX_COL];     // 0 (free), SCP_FIX_0 or SCP_FIX_1
+
+
+/* Writes the instance to a temporary file in the OR-library format and loads it with load.
+Returns NULL on failure. */
+static scp_instance *load_instance(scp_instance *(*load)(const char *))
+{
+	char filename[] = "/tmp/check_fixing_XXXXXX";
+	int fd, i, j, size;
+	FILE *fp;
+	scp_instance *inst;
+
+	if ((fd = mkstemp(filename)) == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		perror(filename);
+		return NULL;
+	}
+	fprintf(fp, "%d %d\n", num_row, num_col);
+	for (j = 0; j < num_col; j++) fprintf(fp, "%d ", costs[j]);
+	fprintf(fp, "\n");
+	for (i = 0; i < num_row; i++) {
+		size = __builtin_popcount(row_cols[i]);
+		fprintf(fp, "%d\n", size);
+		for (j = 0; j < num_col; j++) {
+			if (row_cols[i] >> j & 1) fprintf(fp, "%d ", j + 1);
+		}
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+	inst = load(filename);
+	unlink(filename);
+	return inst;
+}
+
+
+static void random_instance()
+{
+	int i, j;
+
+	num_row = 3 + rand() % (MAX_ROW - 2);
+	num_col = 6 + rand() % (MAX_COL - 5);
+	for (j = 0; j < num_col; j++) costs[j] = 1 + rand() % MAX_COST;
+	for (i = 0; i < num_row; i++) {
+		row_cols[i] = 0;
+		for (j = 0; j < num_col; j++) {
+			if (rand() % 3 == 0) row_cols[i] |= 1 << j;
+		}
+		if (row_cols[i] == 0) row_cols[i] = 1 << (rand() % num_col);
+	}
+}
+
+
+/* Returns the optimum of the instance under fixing, or -1 if a row cannot be covered. */
+static int brute_force()
+{
+	int i, j, set, cost, best = -1;
+	int must = 0, allowed = 0;
+
+	for (j = 0; j < num_col; j++) {
+		must |= (fixing[j] == SCP_FIX_1) << j;
+		allowed |= (fixing[j] != SCP_FIX_0) << j;
+	}
+	for (set = 0; set < 1 << num_col; set++) {
+		if ((set & must) != must || (set & ~allowed)) continue;
+		for (i = 0; i < num_row && (set & row_cols[i]); i++) {
+			// covered
+		}
+		if (i < num_row) continue;
+		for (cost = 0, j = 0; j < num_col; j++) {
+			if (set >> j & 1) cost += costs[j];
+		}
+		if (best < 0 || cost < best) best = cost;
+	}
+	return best;
+}
+
+
+/* Solves inst under fixing with both methods and compares the bounds with optimum.
+Returns number of bounds above the optimum. */
+static int check_bounds(scp_instance *inst, scp_result *res, const char *variant,
+	int instance, int optimum)
+{
+	int j, bad = 0;
+	double sps, bsm;
+
+	for (j = 0; j < num_col; j++) {
+		if (fixing[j] && fix_scp_column_r(inst, j, fixing[j])) {
+			printf("instance %d %s: fixing column %d failed\n", instance, variant, j);
+			undo_scp_fixes_r(inst, 0);
+			return 1;
+		}
+	}
+	sps = spectral_projected_subgradient_r(inst, res, MAX_ITR);
+	bsm = basic_subgradient_r(inst, res, MAX_ITR, optimum);
+	undo_scp_fixes_r(inst, 0);
+
+	if (sps > optimum + BOUND_TOL || bsm > optimum + BOUND_TOL) {
+		printf("instance %d %s: bounds sps %.6f bsm %.6f above optimum %d, fixings", instance,
+			variant, sps, bsm, optimum);
+		for (j = 0; j < num_col; j++) {
+			if (fixing[j]) printf(" %d:%d", j, fixing[j] == SCP_FIX_1);
+		}
+		printf("\n");
+		bad = 1;
+	}
+	return bad;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int option, k, t, v, j, optimum, num_variants;
+	int num_instances = 200, num_fixings = 20, num_checked = 0, num_bad = 0;
+	unsigned int seed = 1;
+	scp_instance *inst[4], *full;
+	scp_result *res[4];
+	const char *variants[] = { "original", "compact", "presolved", "reordered" };
+
+	while ((option = getopt(argc, argv, "n:f:s:")) != -1) {
+		if (option == 'n') {
+			num_instances = atoi(optarg);
+		} else if (option == 'f') {
+			num_fixings = atoi(optarg);
+		} else if (option == 's') {
+			seed = (unsigned int) atoi(optarg);
+		} else {
+			fprintf(stderr, "usage: %s [-n instances] [-f fixings] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+	srand(seed);
+
+	for (k = 0; k < num_instances; k++) {
+		if (k == 0) {
+			// presolve removes columns that this fixing needs
+			static const int row0[] = { 1 << 11, 1 << 0 | 1 << 7, 1 << 1 | 1 << 3 | 1 << 6 | 1 << 7,
+				1 << 0 | 1 << 5 | 1 << 7 };
+			static const int costs0[] = { 14, 5, 12, 15, 18, 7, 6, 17, 7, 6, 9, 5 };
+			num_row = 4;
+			num_col = 12;
+			for (j = 0; j < num_col; j++) costs[j] = costs0[j];
+			for (j = 0; j < num_row; j++) row_cols[j] = row0[j];
+		} else {
+			random_instance();
+		}
+
+		if ((inst[0] = load_instance(load_scp_instance_r)) == NULL) return 1;
+		if ((inst[1] = load_instance(load_scp_instance_compact_r)) == NULL) return 1;
+		inst[2] = presolve_scp_instance_fixable_r(inst[0], NULL);
+		inst[3] = inst[2] ? reorder_scp_instance_r(inst[2], NULL) : NULL;
+		num_variants = inst[2] == NULL ? 2 : inst[3] == NULL ? 3 : 4;
+		for (v = 0; v < num_variants; v++) {
+			if ((res[v] = create_scp_result(inst[v])) == NULL) return 1;
+		}
+
+		// fixings of the full presolve are refused (with an error message), they could cut off
+		// solutions
+		if (k == 0 && (full = presolve_scp_instance_r(inst[0], NULL)) != NULL) {
+			if (get_num_col_r(full) > 0 && fix_scp_column_r(full, 0, SCP_FIX_0) == 0) {
+				printf("instance %d: fixing accepted after the full presolve\n", k);
+				num_bad++;
+			}
+			free_scp_instance_r(full);
+		}
+
+		for (t = 0; t < num_fixings; t++) {
+			for (j = 0; j < num_col; j++) {
+				fixing[j] = rand() % 7 == 0 ? SCP_FIX_0 : rand() % 7 == 0 ? SCP_FIX_1 : 0;
+			}
+			if (k == 0 && t == 0) {
+				for (j = 0; j < num_col; j++) fixing[j] = 0;
+				fixing[0] = SCP_FIX_1;
+				fixing[1] = SCP_FIX_0;
+			}
+			if ((optimum = brute_force()) < 0) continue;
+			for (v = 0; v < num_variants; v++) {
+				num_bad += check_bounds(inst[v], res[v], variants[v], k, optimum);
+				num_checked++;
+			}
+		}
+
+		for (v = num_variants - 1; v >= 0; v--) {
+			free_scp_result(res[v]);
+			free_scp_instance_r(inst[v]);
+		}
+	}
+
+	printf("%d fixed subproblems checked, %d failed\n", num_checked, num_bad);
+	return num_bad > 0;
+}
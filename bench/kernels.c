@@ -0,0 +1,102 @@
+/*** microbenchmark of the simd kernels, reports elements/ns of every kernel variant
+
+usage: bench_kernels [n]
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "scp_simd.h"
+
+#define MIN_TIME    0.2     // seconds per measurement
+
+static const char *variants[] = { "scalar", "avx2", "avx512" };
+
+static volatile double sink;
+
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, k, v, reps, n, dd_size;
+	int *idx, *old_g, *g;
+	scp_real *x, *dd;
+	double begin_t, elapsed, aa, ag;
+	unsigned char *mask;
+	const scp_simd_kernels *kern;
+
+	n = argc > 1 ? atoi(argv[1]) : 1 << 16;
+	if (n <= 0) {
+		fprintf(stderr, "usage: %s [n]\n", argv[0]);
+		return 1;
+	}
+
+	x = (scp_real *) malloc(n * sizeof(scp_real));
+	dd = (scp_real *) malloc(n * sizeof(scp_real));
+	mask = (unsigned char *) malloc(n);
+	idx = (int *) malloc(n * sizeof(int));
+	old_g = (int *) malloc(n * sizeof(int));
+	g = (int *) malloc(n * sizeof(int));
+	if (!x || !dd || !mask || !idx || !old_g || !g) {
+		perror("Error malloc");
+		return 1;
+	}
+
+	// reduced costs around zero, dd over ~70% of the rows as in an sps iteration
+	srand(1);
+	dd_size = 0;
+	for (i = 0; i < n; i++) {
+		x[i] = (double) rand() / RAND_MAX - 0.5;
+		dd[i] = (double) rand() / RAND_MAX;
+		g[i] = rand() % 5 - 2;
+		if (rand() % 10 < 7) {
+			old_g[dd_size] = rand() % 5 - 2;
+			idx[dd_size++] = i;
+		}
+	}
+
+	printf("n = %d\n", n);
+	printf("%-8s %14s %14s %14s\n", "variant", "sum_negative", "below_mask", "dd_dots");
+	for (v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		if ((kern = scp_simd_find(variants[v])) == NULL) {
+			printf("%-8s %14s\n", variants[v], "unsupported");
+			continue;
+		}
+		printf("%-8s", kern->name);
+
+		for (reps = 0, begin_t = now(); (elapsed = now() - begin_t) < MIN_TIME; reps++) {
+			for (k = 0; k < 16; k++) sink = kern->sum_negative(x, n);
+		}
+		printf(" %14.2f", 16.0 * reps * n / (elapsed * 1e9));
+
+		for (reps = 0, begin_t = now(); (elapsed = now() - begin_t) < MIN_TIME; reps++) {
+			for (k = 0; k < 16; k++) kern->below_mask(x, n, 1e-14, mask);
+			sink = mask[reps % n];
+		}
+		printf(" %14.2f", 16.0 * reps * n / (elapsed * 1e9));
+
+		for (reps = 0, begin_t = now(); (elapsed = now() - begin_t) < MIN_TIME; reps++) {
+			aa = ag = 0.0;
+			for (k = 0; k < 16; k++) kern->dd_dots(dd, idx, old_g, g, dd_size, &aa, &ag);
+			sink = aa + ag;
+		}
+		printf(" %14.2f\n", 16.0 * reps * dd_size / (elapsed * 1e9));
+	}
+	printf("(elements/ns)\n");
+
+	free(x);
+	free(dd);
+	free(mask);
+	free(idx);
+	free(old_g);
+	free(g);
+	return 0;
+}
@@ -0,0 +1,286 @@
+/*** benchmark of both solvers over an instance set, compared against a stored baseline
+
+usage: bench_solve [-d data_dir] [-m manifest] [-b baseline.tsv] [-o out.json] [-u new_baseline.tsv]
+                   [-r reps] [-w warmup] [-i max_itr] [-t threads] [-x tolerance] [-R]
+
+The manifest has one "file [upperbound]" per line (# starts a comment), files are relative
+to data_dir and missing ones are skipped. Every instance is solved by SPS and, if it has an
+upperbound, by BSM: warmup untimed runs, then reps timed runs. A result is flagged if its
+bound differs from the baseline or its median wall time exceeds the baseline by more than
+tolerance (relative). With -R the instances are solved in reverse Cuthill-McKee order,
+which compares against a baseline of a run without it. Returns 1 if anything was flagged.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "subgradient.h"
+#include "scp_internal.h"
+#include "scp_simd.h"
+
+#define MAX_LINE        1024
+#define BOUND_TOL       1e-6    // bounds are compared at the precision of the baseline
+
+typedef struct {
+	char name[MAX_LINE]; 	// file name without extension
+	char method[4]; 	// "sps" or "bsm"
+	double bound;
+	double seconds; 	// median wall time
+} baseline_entry;
+
+static baseline_entry *baseline;
+static int num_baseline;
+
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+
+/* Resets the peak resident set size of the process, so that the next read covers one
+instance only. Linux specific, a no-op elsewhere. */
+static void reset_peak_rss()
+{
+	FILE *fp;
+
+	if ((fp = fopen("/proc/self/clear_refs", "w")) != NULL) {
+		fputs("5", fp);
+		fclose(fp);
+	}
+}
+
+
+/* Returns peak resident set size in kB since the last reset_peak_rss. */
+static long read_peak_rss()
+{
+	FILE *fp;
+	char line[MAX_LINE];
+	long kb = -1;
+	struct rusage usage;
+
+	if ((fp = fopen("/proc/self/status", "r")) != NULL) {
+		while (fgets(line, sizeof(line), fp)) {
+			if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+		}
+		fclose(fp);
+	}
+	if (kb < 0) {
+		getrusage(RUSAGE_SELF, &usage); // peak of the whole run
+		kb = usage.ru_maxrss;
+	}
+	return kb;
+}
+
+
+/* Reads baseline file of "instance method bound seconds" lines.
+Returns 0 on success, otherwise returns -1. */
+static int read_baseline(const char *filename)
+{
+	FILE *fp;
+	char line[MAX_LINE];
+	baseline_entry entry, *p;
+	int cap = 0;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		perror(filename);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%1023s %3s %lf %lf", entry.name, entry.method,
+			&entry.bound, &entry.seconds) != 4) continue;
+		if (num_baseline == cap) {
+			cap = cap ? 2 * cap : 64;
+			if ((p = (baseline_entry *) realloc(baseline, cap * sizeof(baseline_entry))) == NULL) {
+				perror("Error realloc");
+				fclose(fp);
+				return -1;
+			}
+			baseline = p;
+		}
+		baseline[num_baseline++] = entry;
+	}
+	fclose(fp);
+	return 0;
+}
+
+
+static const baseline_entry *find_baseline(const char *name, const char *method)
+{
+	int i;
+
+	for (i = 0; i < num_baseline; i++) {
+		if (strcmp(baseline[i].name, name) == 0 && strcmp(baseline[i].method, method) == 0) {
+			return &baseline[i];
+		}
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	char *data_dir = ".", *manifest = "bench/instances.txt", *baseline_file = NULL;
+	char *json_file = NULL, *update_file = NULL;
+	char line[MAX_LINE], file[MAX_LINE], path[2 * MAX_LINE], name[MAX_LINE], *dot, *status;
+	int option, reps = 5, warmup = 1, upperbound, r, m, num_itr, num_flagged = 0, first = 1;
+	int use_reorder = 0;
+	double tolerance = 0.10, bound = 0, *times, median, p95, begin_t;
+	long rss;
+	FILE *fp, *json = NULL, *update = NULL;
+	scp_instance *inst, *loaded;
+	scp_result *res;
+	scp_params params;
+	const baseline_entry *base;
+	static const char *methods[] = { "sps", "bsm" };
+
+	init_scp_params(&params);
+	while ((option = getopt(argc, argv, "d:m:b:o:u:r:w:i:t:x:R")) != -1) {
+		if (option == 'd') data_dir = optarg;
+		else if (option == 'm') manifest = optarg;
+		else if (option == 'b') baseline_file = optarg;
+		else if (option == 'o') json_file = optarg;
+		else if (option == 'u') update_file = optarg;
+		else if (option == 'r') reps = atoi(optarg);
+		else if (option == 'w') warmup = atoi(optarg);
+		else if (option == 'i') params.max_itr = atoi(optarg);
+		else if (option == 't') params.num_threads = atoi(optarg);
+		else if (option == 'x') tolerance = atof(optarg);
+		else if (option == 'R') use_reorder = 1;
+		else {
+			fprintf(stderr, "usage: %s [-d data_dir] [-m manifest] [-b baseline.tsv] [-o out.json] "
+				"[-u new_baseline.tsv] [-r reps] [-w warmup] [-i max_itr] [-t threads] "
+				"[-x tolerance] [-R]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (reps < 1) reps = 1;
+
+	if (baseline_file && read_baseline(baseline_file)) return 2;
+	if ((fp = fopen(manifest, "r")) == NULL) {
+		perror(manifest);
+		return 2;
+	}
+	if (json_file && (json = fopen(json_file, "w")) == NULL) {
+		perror(json_file);
+		return 2;
+	}
+	if (update_file && (update = fopen(update_file, "w")) == NULL) {
+		perror(update_file);
+		return 2;
+	}
+	if ((times = (double *) malloc(reps * sizeof(double))) == NULL) {
+		perror("Error malloc");
+		return 2;
+	}
+
+	if (json) {
+		fprintf(json, "{\"max_itr\":%d,\"threads\":%d,\"reps\":%d,\"warmup\":%d,\"simd\":\"%s\","
+			"\"reorder\":%d,\"results\":[", params.max_itr, params.num_threads, reps, warmup,
+			scp_simd->name, use_reorder);
+	}
+	if (update) fprintf(update, "# instance\tmethod\tbound\tmedian_s\n");
+	printf("%-12s %-4s %12s %9s %9s %10s %10s %9s  %s\n", "instance", "meth", "bound", "median_s",
+		"p95_s", "itr/s", "ns/nz/itr", "rss_kb", "vs baseline");
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%1023s", file) != 1) continue;
+		upperbound = 0;
+		sscanf(line, "%*s %d", &upperbound);
+
+		snprintf(path, sizeof(path), "%s/%s", data_dir, file);
+		snprintf(name, sizeof(name), "%s", strrchr(file, '/') ? strrchr(file, '/') + 1 : file);
+		if ((dot = strrchr(name, '.')) != NULL) *dot = '\0';
+		if (access(path, R_OK) != 0) {
+			printf("%-12s skipped, %s not found\n", name, path);
+			continue;
+		}
+
+		reset_peak_rss();
+		loaded = strstr(file, ".scpb") ? load_scp_instance_bin_r(path) : load_scp_instance_mmap_r(path);
+		if (loaded == NULL) return 2;
+		inst = use_reorder ? reorder_scp_instance_r(loaded, NULL) : loaded;
+		if (inst == NULL || (res = create_scp_result(inst)) == NULL) return 2;
+
+		for (m = 0; m < 2; m++) {
+			if (m == 1 && upperbound <= 0) break; // BSM step size needs the upperbound
+			params.upperbound = upperbound;
+			for (r = -warmup; r < reps; r++) {
+				begin_t = now();
+				bound = m == 0 ? spectral_projected_subgradient_ex(inst, res, &params)
+					: basic_subgradient_ex(inst, res, &params);
+				if (r >= 0) times[r] = now() - begin_t;
+			}
+			if (bound < 0) return 2;
+			num_itr = get_num_itr_r(res);
+			rss = read_peak_rss();
+
+			qsort(times, reps, sizeof(double), compare_double);
+			median = reps % 2 ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+			p95 = times[(int) ceil(0.95 * reps) - 1];
+
+			// flag changed bounds and slowdowns beyond tolerance
+			status = "new";
+			if ((base = find_baseline(name, methods[m])) != NULL) {
+				status = "ok";
+				if (fabs(bound - base->bound) > BOUND_TOL) {
+					status = "BOUND CHANGED";
+				} else if (median > base->seconds * (1 + tolerance)) {
+					status = "SLOWER";
+				}
+				num_flagged += strcmp(status, "ok") != 0;
+			}
+
+			printf("%-12s %-4s %12.6f %9.4f %9.4f %10.1f %10.3f %9ld  %s", name, methods[m], bound,
+				median, p95, num_itr / median, median * 1e9 / ((double) num_itr * inst->num_nonzero),
+				rss, status);
+			if (base) printf(" (%.6f, %.4f s, %+.1f%%)", base->bound, base->seconds,
+				100.0 * (median / base->seconds - 1));
+			printf("\n");
+
+			if (json) {
+				fprintf(json, "%s\n{\"instance\":\"%s\",\"method\":\"%s\",\"bound\":%.6f,"
+					"\"iterations\":%d,\"median_s\":%.6f,\"p95_s\":%.6f,\"itr_per_s\":%.1f,"
+					"\"ns_per_nz_itr\":%.4f,\"peak_rss_kb\":%ld,\"status\":\"%s\"", first ? "" : ",",
+					name, methods[m], bound, num_itr, median, p95, num_itr / median,
+					median * 1e9 / ((double) num_itr * inst->num_nonzero), rss, status);
+				if (base) fprintf(json, ",\"baseline_bound\":%.6f,\"baseline_s\":%.6f",
+					base->bound, base->seconds);
+				fprintf(json, "}");
+				first = 0;
+			}
+			if (update) fprintf(update, "%s\t%s\t%.6f\t%.6f\n", name, methods[m], bound, median);
+		}
+
+		free_scp_result(res);
+		if (inst != loaded) free_scp_instance_r(inst);
+		free_scp_instance_r(loaded);
+	}
+
+	if (json) {
+		fprintf(json, "\n]}\n");
+		fclose(json);
+	}
+	if (update) fclose(update);
+	fclose(fp);
+	free(times);
+	free(baseline);
+
+	printf("%d flagged (bound change or more than %.0f%% slower than baseline)\n", num_flagged,
+		100 * tolerance);
+	return num_flagged ? 1 : 0;
+}
@@ -0,0 +1,339 @@
+/***
+Core problem pricing, based on
+"Caprara, A., Fischetti, M. and Toth, P. (1999) A heuristic method for the set covering
+problem. Operations Research, 47(5), 730-743."
+
+The iterations run on a core instance with all rows and a small subset of the columns:
+the core_size columns of lowest reduced cost of each row and every column with negative
+reduced cost. Since the core lacks columns, its Lagrangian bound overestimates the one of
+the full instance, so every round of core_interval iterations ends by pricing all
+columns against the best dual vector of the core over col_wise_a. The priced bound is a
+bound of the full instance, and the priced reduced costs select the next core. The core
+is exact once no column outside of it has negative reduced cost, so a zero subgradient
+on such a core proves the dual vector optimal for the full instance.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "scp_internal.h"
+
+
+typedef struct {
+    const scp_instance *inst;
+    double *reduced_costs;  // of all columns, from the last pricing
+    double *dual;           // dual vector of the last pricing
+    double *best_dual;      // best priced dual vector
+    int *core_index;        // core column of each column, -1 if not in the core
+    int *core_cols;         // column of each core column
+    int num_core;
+    double *row_rc;         // lowest reduced costs of a row, ascending (core_size entries)
+    int *row_cols;
+} core_state;
+
+
+static double seconds_since(const struct timespec *begin)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - begin->tv_sec) + (now.tv_nsec - begin->tv_nsec) * 1e-9;
+}
+
+
+// Sets cs->dual to min (cost_j / size_j) over the columns j of each row.
+static void init_core_dual(core_state *cs)
+{
+    int i, j, col;
+    double value;
+    const scp_instance *inst = cs->inst;
+    const int *col_wise_idx = inst->col_wise_idx;
+
+    for (i = 0; i < inst->num_row; i++) {
+        cs->dual[i] = HUGE_VAL;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = ROW_AT(inst, j);
+            value = (double) inst->costs[col] / (col_wise_idx[col+1] - col_wise_idx[col]);
+            if (value < cs->dual[i]) cs->dual[i] = value;
+        }
+        if (cs->dual[i] == HUGE_VAL) cs->dual[i] = 0.0; // empty row
+    }
+}
+
+
+/* Computes the reduced costs of all columns for cs->dual, and counts in num_outside the
+columns with negative reduced cost that are not in the current core.
+Returns obj value of cs->dual on the full instance. */
+static double price_columns(core_state *cs, int *num_outside)
+{
+    int i, j;
+    double value, obj;
+    const scp_instance *inst = cs->inst;
+
+    obj = inst->fixed_cost;
+    for (i = 0; i < inst->num_row; i++) {
+        obj += cs->dual[i];
+    }
+    *num_outside = 0;
+    for (i = 0; i < inst->num_col; i++) {
+        value = inst->costs[i];
+        for (j = inst->col_wise_idx[i]; j < inst->col_wise_idx[i+1]; j++) {
+            value -= cs->dual[COL_AT(inst, j)];
+        }
+        cs->reduced_costs[i] = value;
+        if (value < 0) {
+            obj += value;
+            *num_outside += cs->core_index[i] < 0;
+        }
+    }
+    return obj;
+}
+
+
+/* Selects the core for the last priced reduced costs: the core_size columns of lowest
+reduced cost of each row and all columns with negative reduced cost. */
+static void select_core(core_state *cs, int core_size)
+{
+    int i, j, k, n, col;
+    double rc;
+    const scp_instance *inst = cs->inst;
+    const double *reduced_costs = cs->reduced_costs;
+
+    for (i = 0; i < inst->num_col; i++) {
+        cs->core_index[i] = reduced_costs[i] < 0 ? 0 : -1;
+    }
+
+    // partial insertion sort, core_size is small
+    for (i = 0; i < inst->num_row; i++) {
+        n = 0;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = ROW_AT(inst, j);
+            rc = reduced_costs[col];
+            if (n == core_size && rc >= cs->row_rc[n-1]) continue;
+            k = n < core_size ? n++ : n - 1;
+            for (; k > 0 && cs->row_rc[k-1] > rc; k--) {
+                cs->row_rc[k] = cs->row_rc[k-1];
+                cs->row_cols[k] = cs->row_cols[k-1];
+            }
+            cs->row_rc[k] = rc;
+            cs->row_cols[k] = col;
+        }
+        for (k = 0; k < n; k++) {
+            cs->core_index[cs->row_cols[k]] = 0;
+        }
+    }
+
+    cs->num_core = 0;
+    for (i = 0; i < inst->num_col; i++) {
+        if (cs->core_index[i] < 0) continue;
+        cs->core_cols[cs->num_core] = i;
+        cs->core_index[i] = cs->num_core++;
+    }
+}
+
+
+/* Copies the core columns of cs to core, in the layout of the full instance.
+Returns 0 on success, otherwise returns -1. */
+static int build_core(const core_state *cs, scp_instance *core)
+{
+    int i, j, k, col;
+    const scp_instance *inst = cs->inst;
+
+    core->num_row = inst->num_row;
+    core->num_col = cs->num_core;
+    core->fixed_cost = inst->fixed_cost;
+
+    k = core->num_col > 0 ? core->num_col : 1;
+    MALLOC(core->costs, int *, k * sizeof(int))
+    MALLOC(core->col_sizes, int *, k * sizeof(int))
+    MALLOC(core->row_sizes, int *, (core->num_row > 0 ? core->num_row : 1) * sizeof(int))
+    MALLOC(core->row_wise_idx, int *, (core->num_row+1) * sizeof(int))
+
+    core->num_nonzero = 0;
+    for (i = 0; i < core->num_col; i++) {
+        col = cs->core_cols[i];
+        core->costs[i] = inst->costs[col];
+        core->col_sizes[i] = inst->col_wise_idx[col+1] - inst->col_wise_idx[col];
+        core->num_nonzero += core->col_sizes[i];
+    }
+    MALLOC(core->row_wise_a, int *, (core->num_nonzero > 0 ? core->num_nonzero : 1) * sizeof(int))
+
+    // core columns keep the order of the full instance, so rows stay sorted by column
+    k = 0;
+    for (i = 0; i < core->num_row; i++) {
+        core->row_wise_idx[i] = k;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = cs->core_index[ROW_AT(inst, j)];
+            if (col >= 0) core->row_wise_a[k++] = col;
+        }
+        core->row_sizes[i] = k - core->row_wise_idx[i];
+    }
+    core->row_wise_idx[core->num_row] = k;
+
+    if (build_col_wise_matrix(core, 0)) return -1;
+    // same kernels as the full instance would use
+    return inst->col_sizes == NULL ? compact_scp_instance_r(core) : 0;
+}
+
+
+/* Runs params->method (SCP_SPS or SCP_BSM) on core problems of inst, which must not be
+fixed. Core statistics are stored in stats (if not NULL).
+Returns best (maximum) dual solution of inst.
+Returns -1 on system failure. */
+double core_subgradient_r(const scp_instance *inst, scp_result *res, const scp_params *params,
+                          scp_core_stats *stats)
+{
+    int i, k, num_itr, num_outside, round_stop, stop;
+    double obj, best_obj = -1, upper_bound, elapsed;
+    double phase_time[SCP_NUM_PHASES];
+    long long phase_counters[SCP_NUM_PHASES][SCP_NUM_COUNTERS];
+    struct timespec begin_t, mark_t;
+    core_state cs;
+    scp_core_stats local_stats;
+    scp_params sub;
+    scp_sps_state *state = NULL;
+    scp_instance *core = NULL;
+    const int core_size = params->core_size > 0 ? params->core_size : 1;
+    const int interval = params->core_interval > 0 ? params->core_interval : 1;
+
+    if (inst->num_fixed > 0) {
+        fprintf(stderr, "Error: cannot solve the core problem of a fixed instance\n");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin_t);
+    if (stats == NULL) stats = &local_stats;
+    memset(stats, 0, sizeof(scp_core_stats));
+    stats->num_col = inst->num_col;
+    memset(phase_time, 0, SCP_NUM_PHASES * sizeof(double));
+    for (i = 0; i < SCP_NUM_PHASES; i++) {
+        for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+            phase_counters[i][k] = -1;
+        }
+    }
+
+    memset(&cs, 0, sizeof(core_state));
+    cs.inst = inst;
+    cs.reduced_costs = (double *) malloc((inst->num_col + 1) * sizeof(double));
+    cs.dual = (double *) malloc((inst->num_row + 1) * sizeof(double));
+    cs.best_dual = (double *) malloc((inst->num_row + 1) * sizeof(double));
+    cs.core_index = (int *) malloc((inst->num_col + 1) * sizeof(int));
+    cs.core_cols = (int *) malloc((inst->num_col + 1) * sizeof(int));
+    cs.row_rc = (double *) malloc(core_size * sizeof(double));
+    cs.row_cols = (int *) malloc(core_size * sizeof(int));
+    if (!cs.reduced_costs || !cs.dual || !cs.best_dual || !cs.core_index || !cs.core_cols
+        || !cs.row_rc || !cs.row_cols) {
+        perror("Error malloc");
+        goto fail;
+    }
+    if (params->method != SCP_BSM && (state = create_scp_sps_state(inst, params)) == NULL) {
+        goto fail;
+    }
+
+    // the target and gap tests of a round see the core bound, so they run on priced ones
+    sub = *params;
+    sub.term.target_bound = HUGE_VAL;
+    upper_bound = HUGE_VAL;
+
+    init_core_dual(&cs);
+    for (i = 0; i < inst->num_col; i++) {
+        cs.core_index[i] = -1;
+    }
+    num_itr = 0;
+    round_stop = 0;
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &mark_t);
+        obj = price_columns(&cs, &num_outside);
+        if (obj > best_obj || stats->rounds == 0) {
+            best_obj = obj;
+            memcpy(cs.best_dual, cs.dual, inst->num_row * sizeof(double));
+        }
+
+        elapsed = seconds_since(&begin_t);
+        if (round_stop == SCP_STOP_OPTIMAL && num_outside == 0) {
+            stop = SCP_STOP_OPTIMAL;
+        } else if (round_stop == SCP_STOP_TIME || round_stop == SCP_STOP_STALL
+                   || round_stop == SCP_STOP_LINE_SEARCH) {
+            stop = round_stop;
+        } else if (best_obj > params->term.target_bound) {
+            stop = SCP_STOP_TARGET;
+        } else if (best_obj > upper_bound - 1 + GAP_TOL) {
+            stop = SCP_STOP_GAP;
+        } else if (params->term.time_limit > 0 && elapsed >= params->term.time_limit) {
+            stop = SCP_STOP_TIME;
+        } else if (num_itr >= params->max_itr) {
+            stop = SCP_STOP_MAX_ITR;
+        } else {
+            stop = 0;
+        }
+        if (stop) {
+            stats->time += seconds_since(&mark_t);
+            break;
+        }
+
+        select_core(&cs, core_size);
+        if ((core = (scp_instance *) calloc(1, sizeof(scp_instance))) == NULL) {
+            perror("Error malloc");
+            goto fail;
+        }
+        if (build_core(&cs, core)) goto fail;
+        stats->rounds++;
+        stats->core_cols = cs.num_core;
+        if (cs.num_core > stats->max_core_cols) stats->max_core_cols = cs.num_core;
+        stats->time += seconds_since(&mark_t);
+
+        sub.max_itr = params->max_itr - num_itr < interval ? params->max_itr - num_itr : interval;
+        if (params->term.time_limit > 0) sub.term.time_limit = params->term.time_limit - elapsed;
+        if (params->method == SCP_BSM) {
+            obj = basic_subgradient_warm(core, res, &sub, cs.dual);
+        } else {
+            obj = spectral_projected_subgradient_warm(core, res, &sub, cs.dual, state);
+        }
+        // the reduced costs left in the workspace are those of the core
+        res->ws.rc_inst = NULL;
+        free_scp_instance_r(core);
+        core = NULL;
+        if (obj == -1) goto fail;
+
+        num_itr += res->num_itr;
+        round_stop = res->stop_reason;
+        if (res->upper_bound < upper_bound) upper_bound = res->upper_bound;
+        for (i = 0; i < SCP_NUM_PHASES; i++) {
+            phase_time[i] += res->phase_time[i];
+            for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+                if (res->phase_counters[i][k] < 0) continue;
+                if (phase_counters[i][k] < 0) phase_counters[i][k] = 0;
+                phase_counters[i][k] += res->phase_counters[i][k];
+            }
+        }
+        memcpy(cs.dual, res->best_dual, inst->num_row * sizeof(double));
+    }
+
+    memcpy(res->best_dual, cs.best_dual, inst->num_row * sizeof(double));
+    res->best_obj = best_obj;
+    res->working_obj = best_obj; // priced in double
+    res->num_itr = num_itr;
+    res->stop_reason = stop;
+    res->upper_bound = upper_bound;
+    if (params->phase_timers) phase_time[SCP_PHASE_PRICING] = stats->time;
+    memcpy(res->phase_time, phase_time, SCP_NUM_PHASES * sizeof(double));
+    memcpy(res->phase_counters, phase_counters, sizeof(phase_counters));
+    goto cleanup;
+
+fail:
+    best_obj = -1;
+    free_scp_instance_r(core);
+cleanup:
+    free_scp_sps_state(state);
+    free(cs.reduced_costs);
+    free(cs.dual);
+    free(cs.best_dual);
+    free(cs.core_index);
+    free(cs.core_cols);
+    free(cs.row_rc);
+    free(cs.row_cols);
+    return best_obj;
+}
@@ -0,0 +1,125 @@
+/***
+Lagrangian greedy heuristic, based on
+"Beasley, J.E. (1990) A Lagrangian heuristic for set-covering problems.
+Naval Research Logistics, 37(1), 151–164."
+
+A cover is built from the reduced costs of a dual vector: the columns with negative
+reduced cost (the Lagrangian solution) are taken, every row left uncovered adds its
+cheapest column, and the columns of the cover are then dropped in order of decreasing
+cost as long as all their rows stay covered. Rows covered by columns fixed to 1 count as
+covered, columns fixed to 0 only enter if a row has no other column.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scp_internal.h"
+
+
+/* Makes sure h holds buffers for inst.
+Returns 0 on success, otherwise returns -1. */
+int reserve_heuristic(scp_heuristic *h, const scp_instance *inst)
+{
+    if (h->row_count != NULL && h->num_row == inst->num_row && h->num_col >= inst->num_col) {
+        return 0;
+    }
+    free_heuristic(h);
+    MALLOC(h->row_count, int *, (inst->num_row > 0 ? inst->num_row : 1) * sizeof(int))
+    MALLOC(h->cover, int *, (inst->num_col > 0 ? inst->num_col : 1) * sizeof(int))
+    MALLOC(h->keys, long long *, (inst->num_col > 0 ? inst->num_col : 1) * sizeof(long long))
+    h->num_row = inst->num_row;
+    h->num_col = inst->num_col;
+    return 0;
+}
+
+
+void free_heuristic(scp_heuristic *h)
+{
+    free(h->row_count);
+    free(h->cover);
+    free(h->keys);
+    memset(h, 0, sizeof(scp_heuristic));
+}
+
+
+static int compare_key(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+
+static void add_col(const scp_instance *inst, scp_heuristic *h, int col)
+{
+    int j;
+
+    h->cover[h->cover_size++] = col;
+    for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+        h->row_count[COL_AT(inst, j)]++;
+    }
+}
+
+
+/* Builds a cover of inst from reduced_costs, its columns are left in h->cover.
+Returns cost of the cover including the fixed cost of inst, HUGE_VAL if a row is empty. */
+double lagrangian_cover(const scp_instance *inst, const scp_real *reduced_costs, scp_heuristic *h)
+{
+    int i, j, k, col, best_col, redundant;
+    double cost;
+    const int *costs = inst->costs;
+    const int *row_covered = inst->num_covered > 0 ? inst->row_covered : NULL;
+
+    for (i = 0; i < inst->num_row; i++) {
+        h->row_count[i] = row_covered != NULL && row_covered[i] > 0;
+    }
+
+    // Lagrangian solution, fixed columns have huge reduced costs
+    h->cover_size = 0;
+    for (j = 0; j < inst->num_col; j++) {
+        if (reduced_costs[j] < 0) add_col(inst, h, j);
+    }
+
+    // cheapest column of each uncovered row
+    for (i = 0; i < inst->num_row; i++) {
+        if (h->row_count[i] > 0) continue;
+        best_col = -1;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = ROW_AT(inst, j);
+            // ties go to the smaller reduced cost
+            if (best_col < 0 || costs[col] < costs[best_col] || (costs[col] == costs[best_col]
+                && reduced_costs[col] < reduced_costs[best_col])) {
+                best_col = col;
+            }
+        }
+        if (best_col < 0) return HUGE_VAL;
+        add_col(inst, h, best_col);
+    }
+
+    // drop redundant columns, most expensive first
+    for (k = 0; k < h->cover_size; k++) {
+        h->keys[k] = ((long long) costs[h->cover[k]] << 32) | h->cover[k];
+    }
+    qsort(h->keys, h->cover_size, sizeof(long long), compare_key);
+
+    cost = inst->fixed_cost;
+    i = 0;
+    for (k = h->cover_size - 1; k >= 0; k--) {
+        col = (int) (h->keys[k] & 0xffffffffLL);
+        redundant = 1;
+        for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1] && redundant; j++) {
+            redundant = h->row_count[COL_AT(inst, j)] > 1;
+        }
+        if (redundant) {
+            for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+                h->row_count[COL_AT(inst, j)]--;
+            }
+        } else {
+            h->cover[i++] = col;
+            cost += costs[col];
+        }
+    }
+    h->cover_size = i;
+    return cost;
+}
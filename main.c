@@ -2,73 +2,510 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/stat.h>
 #include "subgradient.h"
+#include "batch.h"
+#include "server.h"
+#ifdef SCP_MPI
+#include <mpi.h>
+#include "scp_mpi.h"
+#endif
 
 #define SPS 	1 // spectral projected subgradien
 #define BASIC 	2 // basic subgradient
+#define PORTFOLIO 	3 // race of SPS and BSM configurations
+#define MULTI 	4 // basic subgradient lanes in lockstep
+
+#define MAX_LANES 	64
+
+// writes one tab-separated line per iteration to the stream in data
+static void print_trace(const scp_trace_info *info, void *data)
+{
+	fprintf((FILE *) data, "%d\t%f\t%f\t%g\t%g\t%d\t%g\n", info->itr, info->curr_obj,
+		info->best_obj, info->step, info->tau, info->dd_size, info->subg_norm);
+}
+
+// bytes moved per last level cache miss
+#define CACHE_LINE 	64
+
+/* Prints the phase times and hardware counters of the solve on res and writes them to json
+(if not NULL). Bytes are the cache lines of the LLC misses, per nonzero and iteration
+(per nonzero for the init phase), and over the wall time of the phase for the bandwidth. */
+static void print_phase_report(const scp_instance *inst, const scp_result *res,
+	const char *filename, const char *method, double solve_t, FILE *json)
+{
+	int phase, k, passes, width;
+	long long count[SCP_NUM_COUNTERS];
+	double t, bytes;
+	unsigned char counted = 0;
+	const double nonzeros = get_num_nonzero_r(inst);
+
+	for (phase = 0; phase < SCP_NUM_PHASES; phase++) {
+		counted |= get_phase_counter_r(res, phase, SCP_COUNTER_CYCLES) >= 0;
+	}
+	if (!counted) {
+		printf("Phase counters: not available (no perf_event_open, or see "
+			"/proc/sys/kernel/perf_event_paranoid)\n");
+	} else {
+		printf("%-12s %8s %14s %14s %5s %12s %12s %14s %9s %8s\n", "phase", "time_s",
+			"cycles", "instructions", "ipc", "llc_misses", "branch_miss", "backend_stall",
+			"bytes/nnz", "GB/s");
+	}
+	if (json) {
+		fprintf(json, "{\"instance\":\"%s\",\"method\":\"%s\",\"nonzeros\":%.0f,"
+			"\"iterations\":%d,\"wall_s\":%.6f,\"phases\":[", filename, method, nonzeros,
+			get_num_itr_r(res), solve_t);
+	}
+
+	for (phase = 0; phase < SCP_NUM_PHASES; phase++) {
+		t = get_phase_time_r(res, phase);
+		for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+			count[k] = get_phase_counter_r(res, phase, k);
+		}
+		passes = phase == SCP_PHASE_INIT ? 1 : get_num_itr_r(res);
+		passes = passes > 0 ? passes : 1;
+		bytes = count[SCP_COUNTER_LLC_MISSES] * (double) CACHE_LINE;
+
+		if (counted) {
+			printf("%-12s %8.3f", get_phase_name(phase), t);
+			for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+				if (k == SCP_COUNTER_LLC_MISSES) {
+					if (count[SCP_COUNTER_CYCLES] > 0 && count[SCP_COUNTER_INSTRUCTIONS] >= 0) {
+						printf(" %5.2f", (double) count[SCP_COUNTER_INSTRUCTIONS]
+							/ count[SCP_COUNTER_CYCLES]);
+					} else {
+						printf(" %5s", "-");
+					}
+				}
+				width = k == SCP_COUNTER_LLC_MISSES || k == SCP_COUNTER_BRANCH_MISSES ? 12 : 14;
+				if (count[k] >= 0) {
+					printf(" %*lld", width, count[k]);
+				} else {
+					printf(" %*s", width, "-");
+				}
+			}
+			if (count[SCP_COUNTER_LLC_MISSES] >= 0) {
+				printf(" %9.3f %8.3f\n", bytes / (nonzeros * passes), t > 0 ? bytes / t / 1e9 : 0.0);
+			} else {
+				printf(" %9s %8s\n", "-", "-");
+			}
+		}
+		if (json) {
+			fprintf(json, "%s{\"phase\":\"%s\",\"time_s\":%.6f", phase ? "," : "",
+				get_phase_name(phase), t);
+			for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+				if (count[k] >= 0) {
+					fprintf(json, ",\"%s\":%lld", get_counter_name(k), count[k]);
+				} else {
+					fprintf(json, ",\"%s\":null", get_counter_name(k));
+				}
+			}
+			if (count[SCP_COUNTER_LLC_MISSES] >= 0) {
+				fprintf(json, ",\"bytes_per_nonzero\":%.6f,\"bandwidth_gbs\":%.6f",
+					bytes / (nonzeros * passes), t > 0 ? bytes / t / 1e9 : 0.0);
+			}
+			fprintf(json, "}");
+		}
+	}
+	if (json) fprintf(json, "]}\n");
+}
+
+#ifdef SCP_MPI
+// solves filename row-partitioned over the ranks of MPI_COMM_WORLD, rank 0 prints the result
+static int run_dist_solve(const char *filename, scp_params *params, unsigned char basic,
+	unsigned char verbose)
+{
+	int rank, num_ranks, failed, phase;
+	double dual_soln, solve_t;
+	scp_dist *dist;
+	scp_result *res;
+
+	MPI_Init(NULL, NULL);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+	if ((dist = load_scp_dist_r(filename, MPI_COMM_WORLD)) == NULL) {
+		MPI_Finalize();
+		return 1;
+	}
+	failed = (res = create_scp_dist_result(dist)) == NULL;
+	MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+	if (failed) {
+		free_scp_dist_r(dist);
+		MPI_Finalize();
+		return 1;
+	}
+	if (verbose) {
+		params->phase_timers = 1;
+		if (rank == 0) {
+			params->trace = print_trace;
+			params->trace_data = stderr;
+			fprintf(stderr, "itr\tcurr_obj\tbest_obj\tstep\ttau\tdd_size\tsubg_norm\n");
+		}
+	}
+	if (rank == 0) {
+		printf("Type: %s over %d ranks (%d of %d rows on rank 0)\n", basic
+			? "basic subgradient" : "spectral projected subgradient", num_ranks,
+			get_dist_local_rows(dist), get_dist_num_row(dist));
+	}
+
+	solve_t = MPI_Wtime();
+	if (basic) {
+		dual_soln = basic_subgradient_dist(dist, res, params, NULL);
+	} else {
+		dual_soln = spectral_projected_subgradient_dist(dist, res, params, NULL);
+	}
+	solve_t = MPI_Wtime() - solve_t;
+
+	if (rank == 0 && dual_soln >= 0) {
+		printf("obj value: %f\n", dual_soln);
+		if (get_working_bound_r(res) != dual_soln) {
+			printf("Bound of the iterations: %f (exact bound of the dual vector %+g)\n",
+				get_working_bound_r(res), dual_soln - get_working_bound_r(res));
+		}
+		printf("Stop: %s after %d iterations\n", get_stop_reason_name(get_stop_reason_r(res)),
+			get_num_itr_r(res));
+		printf("Wall time %.3f\n", solve_t);
+		if (verbose) {
+			printf("Phase times (rank 0):");
+			for (phase = 0; phase < SCP_NUM_PHASES; phase++) {
+				printf(" %s %.3f", get_phase_name(phase), get_phase_time_r(res, phase));
+			}
+			printf("\n");
+		}
+	}
+
+	free_scp_result(res);
+	free_scp_dist_r(dist);
+	MPI_Finalize();
+	return dual_soln < 0;
+}
+#endif
 
 int main(int argc, char *argv[])
 {	
-	char *filename;
+	char *filename, *bin_filename = NULL, *batch_input = NULL, *server_path = NULL;
+	char *profile_file = NULL;
 	clock_t begin_t, end_t;
-	double dual_soln;
-	int option;
-	int upperbound;
+	struct timespec parse_begin, parse_end, solve_begin, solve_end;
+	struct stat st;
+	FILE *json;
+	double dual_soln, parse_t, solve_t;
+	int option, num_configs, winner, phase, k, num_lanes = 0;
 	unsigned char subg_type = SPS;
+	unsigned char use_mmap = 0;
+	size_t len;
+	scp_instance *inst, *orig = NULL, *reordered;
+	scp_result *res;
+	scp_presolve_stats presolve;
+	scp_reorder_stats reorder;
+	scp_core_stats core;
+	scp_params params, configs[8], lane_params[MAX_LANES];
+	scp_result *lane_res[MAX_LANES];
+	double lane_bounds[MAX_LANES];
+	batch_options batch;
+	unsigned char use_portfolio = 0;
+	unsigned char use_presolve = 0;
+	unsigned char use_compact = 0;
+	unsigned char use_reorder = 0;
+	unsigned char use_core = 0;
+	unsigned char verbose = 0;
+	unsigned char use_dist = 0;
 
-	const int max_itr = 300;
+	init_scp_params(&params);
+	params.max_itr = 300;
+	batch.num_workers = 1;
+	batch.presolve = 0;
+	batch.format = BATCH_CSV;
 
 	// parse option and get filename
-	while ((option = getopt(argc, argv, "b:")) != -1) {
+	while ((option = getopt(argc, argv, "b:mc:t:i:B:w:f:S:K:e:PprzxgMDC:H:T:L:s:l:v")) != -1) {
 		if (option == 'b') {
 			subg_type = BASIC;
-			upperbound = atoi(optarg);
+			params.upperbound = atoi(optarg);
+		} else if (option == 't') {
+			params.num_threads = atoi(optarg);
+		} else if (option == 'i') {
+			params.max_itr = atoi(optarg);
+		} else if (option == 'B') {
+			batch_input = optarg;
+		} else if (option == 'S') {
+			server_path = optarg;
+		} else if (option == 'w') {
+			batch.num_workers = atoi(optarg);
+		} else if (option == 'f' && strcmp(optarg, "csv") == 0) {
+			batch.format = BATCH_CSV;
+		} else if (option == 'f' && strcmp(optarg, "jsonl") == 0) {
+			batch.format = BATCH_JSONL;
+		} else if (option == 'P') {
+			use_portfolio = 1;
+		} else if (option == 'p') {
+			use_presolve = 1;
+		} else if (option == 'r') {
+			use_reorder = 1;
+		} else if (option == 'z') {
+			use_compact = 1;
+		} else if (option == 'x') {
+			params.sps_line_search = SCP_LS_BREAKPOINTS;
+		} else if (option == 'g') {
+			params.backend = SCP_BACKEND_CUDA;
+		} else if (option == 'M') {
+			use_dist = 1;
+		} else if (option == 'D') {
+			params.deterministic = 1;
+		} else if (option == 'K') {
+			num_lanes = atoi(optarg);
+			num_lanes = num_lanes < 1 ? 1 : num_lanes > MAX_LANES ? MAX_LANES : num_lanes;
+		} else if (option == 'C') {
+			use_core = 1;
+			params.core_size = atoi(optarg);
+		} else if (option == 'H') {
+			params.heur_interval = atoi(optarg);
+		} else if (option == 'T') {
+			params.term.time_limit = atof(optarg);
+		} else if (option == 'L') {
+			params.term.target_bound = atof(optarg);
+		} else if (option == 's') {
+			params.term.stall_itr = atoi(optarg);
+			params.term.stall_tol = 1e-4;
+		} else if (option == 'l') {
+			params.term.max_halvings = atoi(optarg);
+		} else if (option == 'v') {
+			verbose = 1;
+		} else if (option == 'e') {
+			profile_file = optarg;
+			params.phase_timers = 1;
+			params.phase_counters = 1;
+		} else if (option == 'm') {
+			use_mmap = 1;
+		} else if (option == 'c') {
+			bin_filename = optarg;
 		} else {
 			optind = argc;
 			break;
 		}
 	}
-	if (optind == argc) {
-		fprintf(stderr, "usage: %s input_file [-b upperbound]\n", argv[0]);
+	if (optind == argc && batch_input == NULL && server_path == NULL) {
+		fprintf(stderr, "usage: %s input_file [-b upperbound] [-m] [-c output.scpb] [-t threads] "
+			"[-i max_itr] [-P] [-p] [-r] [-z] [-x] [-g] [-M] [-D] [-K lanes] [-C core_size] "
+			"[-H interval] [-T seconds] [-L target] [-s stall_itr] [-l halvings] [-v] "
+			"[-e profile.json]\n", argv[0]);
+		fprintf(stderr, "       %s -B dir_or_manifest [-w workers] [-f csv|jsonl] "
+			"[-b upperbound] [-t threads] [-i max_itr] [-p]\n", argv[0]);
+		fprintf(stderr, "       %s -S socket_path|- [-t threads] [-i max_itr] [-b upperbound] "
+			"[-D] [-T seconds] [-l halvings]\n", argv[0]);
+		exit(1);
+	}
+	if (!scp_backend_available(params.backend)) {
+		fprintf(stderr, "Error: no CUDA device (or built without make CUDA=1)\n");
+		exit(1);
+	}
+
+	// row-partitioned solve, run under mpirun
+	if (use_dist && batch_input == NULL && server_path == NULL) {
+#ifdef SCP_MPI
+		return run_dist_solve(argv[optind], &params, subg_type == BASIC, verbose);
+#else
+		fprintf(stderr, "Error: built without MPI (make MPI=1)\n");
 		exit(1);
+#endif
+	}
+
+	// keep instances loaded and solve them on request
+	if (server_path) {
+		return run_server(server_path, &params) ? 1 : 0;
+	}
+
+	// solve all instances of a directory or manifest, results go to stdout
+	if (batch_input) {
+		batch.params = params;
+		batch.use_basic = subg_type == BASIC;
+		batch.presolve = use_presolve;
+		return run_batch(batch_input, &batch, stdout) ? 1 : 0;
 	}
 
 	// read SCP file and init data structure
 	filename = argv[optind];
-	if (load_scp_instance(filename)) return 1;
+	len = strlen(filename);
+	clock_gettime(CLOCK_MONOTONIC, &parse_begin);
+	if (len > 5 && strcmp(filename + len - 5, ".scpb") == 0) {
+		inst = load_scp_instance_bin_r(filename);
+	} else if (use_compact) {
+		inst = load_scp_instance_compact_r(filename);
+	} else if (use_mmap) {
+		inst = load_scp_instance_mmap_r(filename);
+	} else {
+		inst = load_scp_instance_r(filename);
+	}
+	if (inst == NULL) return 1;
+	clock_gettime(CLOCK_MONOTONIC, &parse_end);
+
+	parse_t = (parse_end.tv_sec - parse_begin.tv_sec)
+		+ (parse_end.tv_nsec - parse_begin.tv_nsec) * 1e-9;
+	if (stat(filename, &st) == 0 && parse_t > 0) {
+		printf("Load time %.3f (%.1f MB/s)\n", parse_t, st.st_size / parse_t / 1e6);
+	}
+
+	// convert to binary instance file and exit
+	if (bin_filename) {
+		if (write_scp_instance_bin_r(inst, bin_filename)) return 1;
+		printf("Wrote %s\n", bin_filename);
+		free_scp_instance_r(inst);
+		return 0;
+	}
+
+	if (use_presolve) {
+		orig = inst;
+		if ((inst = presolve_scp_instance_r(orig, &presolve)) == NULL) return 1;
+		printf("Presolve: rows %d -> %d (%.1f%%), cols %d -> %d (%.1f%%), nonzeros %d -> %d (%.1f%%)\n",
+			presolve.orig_num_row, presolve.num_row, 100.0 * presolve.num_row / presolve.orig_num_row,
+			presolve.orig_num_col, presolve.num_col, 100.0 * presolve.num_col / presolve.orig_num_col,
+			presolve.orig_num_nonzero, presolve.num_nonzero,
+			100.0 * presolve.num_nonzero / presolve.orig_num_nonzero);
+		printf("Presolve: %d forced cols (cost %.0f), %d dominated cols, %d empty cols, "
+			"%d dominated rows, %d rounds%s, time %.3f\n", presolve.forced_cols,
+			presolve.fixed_cost, presolve.dominated_cols, presolve.empty_cols,
+			presolve.dominated_rows, presolve.rounds,
+			presolve.work_limit_hit ? " (work limit hit)" : "", presolve.time);
+	}
+
+	// reordered copy reports to the original instance, a presolved one is not needed anymore
+	if (use_reorder) {
+		if ((reordered = reorder_scp_instance_r(inst, &reorder)) == NULL) return 1;
+		printf("Reorder: row span %.1f -> %.1f, col span %.1f -> %.1f, time %.3f\n",
+			reorder.row_span_before, reorder.row_span_after, reorder.col_span_before,
+			reorder.col_span_after, reorder.time);
+		if (orig) {
+			free_scp_instance_r(inst);
+		} else {
+			orig = inst;
+		}
+		inst = reordered;
+	}
 
+	// 16-bit index arrays, for .scpb files and presolved or reordered instances
+	if (use_compact && compact_scp_instance_r(inst)) return 1;
+
+	// convergence trace on stderr, phase times after the solve
+	if (verbose) {
+		params.trace = print_trace;
+		params.trace_data = stderr;
+		params.phase_timers = 1;
+		fprintf(stderr, "itr\tcurr_obj\tbest_obj\tstep\ttau\tdd_size\tsubg_norm\n");
+	}
+
+	if ((res = create_scp_result(inst)) == NULL) return 1;
+	if (use_portfolio) {
+		subg_type = PORTFOLIO;
+	} else if (num_lanes > 0) {
+		subg_type = MULTI;
+	}
 
 	begin_t = clock();
+	clock_gettime(CLOCK_MONOTONIC, &solve_begin);
 
-	if (subg_type == SPS) {
+	if (use_core && subg_type != PORTFOLIO) {
+		params.method = subg_type == BASIC ? SCP_BSM : SCP_SPS;
+		printf("Type: %s on core problems\n", subg_type == BASIC ? "basic subgradient"
+			: "spectral projected subgradient");
+		if ((dual_soln = core_subgradient_r(inst, res, &params, &core)) < 0) return 1;
+		printf("Core: %d rounds, last core %d cols, largest %d cols of %d (%.1f%%), "
+			"pricing time %.3f\n", core.rounds, core.core_cols, core.max_core_cols,
+			core.num_col, 100.0 * core.max_core_cols / core.num_col, core.time);
+	} else if (subg_type == SPS) {
 		printf("Type: spectral projected subgradient\n");
-		if ((dual_soln = spectral_projected_subgradient(max_itr)) < 0) return 1;
-	} else {
+		if ((dual_soln = spectral_projected_subgradient_ex(inst, res, &params)) < 0) return 1;
+	} else if (subg_type == BASIC) {
 		printf("Type: basic subgradient\n");
-		if ((dual_soln = basic_subgradient(max_itr, upperbound)) < 0) return 1;
+		if ((dual_soln = basic_subgradient_ex(inst, res, &params)) < 0) return 1;
+	} else if (subg_type == MULTI) {
+		// multi-start over the initial step size, lane 0 as published
+		printf("Type: basic subgradient, %d lanes in lockstep\n", num_lanes);
+		lane_res[0] = res;
+		for (k = 0; k < num_lanes; k++) {
+			if (k > 0 && (lane_res[k] = create_scp_result(inst)) == NULL) return 1;
+			lane_params[k] = params;
+			lane_params[k].bsm_lambda = params.bsm_lambda / (1 + k);
+		}
+		if (basic_subgradient_multi(inst, lane_res, lane_params, NULL, num_lanes, lane_bounds))
+			return 1;
+		winner = 0;
+		printf("Lane bounds:");
+		for (k = 0; k < num_lanes; k++) {
+			printf(" %f", lane_bounds[k]);
+			if (lane_bounds[k] > lane_bounds[winner]) winner = k;
+		}
+		printf("\nWinner: lane %d (lambda %g)\n", winner, lane_params[winner].bsm_lambda);
+		dual_soln = lane_bounds[winner];
+		res = lane_res[winner];
+		for (k = 0; k < num_lanes; k++) {
+			if (k != winner) free_scp_result(lane_res[k]);
+		}
+	} else {
+		printf("Type: portfolio\n");
+		num_configs = init_scp_portfolio(&params, configs, 8);
+		if ((dual_soln = portfolio_subgradient_r(inst, res, configs, num_configs, &winner)) < 0)
+			return 1;
+		printf("Winner: config %d of %d (%s)\n", winner, num_configs,
+			configs[winner].method == SCP_BSM ? "basic subgradient" : "spectral projected subgradient");
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &solve_end);
 	end_t = clock();
 
+	solve_t = (solve_end.tv_sec - solve_begin.tv_sec)
+		+ (solve_end.tv_nsec - solve_begin.tv_nsec) * 1e-9;
+
 	printf("obj value: %f\n", dual_soln);
+	if (get_working_bound_r(res) != dual_soln) {
+		printf("Bound of the iterations: %f (exact bound of the dual vector %+g)\n",
+			get_working_bound_r(res), dual_soln - get_working_bound_r(res));
+	}
+	printf("Stop: %s after %d iterations\n", get_stop_reason_name(get_stop_reason_r(res)),
+		get_num_itr_r(res));
+	if (get_upper_bound_r(res) < HUGE_VAL) {
+		printf("Upper bound (Lagrangian heuristic): %.0f\n", get_upper_bound_r(res));
+	}
 	printf("CPU time %.3f\n", (double) (end_t - begin_t) / CLOCKS_PER_SEC);
+	if (params.num_threads != 1 || subg_type == PORTFOLIO || subg_type == MULTI) {
+		printf("Wall time %.3f\n", solve_t);
+	}
+	if (verbose) {
+		printf("Phase times:");
+		for (phase = 0; phase < SCP_NUM_PHASES; phase++) {
+			printf(" %s %.3f", get_phase_name(phase), get_phase_time_r(res, phase));
+		}
+		printf("\n");
+	}
+	if (profile_file) {
+		if ((json = fopen(profile_file, "w")) == NULL) {
+			perror(profile_file);
+			return 1;
+		}
+		print_phase_report(inst, res, filename, subg_type == SPS ? "sps" : subg_type == BASIC
+			? "bsm" : subg_type == MULTI ? "bsm_lanes" : "portfolio", solve_t, json);
+		fclose(json);
+	}
 
 
 	/*** example: get dual vector and reduced costs ******
 	int num_col, num_row;
 	double *dual, *reduced_costs;
-	num_col = get_num_col();
-	num_row = get_num_row();
+	num_col = get_num_col_r(inst);
+	num_row = get_num_row_r(inst);
 	dual = (double *) malloc(num_row * sizeof(double));
 	reduced_costs = (double *) malloc(num_col * sizeof(double));
-	get_dual_vector(dual);
-	get_reduced_costs(reduced_costs);
+	get_dual_vector_r(res, dual);
+	get_reduced_costs_r(inst, res, reduced_costs);
 	*********************************************************/
 
 
-	free_scp_instance();
+	free_scp_result(res);
+	free_scp_instance_r(inst);
+	free_scp_instance_r(orig);
 
 	return 0;
 }
\ No newline at end of file
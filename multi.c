@@ -0,0 +1,411 @@
+/***
+Batched (lockstep) solves of several dual vectors on one SCP instance.
+
+The dual vectors, reduced costs and subgradients of K lanes are stored interleaved, entry
+k of row i (or column j) at [i * stride + k] with stride K rounded up to MULTI_WIDTH, so
+that every index read of a pass over col_wise_a or row_wise_a is followed by one
+contiguous run of stride values instead of K scattered ones. A pass then costs about the
+index traffic of one solve plus the arithmetic of K, which is what makes the lanes
+cheaper than K separate solves until the arithmetic dominates.
+
+The kernels recompute the reduced costs and the subgradients of all lanes from scratch
+every iteration instead of shifting the moved rows, as the rows moved by K lanes together
+cover most of the matrix anyway. The lanes run Beasley's subgradient method, whose
+iterations do the same work on every lane; the SPS line search takes a data-dependent
+number of passes per lane and has no lockstep driver.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "scp_internal.h"
+
+
+#define MULTI_WIDTH     4   // lanes per inner loop, the stride is a multiple of it
+
+// per-lane state of the lockstep driver
+typedef struct {
+    double curr_obj, best_obj;
+    double lambda, upperbound;
+    int counter, heur_interval, stop, num_itr;
+    stop_state st;
+} multi_lane;
+
+
+int multi_stride(int num_lanes)
+{
+    return (num_lanes + MULTI_WIDTH - 1) / MULTI_WIDTH * MULTI_WIDTH;
+}
+
+
+void multi_reduced_costs(const scp_instance *inst, int stride, const scp_real *dual,
+                         scp_real *reduced_costs, unsigned char *below, double *neg_sum,
+                         int num_threads)
+{
+    int i, j, k, l;
+    scp_real *rc;
+    unsigned char *b;
+    const scp_real *y, *y1;
+    double sum0[MULTI_WIDTH], sum1[MULTI_WIDTH];
+    const int num_col = inst->num_col;
+    const uint16_t *col_wise_a16 = inst->col_wise_a16;
+    const int *col_wise_a = inst->col_wise_a;
+    const int *col_wise_idx = inst->col_wise_idx;
+
+    for (k = 0; k < stride; k++) {
+        neg_sum[k] = 0.0;
+    }
+    #pragma omp parallel for if (num_threads > 1) num_threads(num_threads) \
+        private(j, k, l, rc, b, y, y1, sum0, sum1) reduction(+:neg_sum[:stride])
+    for (i = 0; i < num_col; i++) {
+        rc = reduced_costs + (size_t) i * stride;
+        b = below + (size_t) i * stride;
+        // two sums per lane, alternating over the rows, halve the chain of dependent adds
+        for (k = 0; k < stride; k += MULTI_WIDTH) {
+            for (l = 0; l < MULTI_WIDTH; l++) {
+                sum0[l] = inst->costs[i];
+                sum1[l] = 0.0;
+            }
+            for (j = col_wise_idx[i]; j + 1 < col_wise_idx[i+1]; j += 2) {
+                y = dual + (size_t) INDEX_AT(col_wise_a16, col_wise_a, j) * stride + k;
+                y1 = dual + (size_t) INDEX_AT(col_wise_a16, col_wise_a, j+1) * stride + k;
+                for (l = 0; l < MULTI_WIDTH; l++) {
+                    sum0[l] -= y[l];
+                    sum1[l] -= y1[l];
+                }
+            }
+            if (j < col_wise_idx[i+1]) {
+                y = dual + (size_t) INDEX_AT(col_wise_a16, col_wise_a, j) * stride + k;
+                for (l = 0; l < MULTI_WIDTH; l++) {
+                    sum0[l] -= y[l];
+                }
+            }
+            for (l = 0; l < MULTI_WIDTH; l++) {
+                rc[k+l] = sum0[l] + sum1[l];
+            }
+        }
+        for (k = 0; k < stride; k++) {
+            neg_sum[k] += rc[k] < 0 ? rc[k] : 0.0;
+            b[k] = rc[k] < SUBG_TOL;
+        }
+    }
+}
+
+
+void multi_subgradients(const scp_instance *inst, int stride, const unsigned char *below,
+                        const scp_real *dual, int *subg, int *nonzero, long long *norm,
+                        int num_threads)
+{
+    int i, j, k, l, g;
+    int *s;
+    const unsigned char *b;
+    const scp_real *y;
+    const int num_row = inst->num_row;
+    const uint16_t *row_wise_a16 = inst->row_wise_a16;
+    const int *row_wise_a = inst->row_wise_a;
+    const int *row_wise_idx = inst->row_wise_idx;
+    const int *row_covered = inst->num_covered > 0 ? inst->row_covered : NULL;
+
+    for (k = 0; k < stride; k++) {
+        nonzero[k] = 0;
+        norm[k] = 0;
+    }
+    #pragma omp parallel for if (num_threads > 1) num_threads(num_threads) \
+        private(j, k, l, g, s, b, y) reduction(+:nonzero[:stride], norm[:stride])
+    for (i = 0; i < num_row; i++) {
+        s = subg + (size_t) i * stride;
+        y = dual + (size_t) i * stride;
+        for (k = 0; k < stride; k++) {
+            s[k] = 1;
+        }
+        if (row_covered != NULL && row_covered[i]) {
+            for (k = 0; k < stride; k++) {
+                s[k] = 0;
+            }
+            continue;
+        }
+        for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+            b = below + (size_t) INDEX_AT(row_wise_a16, row_wise_a, j) * stride;
+            for (k = 0; k < stride; k += MULTI_WIDTH) {
+                for (l = 0; l < MULTI_WIDTH; l++) {
+                    s[k+l] -= b[k+l];
+                }
+            }
+        }
+        for (k = 0; k < stride; k++) {
+            g = s[k];
+            nonzero[k] += g != 0;
+            if (g > 0 || (g < 0 && y[k] >= SUBG_TOL)) {
+                norm[k] += g * g;
+            }
+        }
+    }
+}
+
+
+void multi_dual_steps(int num_row, int stride, scp_real *dual, const int *subg,
+                      const double *step_size, double *dual_sum, int num_threads)
+{
+    int i, k, g;
+    scp_real *y;
+    const int *s;
+
+    for (k = 0; k < stride; k++) {
+        dual_sum[k] = 0.0;
+    }
+    #pragma omp parallel for if (num_threads > 1) num_threads(num_threads) \
+        private(k, g, y, s) reduction(+:dual_sum[:stride])
+    for (i = 0; i < num_row; i++) {
+        y = dual + (size_t) i * stride;
+        s = subg + (size_t) i * stride;
+        for (k = 0; k < stride; k++) {
+            g = s[k];
+            if (g < 0 && y[k] < SUBG_TOL) {
+                g = 0; // projected
+            }
+            y[k] += step_size[k] * g;
+            if (y[k] < 0) {
+                y[k] = 0.0;
+            }
+            dual_sum[k] += y[k];
+        }
+    }
+}
+
+
+// copies lane k of the interleaved vector x (n entries per lane) to y
+static void copy_lane(const scp_real *x, int n, int stride, int k, scp_real *y)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        y[i] = x[(size_t) i * stride + k];
+    }
+}
+
+
+// copies lane k of the interleaved vector x to lane k of y
+static void save_lane(const scp_real *x, int n, int stride, int k, scp_real *y)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        y[(size_t) i * stride + k] = x[(size_t) i * stride + k];
+    }
+}
+
+
+/* Sets lane k of the interleaved dual to init_dual (negative entries raised to 0), or to
+the min(cost/size) start of the single solves if init_dual is NULL. Rows covered by fixed
+columns get 0. */
+static void init_lane(const scp_instance *inst, const double *init_dual, int stride, int k,
+                      scp_real *dual)
+{
+    int i, j, col;
+    double value, min_value;
+    const int *row_covered = inst->num_covered > 0 ? inst->row_covered : NULL;
+
+    for (i = 0; i < inst->num_row; i++) {
+        if (init_dual != NULL) {
+            value = init_dual[inst->row_map ? inst->row_map[i] : i];
+            min_value = value > 0 ? value : 0.0;
+        } else {
+            min_value = inst->costs[ROW_AT(inst, inst->row_wise_idx[i])];
+            for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+                col = ROW_AT(inst, j);
+                value = (double) inst->costs[col]
+                        / (inst->col_wise_idx[col+1] - inst->col_wise_idx[col]);
+                if (value < min_value) {
+                    min_value = value;
+                }
+            }
+        }
+        if (row_covered != NULL && row_covered[i]) {
+            min_value = 0.0;
+        }
+        dual[(size_t) i * stride + k] = min_value;
+    }
+}
+
+
+/* Beasley's subgradient method on num_lanes lanes in lockstep
+Returns 0 on success, otherwise returns -1. */
+int basic_subgradient_multi(const scp_instance *inst, scp_result *const *res,
+                            const scp_params *params, const double *const *init_duals,
+                            int num_lanes, double *bounds)
+{
+    int i, k, itr, active, nt, ret = -1;
+    double value;
+    scp_real *dual = NULL, *best_dual = NULL, *reduced_costs = NULL, *lane_buf = NULL;
+    unsigned char *below = NULL;
+    int *subg = NULL, *nonzero = NULL;
+    long long *norm = NULL;
+    double *neg_sum = NULL, *dual_sum = NULL, *step_size = NULL;
+    multi_lane *lanes = NULL;
+    multi_lane *lane;
+
+    const int num_row = inst->num_row;
+    const int num_col = inst->num_col;
+    const int stride = multi_stride(num_lanes);
+
+    if (num_lanes <= 0) return 0;
+    for (k = 0; k < num_lanes; k++) {
+        if (res[k]->num_row != num_row) {
+            fprintf(stderr, "Error: result handle of lane %d is not sized for the instance\n", k);
+            return -1;
+        }
+        if (params[k].heur_interval > 0 || params[k].upperbound <= 0) {
+            if (reserve_heuristic(&res[k]->ws.heur, inst)) return -1;
+        }
+    }
+    nt = resolve_num_threads(params[0].num_threads);
+
+    if ((dual = (scp_real *) calloc((size_t) num_row * stride, sizeof(scp_real))) == NULL
+        || (best_dual = (scp_real *) malloc((size_t) num_row * stride * sizeof(scp_real))) == NULL
+        || (reduced_costs = (scp_real *) malloc((size_t) num_col * stride * sizeof(scp_real)))
+           == NULL
+        || (below = (unsigned char *) malloc((size_t) num_col * stride)) == NULL
+        || (lane_buf = (scp_real *) malloc((num_col > num_row ? num_col : num_row)
+                                           * sizeof(scp_real))) == NULL
+        || (subg = (int *) malloc((size_t) num_row * stride * sizeof(int))) == NULL
+        || (nonzero = (int *) malloc(stride * sizeof(int))) == NULL
+        || (norm = (long long *) malloc(stride * sizeof(long long))) == NULL
+        || (neg_sum = (double *) malloc(3 * stride * sizeof(double))) == NULL
+        || (lanes = (multi_lane *) malloc(num_lanes * sizeof(multi_lane))) == NULL) {
+        perror("Error malloc");
+        goto cleanup;
+    }
+    dual_sum = neg_sum + stride;
+    step_size = dual_sum + stride;
+
+    // init data, padding lanes keep a zero dual vector and never step
+    for (k = 0; k < num_lanes; k++) {
+        init_lane(inst, init_duals != NULL ? init_duals[k] : NULL, stride, k, dual);
+    }
+    multi_reduced_costs(inst, stride, dual, reduced_costs, below, neg_sum, nt);
+    for (k = 0; k < stride; k++) {
+        dual_sum[k] = 0.0;
+    }
+    for (i = 0; i < num_row; i++) {
+        for (k = 0; k < stride; k++) {
+            dual_sum[k] += dual[(size_t) i * stride + k];
+        }
+    }
+    memcpy(best_dual, dual, (size_t) num_row * stride * sizeof(scp_real));
+
+    active = 0;
+    for (k = 0; k < num_lanes; k++) {
+        lane = &lanes[k];
+        clock_gettime(CLOCK_MONOTONIC, &lane->st.begin);
+        clear_phase_stats(res[k]);
+        res[k]->upper_bound = HUGE_VAL;
+        res[k]->ws.rc_inst = NULL; // the lanes leave no reduced costs in the workspace
+
+        lane->curr_obj = inst->fixed_cost + dual_sum[k] + neg_sum[k];
+        lane->best_obj = lane->curr_obj;
+        lane->lambda = params[k].bsm_lambda;
+        lane->upperbound = params[k].upperbound > 0 ? params[k].upperbound : HUGE_VAL;
+        lane->heur_interval = params[k].heur_interval > 0 ? params[k].heur_interval
+                              : params[k].upperbound > 0 ? 0 : SCP_HEUR_INTERVAL;
+        lane->counter = 0;
+        lane->num_itr = 0;
+        lane->st.mark_itr = 0;
+        lane->st.mark_obj = lane->best_obj;
+        lane->stop = lane->best_obj > params[k].term.target_bound ? SCP_STOP_TARGET
+                     : params[k].max_itr <= 0 ? SCP_STOP_MAX_ITR : 0;
+        active += lane->stop == 0;
+    }
+
+    for (itr = 0; active > 0; itr++) {
+        // covers from the reduced costs of the current dual vectors
+        for (k = 0; k < num_lanes; k++) {
+            lane = &lanes[k];
+            if (lane->stop || lane->heur_interval == 0 || itr % lane->heur_interval) continue;
+            copy_lane(reduced_costs, num_col, stride, k, lane_buf);
+            value = lagrangian_cover(inst, lane_buf, &res[k]->ws.heur);
+            if (value < res[k]->upper_bound) res[k]->upper_bound = value;
+            if (value < lane->upperbound) lane->upperbound = value;
+        }
+
+        // compute subgradient vectors and step sizes
+        multi_subgradients(inst, stride, below, dual, subg, nonzero, norm, nt);
+        for (k = 0; k < stride; k++) {
+            step_size[k] = 0.0;
+        }
+        for (k = 0; k < num_lanes; k++) {
+            lane = &lanes[k];
+            if (lane->stop) continue;
+            if (nonzero[k] == 0) {
+                // the current dual vector is optimal
+                lane->best_obj = lane->curr_obj;
+                save_lane(dual, num_row, stride, k, best_dual);
+                lane->stop = SCP_STOP_OPTIMAL;
+                lane->num_itr = itr;
+                active--;
+                continue;
+            }
+            step_size[k] = lane->lambda * (1.05 * lane->upperbound - lane->curr_obj)
+                           / (norm[k] ? norm[k] : 1);
+        }
+        if (active == 0) break;
+
+        // update dual vectors and obj values
+        multi_dual_steps(num_row, stride, dual, subg, step_size, dual_sum, nt);
+        multi_reduced_costs(inst, stride, dual, reduced_costs, below, neg_sum, nt);
+
+        for (k = 0; k < num_lanes; k++) {
+            lane = &lanes[k];
+            if (lane->stop) continue;
+            lane->curr_obj = inst->fixed_cost + dual_sum[k] + neg_sum[k];
+
+            // update best solution
+            if (lane->best_obj < lane->curr_obj) {
+                lane->best_obj = lane->curr_obj;
+                lane->counter = 0;
+                save_lane(dual, num_row, stride, k, best_dual);
+            } else {
+                lane->counter++;
+            }
+            if (lane->counter > params[k].bsm_patience) {
+                lane->lambda *= 0.5;
+                lane->counter = 0;
+            }
+
+            if (lane->best_obj > res[k]->upper_bound - 1 + GAP_TOL) {
+                lane->stop = SCP_STOP_GAP;
+            } else if (itr + 1 >= params[k].max_itr) {
+                lane->stop = SCP_STOP_MAX_ITR;
+            } else {
+                lane->stop = check_termination(&params[k].term, &lane->st, itr, lane->best_obj);
+            }
+            if (lane->stop) {
+                lane->num_itr = itr + 1;
+                active--;
+            }
+        }
+    }
+
+    for (k = 0; k < num_lanes; k++) {
+        copy_lane(best_dual, num_row, stride, k, lane_buf);
+        bounds[k] = store_best_dual(inst, res[k], lane_buf, lanes[k].best_obj, nt);
+        res[k]->num_itr = lanes[k].num_itr;
+        res[k]->stop_reason = lanes[k].stop;
+    }
+    ret = 0;
+
+cleanup:
+    free(dual);
+    free(best_dual);
+    free(reduced_costs);
+    free(below);
+    free(lane_buf);
+    free(subg);
+    free(nonzero);
+    free(norm);
+    free(neg_sum);
+    free(lanes);
+    return ret;
+}
@@ -0,0 +1,221 @@
+/***
+Portfolio of subgradient configurations raced on one SCP instance.
+
+Every configuration runs on its own thread with its own result handle against the shared
+read-only instance. The solves publish their best bound into a common scp_race, and give
+up when linear extrapolation of their own recent progress stays below the best bound of
+the race. Subgradient methods slow down over time, so the extrapolation is optimistic
+and a configuration is only dropped once it is clearly behind.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "scp_internal.h"
+
+
+#define MIN_CHECK_INTERVAL  10  // iterations between progress checks of a solve
+
+typedef struct {
+    const scp_instance *inst;
+    const scp_params *params;
+    scp_result *res;
+    scp_ctrl ctrl;
+    double obj;
+} portfolio_entry;
+
+
+/* Raises *target to value. */
+static void publish_best(double *target, double value)
+{
+    double curr;
+
+    __atomic_load(target, &curr, __ATOMIC_RELAXED);
+    while (value > curr
+           && !__atomic_compare_exchange(target, &curr, &value, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // curr reloaded by the failed exchange
+    }
+}
+
+
+/* Publishes best_obj of a solve at iteration itr.
+Returns 1 if the solve should stop, otherwise returns 0. */
+int scp_ctrl_update(scp_ctrl *ctrl, int itr, int max_itr, double best_obj)
+{
+    double race_best, rate;
+    int done = itr + 1;
+    scp_race *race = ctrl->race;
+
+    publish_best(&race->best_obj, best_obj);
+    if (__atomic_load_n(&race->optimal, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    if (done - ctrl->mark_itr < ctrl->check_interval) {
+        return 0;
+    }
+
+    __atomic_load(&race->best_obj, &race_best, __ATOMIC_RELAXED);
+    rate = (best_obj - ctrl->mark_obj) / (done - ctrl->mark_itr);
+    ctrl->mark_itr = done;
+    ctrl->mark_obj = best_obj;
+
+    return best_obj < race_best && best_obj + rate * (max_itr - done) < race_best;
+}
+
+
+// Publishes obj as proven optimal, which stops all solves of the race.
+void scp_ctrl_optimal(scp_ctrl *ctrl, double obj)
+{
+    publish_best(&ctrl->race->best_obj, obj);
+    __atomic_store_n(&ctrl->race->optimal, 1, __ATOMIC_RELAXED);
+}
+
+
+static void *run_entry(void *arg)
+{
+    portfolio_entry *entry = (portfolio_entry *) arg;
+
+    if (entry->params->method == SCP_BSM) {
+        entry->obj = basic_subgradient_ctrl(entry->inst, entry->res, entry->params, NULL,
+                                            &entry->ctrl);
+    } else {
+        entry->obj = spectral_projected_subgradient_ctrl(entry->inst, entry->res, entry->params,
+                                                         NULL, NULL, &entry->ctrl);
+    }
+    return NULL;
+}
+
+
+/* Fills configs with the default portfolio derived from base: SPS with several
+momentum/line search settings and, if base->upperbound > 0, BSM with two step sizes.
+Returns number of configurations (at most max_configs). */
+int init_scp_portfolio(const scp_params *base, scp_params *configs, int max_configs)
+{
+    int i, n = 0;
+    scp_params portfolio[6];
+
+    portfolio[n] = *base;               // SPS as published
+    portfolio[n++].method = SCP_SPS;
+
+    portfolio[n] = portfolio[0];        // short memory, weak momentum
+    portfolio[n].sps_memory = 5;
+    portfolio[n++].sps_momentum = 0.5;
+
+    portfolio[n] = portfolio[0];        // long memory, strong momentum, loose line search
+    portfolio[n].sps_memory = 20;
+    portfolio[n].sps_momentum = 0.9;
+    portfolio[n++].sps_gamma = 0.01;
+
+    portfolio[n] = portfolio[0];        // long initial step
+    portfolio[n++].sps_alpha = 1.0;
+
+    if (base->upperbound > 0) {
+        portfolio[n] = *base;           // BSM as published
+        portfolio[n++].method = SCP_BSM;
+
+        portfolio[n] = portfolio[n-1];  // slower step reduction
+        portfolio[n++].bsm_patience = 30;
+    }
+
+    for (i = 0; i < n && i < max_configs; i++) {
+        configs[i] = portfolio[i];
+    }
+    return i;
+}
+
+
+/* Runs the configurations configs[0..num_configs) on separate threads against inst.
+Best dual vector of all is stored in res, the index of its configuration in winner
+(if not NULL).
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double portfolio_subgradient_r(const scp_instance *inst, scp_result *res,
+                               const scp_params *configs, int num_configs, int *winner)
+{
+    int i, best = -1;
+    double best_obj = -1;
+    scp_race race;
+    portfolio_entry *entries;
+    pthread_t *threads;
+    unsigned char *started;
+
+    if (num_configs <= 0) return -1;
+
+    entries = (portfolio_entry *) calloc(num_configs, sizeof(portfolio_entry));
+    threads = (pthread_t *) malloc(num_configs * sizeof(pthread_t));
+    started = (unsigned char *) calloc(num_configs, sizeof(unsigned char));
+    if (entries == NULL || threads == NULL || started == NULL) {
+        perror("Error malloc");
+        goto cleanup;
+    }
+
+    race.best_obj = -HUGE_VAL;
+    race.optimal = 0;
+    for (i = 0; i < num_configs; i++) {
+        entries[i].inst = inst;
+        entries[i].params = &configs[i];
+        entries[i].obj = -1;
+        entries[i].ctrl.race = &race;
+        entries[i].ctrl.check_interval = configs[i].max_itr / 10 > MIN_CHECK_INTERVAL
+                                         ? configs[i].max_itr / 10 : MIN_CHECK_INTERVAL;
+        entries[i].ctrl.mark_itr = 0;
+        entries[i].ctrl.mark_obj = -HUGE_VAL;
+        if ((entries[i].res = create_scp_result(inst)) == NULL) goto cleanup;
+    }
+
+    for (i = 0; i < num_configs; i++) {
+        started[i] = pthread_create(&threads[i], NULL, run_entry, &entries[i]) == 0;
+    }
+    for (i = 0; i < num_configs; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            run_entry(&entries[i]); // no thread available, race it late
+        }
+    }
+
+    for (i = 0; i < num_configs; i++) {
+        if (entries[i].obj < 0) {
+            best = -1; // system failure in one of the solves
+            break;
+        }
+        if (best < 0 || entries[i].obj > best_obj) {
+            best = i;
+            best_obj = entries[i].obj;
+        }
+    }
+    if (best < 0) {
+        best_obj = -1;
+        goto cleanup;
+    }
+
+    memcpy(res->best_dual, entries[best].res->best_dual, res->num_row * sizeof(double));
+    res->best_obj = best_obj;
+    res->working_obj = entries[best].res->working_obj;
+    res->num_itr = entries[best].res->num_itr;
+    res->stop_reason = entries[best].res->stop_reason;
+    memcpy(res->phase_time, entries[best].res->phase_time, SCP_NUM_PHASES * sizeof(double));
+    memcpy(res->phase_counters, entries[best].res->phase_counters, sizeof(res->phase_counters));
+    res->upper_bound = HUGE_VAL; // best cover of any solve
+    for (i = 0; i < num_configs; i++) {
+        if (entries[i].res->upper_bound < res->upper_bound) {
+            res->upper_bound = entries[i].res->upper_bound;
+        }
+    }
+    if (winner != NULL) *winner = best;
+
+cleanup:
+    if (entries != NULL) {
+        for (i = 0; i < num_configs; i++) {
+            free_scp_result(entries[i].res);
+        }
+    }
+    free(entries);
+    free(threads);
+    free(started);
+    return best_obj;
+}
@@ -0,0 +1,440 @@
+/***
+Presolve reductions on an SCP instance.
+
+Reductions run on active masks of rows and columns of the original matrix, with the
+number of active entries of every row and column kept up to date:
+
+- a row with a single active column forces that column to 1, its cost goes to
+  fixed_cost and the rows it covers are removed;
+- a column is removed if its cost exceeds the sum over its rows of the cheapest other
+  column of the row, since those columns cover it for less;
+- a column is removed if a column of no greater cost covers all of its rows;
+- a row is removed if it contains all columns of another row, covering the smaller
+  row covers it.
+
+Removing a column may leave singleton rows and removing a row may leave dominated
+columns, so the reductions are repeated until nothing changes. The column reductions only
+hold for the instance as given: once branch and bound fixes a dominating column to 0,
+the columns it replaced may be needed. A fixable presolve therefore removes dominated
+rows only, which stay dominated under any fixing, and keeps every column. The pairwise checks
+share a work limit proportional to the number of nonzeros. The remaining rows and
+columns are copied to a compact instance that keeps the maps back to the original.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "scp_internal.h"
+
+
+#define MAX_ROUNDS      8   // passes over all reductions
+#define WORK_PER_NZ     64  // work limit of pairwise dominance, per nonzero
+
+typedef struct {
+    const scp_instance *inst;
+    unsigned char *row_active, *col_active;
+    int *row_count;         // active columns of each row
+    int *col_count;         // active rows of each column
+    int *row_mark, *hit_mark;  // stamps of the current column (row) check
+    int *row_hits, *touched;  // shared columns and touched rows of a row check
+    int mark;
+    long long work, work_limit;
+    unsigned char infeasible;
+    unsigned char fixable;  // row dominance only, all columns stay
+    scp_presolve_stats *stats;
+} presolve_state;
+
+
+static void remove_row(presolve_state *ps, int row)
+{
+    int j, col;
+    const scp_instance *inst = ps->inst;
+
+    ps->row_active[row] = 0;
+    for (j = inst->row_wise_idx[row]; j < inst->row_wise_idx[row+1]; j++) {
+        col = ROW_AT(inst, j);
+        if (ps->col_active[col] && --ps->col_count[col] == 0 && !ps->fixable) {
+            ps->col_active[col] = 0; // covers nothing anymore
+            ps->stats->empty_cols++;
+        }
+    }
+}
+
+
+static void remove_col(presolve_state *ps, int col)
+{
+    int j, row;
+    const scp_instance *inst = ps->inst;
+
+    ps->col_active[col] = 0;
+    for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+        row = COL_AT(inst, j);
+        if (ps->row_active[row] && --ps->row_count[row] == 0) {
+            ps->infeasible = 1;
+        }
+    }
+}
+
+
+static void force_col(presolve_state *ps, int col)
+{
+    int j, row;
+    const scp_instance *inst = ps->inst;
+
+    ps->col_active[col] = 0;
+    ps->stats->forced_cols++;
+    ps->stats->fixed_cost += inst->costs[col];
+    for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+        row = COL_AT(inst, j);
+        if (ps->row_active[row]) remove_row(ps, row);
+    }
+}
+
+
+/* Forces the columns of singleton rows.
+Returns number of forced columns. */
+static int reduce_singleton_rows(presolve_state *ps)
+{
+    int i, j, n = 0;
+    const scp_instance *inst = ps->inst;
+
+    for (i = 0; i < inst->num_row; i++) {
+        if (!ps->row_active[i] || ps->row_count[i] != 1) continue;
+        for (j = inst->row_wise_idx[i]; !ps->col_active[ROW_AT(inst, j)]; j++) {
+            // find the active column
+        }
+        force_col(ps, ROW_AT(inst, j));
+        n++;
+    }
+    return n;
+}
+
+
+/* Removes columns costing more than the cheapest other columns of their rows, min1/min2
+hold the two lowest costs of each row and min_col the column of min1.
+Returns number of removed columns. */
+static int reduce_by_cover_sum(presolve_state *ps, double *min1, double *min2, int *min_col)
+{
+    int i, j, row, col, n = 0;
+    double sum, cost;
+    const scp_instance *inst = ps->inst;
+
+    for (i = 0; i < inst->num_row; i++) {
+        min1[i] = min2[i] = HUGE_VAL;
+        min_col[i] = -1;
+        if (!ps->row_active[i]) continue;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = ROW_AT(inst, j);
+            if (!ps->col_active[col]) continue;
+            cost = inst->costs[col];
+            if (cost < min1[i]) {
+                min2[i] = min1[i];
+                min1[i] = cost;
+                min_col[i] = col;
+            } else if (cost < min2[i]) {
+                min2[i] = cost;
+            }
+        }
+    }
+
+    for (i = 0; i < inst->num_col; i++) {
+        if (!ps->col_active[i]) continue;
+        sum = 0.0;
+        cost = inst->costs[i];
+        for (j = inst->col_wise_idx[i]; j < inst->col_wise_idx[i+1] && sum < cost; j++) {
+            row = COL_AT(inst, j);
+            if (!ps->row_active[row]) continue;
+            if (ps->row_count[row] < 2) break; // the only column left
+            sum += min_col[row] == i ? min2[row] : min1[row];
+        }
+        // the bounds are stale after removals, but every removed column is still priced
+        // against cheaper columns, which are themselves replaced only by cheaper ones
+        if (j == inst->col_wise_idx[i+1] && sum < cost) {
+            remove_col(ps, i);
+            n++;
+        }
+    }
+    return n;
+}
+
+
+/* Removes columns whose rows are all covered by one column of no greater cost, ties of
+identical columns keep the lower index.
+Returns number of removed columns. */
+static int reduce_dominated_cols(presolve_state *ps)
+{
+    int i, j, k, r, col, best, hits, n = 0;
+    const scp_instance *inst = ps->inst;
+
+    for (i = 0; i < inst->num_col; i++) {
+        if (!ps->col_active[i]) continue;
+        if (ps->work > ps->work_limit) {
+            ps->stats->work_limit_hit = 1;
+            break;
+        }
+
+        // candidates are the columns of the shortest row of i
+        ps->mark++;
+        best = -1;
+        for (j = inst->col_wise_idx[i]; j < inst->col_wise_idx[i+1]; j++) {
+            r = COL_AT(inst, j);
+            if (!ps->row_active[r]) continue;
+            ps->row_mark[r] = ps->mark;
+            if (best < 0 || ps->row_count[r] < ps->row_count[best]) best = r;
+        }
+        ps->work += inst->col_wise_idx[i+1] - inst->col_wise_idx[i];
+
+        for (j = inst->row_wise_idx[best]; j < inst->row_wise_idx[best+1]; j++) {
+            col = ROW_AT(inst, j);
+            if (col == i || !ps->col_active[col] || inst->costs[col] > inst->costs[i]
+                || ps->col_count[col] < ps->col_count[i]) continue;
+            if (inst->costs[col] == inst->costs[i] && ps->col_count[col] == ps->col_count[i]
+                && col > i) continue;
+
+            hits = 0;
+            for (k = inst->col_wise_idx[col]; k < inst->col_wise_idx[col+1]; k++) {
+                r = COL_AT(inst, k);
+                hits += ps->row_active[r] && ps->row_mark[r] == ps->mark;
+            }
+            ps->work += inst->col_wise_idx[col+1] - inst->col_wise_idx[col];
+            if (hits == ps->col_count[i]) {
+                remove_col(ps, i);
+                n++;
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+
+/* Removes rows containing all columns of another row, ties of identical rows keep the
+lower index.
+Returns number of removed rows. */
+static int reduce_dominated_rows(presolve_state *ps)
+{
+    int i, j, k, t, r, col, num_touched, n = 0;
+    const scp_instance *inst = ps->inst;
+
+    for (i = 0; i < inst->num_row; i++) {
+        if (!ps->row_active[i]) continue;
+        if (ps->work > ps->work_limit) {
+            ps->stats->work_limit_hit = 1;
+            break;
+        }
+
+        // count, for every row, the columns it shares with row i
+        num_touched = 0;
+        ps->mark++;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = ROW_AT(inst, j);
+            if (!ps->col_active[col]) continue;
+            for (k = inst->col_wise_idx[col]; k < inst->col_wise_idx[col+1]; k++) {
+                r = COL_AT(inst, k);
+                if (r == i || !ps->row_active[r]) continue;
+                if (ps->hit_mark[r] != ps->mark) {
+                    ps->hit_mark[r] = ps->mark;
+                    ps->row_hits[r] = 0;
+                    ps->touched[num_touched++] = r;
+                }
+                ps->row_hits[r]++;
+            }
+            ps->work += inst->col_wise_idx[col+1] - inst->col_wise_idx[col];
+        }
+
+        for (t = 0; t < num_touched; t++) {
+            r = ps->touched[t];
+            if (ps->row_hits[r] != ps->row_count[i] || !ps->row_active[r]) continue;
+            if (ps->row_count[r] == ps->row_count[i] && r < i) continue;
+            remove_row(ps, r);
+            n++;
+        }
+    }
+    return n;
+}
+
+
+/* Copies the active rows and columns of ps to presolved.
+Returns 0 on success, otherwise returns -1. */
+static int build_presolved(const presolve_state *ps, scp_instance *presolved)
+{
+    int i, j, k, row, col;
+    const scp_instance *inst = ps->inst;
+
+    MALLOC(presolved->row_index, int *, (inst->num_row > 0 ? inst->num_row : 1) * sizeof(int))
+    MALLOC(presolved->col_index, int *, (inst->num_col > 0 ? inst->num_col : 1) * sizeof(int))
+
+    presolved->num_row = presolved->num_col = presolved->num_nonzero = 0;
+    for (i = 0; i < inst->num_row; i++) {
+        presolved->row_index[i] = ps->row_active[i] ? presolved->num_row++ : -1;
+        presolved->num_nonzero += ps->row_active[i] ? ps->row_count[i] : 0;
+    }
+    for (i = 0; i < inst->num_col; i++) {
+        presolved->col_index[i] = ps->col_active[i] ? presolved->num_col++ : -1;
+    }
+
+    k = presolved->num_row > 0 ? presolved->num_row : 1;
+    MALLOC(presolved->row_map, int *, k * sizeof(int))
+    MALLOC(presolved->row_sizes, int *, k * sizeof(int))
+    MALLOC(presolved->row_wise_idx, int *, (presolved->num_row+1) * sizeof(int))
+    k = presolved->num_col > 0 ? presolved->num_col : 1;
+    MALLOC(presolved->col_map, int *, k * sizeof(int))
+    MALLOC(presolved->costs, int *, k * sizeof(int))
+    MALLOC(presolved->col_sizes, int *, k * sizeof(int))
+    k = presolved->num_nonzero > 0 ? presolved->num_nonzero : 1;
+    MALLOC(presolved->row_wise_a, int *, k * sizeof(int))
+
+    for (i = 0; i < inst->num_col; i++) {
+        if ((col = presolved->col_index[i]) < 0) continue;
+        presolved->col_map[col] = i;
+        presolved->costs[col] = inst->costs[i];
+        presolved->col_sizes[col] = ps->col_count[i];
+    }
+
+    // original columns are visited in order, so rows stay sorted by column
+    k = 0;
+    for (i = 0; i < inst->num_row; i++) {
+        if ((row = presolved->row_index[i]) < 0) continue;
+        presolved->row_map[row] = i;
+        presolved->row_wise_idx[row] = k;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            col = presolved->col_index[ROW_AT(inst, j)];
+            if (col >= 0) presolved->row_wise_a[k++] = col;
+        }
+        presolved->row_sizes[row] = k - presolved->row_wise_idx[row];
+    }
+    presolved->row_wise_idx[presolved->num_row] = k;
+
+    return build_col_wise_matrix(presolved, 0);
+}
+
+
+/* Creates presolved copy of inst with all reductions, or with row dominance only if
+fixable (see fix_scp_column_r). Reduction statistics are stored in stats (if not NULL).
+Returns NULL on failure or if presolve proves inst infeasible. */
+static scp_instance *presolve(const scp_instance *inst, scp_presolve_stats *stats, int fixable)
+{
+    int i, round, changed;
+    double *min1 = NULL, *min2 = NULL;
+    int *min_col = NULL;
+    struct timespec begin_t, end_t;
+    presolve_state ps;
+    scp_presolve_stats local_stats;
+    scp_instance *presolved = NULL;
+
+    if (inst->num_fixed > 0 || inst->parent != NULL) {
+        fprintf(stderr, "Error: cannot presolve a fixed or presolved instance\n");
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin_t);
+    if (stats == NULL) stats = &local_stats;
+    memset(stats, 0, sizeof(scp_presolve_stats));
+    stats->orig_num_row = inst->num_row;
+    stats->orig_num_col = inst->num_col;
+    stats->orig_num_nonzero = inst->num_nonzero;
+
+    memset(&ps, 0, sizeof(presolve_state));
+    ps.inst = inst;
+    ps.stats = stats;
+    ps.fixable = fixable != 0;
+    ps.work_limit = (long long) WORK_PER_NZ * inst->num_nonzero;
+    ps.row_active = (unsigned char *) malloc(inst->num_row + 1);
+    ps.col_active = (unsigned char *) malloc(inst->num_col + 1);
+    ps.row_count = (int *) malloc((inst->num_row + 1) * sizeof(int));
+    ps.col_count = (int *) malloc((inst->num_col + 1) * sizeof(int));
+    ps.row_mark = (int *) calloc(inst->num_row + 1, sizeof(int));
+    ps.hit_mark = (int *) calloc(inst->num_row + 1, sizeof(int));
+    ps.row_hits = (int *) malloc((inst->num_row + 1) * sizeof(int));
+    ps.touched = (int *) malloc((inst->num_row + 1) * sizeof(int));
+    min1 = (double *) malloc((inst->num_row + 1) * sizeof(double));
+    min2 = (double *) malloc((inst->num_row + 1) * sizeof(double));
+    min_col = (int *) malloc((inst->num_row + 1) * sizeof(int));
+    presolved = (scp_instance *) calloc(1, sizeof(scp_instance));
+    if (!ps.row_active || !ps.col_active || !ps.row_count || !ps.col_count || !ps.row_mark
+        || !ps.hit_mark || !ps.row_hits || !ps.touched || !min1 || !min2 || !min_col
+        || !presolved) {
+        perror("Error malloc");
+        goto fail;
+    }
+
+    for (i = 0; i < inst->num_row; i++) {
+        ps.row_active[i] = 1;
+        ps.row_count[i] = inst->row_wise_idx[i+1] - inst->row_wise_idx[i];
+        ps.infeasible |= ps.row_count[i] == 0;
+    }
+    for (i = 0; i < inst->num_col; i++) {
+        ps.col_count[i] = inst->col_wise_idx[i+1] - inst->col_wise_idx[i];
+        ps.col_active[i] = ps.col_count[i] > 0 || ps.fixable;
+        stats->empty_cols += ps.col_count[i] == 0 && !ps.fixable;
+    }
+
+    for (round = 0, changed = 1; changed && round < MAX_ROUNDS && !ps.infeasible; round++) {
+        changed = 0;
+        if (!ps.fixable) {
+            changed = reduce_singleton_rows(&ps);
+            i = reduce_by_cover_sum(&ps, min1, min2, min_col);
+            i += reduce_dominated_cols(&ps);
+            stats->dominated_cols += i;
+            changed += i;
+        }
+        i = reduce_dominated_rows(&ps);
+        stats->dominated_rows += i;
+        changed += i;
+    }
+    stats->rounds = round;
+    if (ps.infeasible) {
+        fprintf(stderr, "Error: presolve found an uncoverable row\n");
+        goto fail;
+    }
+
+    presolved->parent = inst;
+    presolved->cols_reduced = !ps.fixable;
+    presolved->fixed_cost = stats->fixed_cost;
+    if (build_presolved(&ps, presolved)) goto fail;
+
+    stats->num_row = presolved->num_row;
+    stats->num_col = presolved->num_col;
+    stats->num_nonzero = presolved->num_nonzero;
+    clock_gettime(CLOCK_MONOTONIC, &end_t);
+    stats->time = (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_nsec - begin_t.tv_nsec) * 1e-9;
+    goto cleanup;
+
+fail:
+    free_scp_instance_r(presolved);
+    presolved = NULL;
+cleanup:
+    free(ps.row_active);
+    free(ps.col_active);
+    free(ps.row_count);
+    free(ps.col_count);
+    free(ps.row_mark);
+    free(ps.hit_mark);
+    free(ps.row_hits);
+    free(ps.touched);
+    free(min1);
+    free(min2);
+    free(min_col);
+    return presolved;
+}
+
+
+/* Creates presolved copy of inst, which must not be fixed or presolved already. Reduction
+statistics are stored in stats (if not NULL).
+Returns NULL on failure or if presolve proves inst infeasible. */
+scp_instance *presolve_scp_instance_r(const scp_instance *inst, scp_presolve_stats *stats)
+{
+    return presolve(inst, stats, 0);
+}
+
+
+/* Creates presolved copy of inst that can be fixed, see presolve_scp_instance_r.
+Returns NULL on failure or if presolve proves inst infeasible. */
+scp_instance *presolve_scp_instance_fixable_r(const scp_instance *inst,
+                                              scp_presolve_stats *stats)
+{
+    return presolve(inst, stats, 1);
+}
@@ -0,0 +1,304 @@
+/***
+Locality-improving reordering of an SCP instance.
+
+Rows and columns are renumbered by reverse Cuthill-McKee on the bipartite row-column
+graph: a breadth-first search from a peripheral row numbers rows in the order they are
+reached and columns in the order they are first met, visiting the columns of a row by
+increasing size, and both orders are reversed at the end. Rows sharing columns so get
+close numbers, and so do columns sharing rows, which keeps the scatters of the dual
+update (over the columns of a row) and of the subgradient (over the rows of a column)
+within few cache lines. Every component of the graph is searched in turn, columns of no
+row go last.
+
+The reordered instance keeps the maps to the instance it was made from, like a presolved
+one, so results are reported in the original indices.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scp_internal.h"
+
+
+typedef struct {
+    const scp_instance *inst;
+    int *row_order;         // rows in search order
+    int *col_order;         // columns in search order
+    int *row_seen, *col_seen;
+    long long *keys;        // (size, column) pairs of the columns to visit from a row
+    int num_rows_seen, num_cols_seen;
+} rcm_state;
+
+
+static int compare_key(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+
+/* Searches the component of row start, appending its rows and columns to the orders.
+Returns the last row reached, a row farthest from start. */
+static int search_component(rcm_state *rs, int start)
+{
+    int i, j, k, n, row, col, size, head;
+    const scp_instance *inst = rs->inst;
+
+    head = rs->num_rows_seen;
+    rs->row_order[rs->num_rows_seen++] = start;
+    rs->row_seen[start] = 1;
+    row = start;
+    while (head < rs->num_rows_seen) {
+        row = rs->row_order[head++];
+
+        // new columns of the row, smallest first
+        n = 0;
+        for (j = inst->row_wise_idx[row]; j < inst->row_wise_idx[row+1]; j++) {
+            col = ROW_AT(inst, j);
+            if (rs->col_seen[col]) continue;
+            rs->col_seen[col] = 1;
+            size = inst->col_wise_idx[col+1] - inst->col_wise_idx[col];
+            rs->keys[n++] = ((long long) size << 32) | col;
+        }
+        qsort(rs->keys, n, sizeof(long long), compare_key);
+
+        for (k = 0; k < n; k++) {
+            col = (int) (rs->keys[k] & 0xffffffffLL);
+            rs->col_order[rs->num_cols_seen++] = col;
+            for (i = inst->col_wise_idx[col]; i < inst->col_wise_idx[col+1]; i++) {
+                if (!rs->row_seen[COL_AT(inst, i)]) {
+                    rs->row_seen[COL_AT(inst, i)] = 1;
+                    rs->row_order[rs->num_rows_seen++] = COL_AT(inst, i);
+                }
+            }
+        }
+    }
+    return row;
+}
+
+
+/* Clears the marks of the rows and columns searched since num_rows and num_cols. */
+static void unsearch(rcm_state *rs, int num_rows, int num_cols)
+{
+    int k;
+
+    for (k = num_rows; k < rs->num_rows_seen; k++) rs->row_seen[rs->row_order[k]] = 0;
+    for (k = num_cols; k < rs->num_cols_seen; k++) rs->col_seen[rs->col_order[k]] = 0;
+    rs->num_rows_seen = num_rows;
+    rs->num_cols_seen = num_cols;
+}
+
+
+/* Numbers the rows and columns of rs->inst in reverse Cuthill-McKee order. */
+static void rcm_order(rcm_state *rs)
+{
+    int i, k, tmp, start, num_rows, num_cols;
+    const scp_instance *inst = rs->inst;
+
+    for (i = 0; i < inst->num_row; i++) {
+        if (rs->row_seen[i]) continue;
+
+        // start from the smallest row of the component, then move the start to the far
+        // end of a first search, which gives longer and narrower levels
+        start = i;
+        num_rows = rs->num_rows_seen;
+        num_cols = rs->num_cols_seen;
+        search_component(rs, start);
+        for (k = num_rows; k < rs->num_rows_seen; k++) {
+            tmp = rs->row_order[k];
+            if (inst->row_wise_idx[tmp+1] - inst->row_wise_idx[tmp]
+                < inst->row_wise_idx[start+1] - inst->row_wise_idx[start]) {
+                start = tmp;
+            }
+        }
+        unsearch(rs, num_rows, num_cols);
+        start = search_component(rs, start);
+        unsearch(rs, num_rows, num_cols);
+        search_component(rs, start);
+    }
+
+    for (i = 0, k = rs->num_rows_seen - 1; i < k; i++, k--) {
+        tmp = rs->row_order[i];
+        rs->row_order[i] = rs->row_order[k];
+        rs->row_order[k] = tmp;
+    }
+    for (i = 0, k = rs->num_cols_seen - 1; i < k; i++, k--) {
+        tmp = rs->col_order[i];
+        rs->col_order[i] = rs->col_order[k];
+        rs->col_order[k] = tmp;
+    }
+    // columns of no row go last
+    for (i = 0; i < inst->num_col; i++) {
+        if (!rs->col_seen[i]) rs->col_order[rs->num_cols_seen++] = i;
+    }
+}
+
+
+/* Returns average over the rows of inst of the distance between first and last column,
+and stores the same average over the columns in col_span. */
+static double average_span(const scp_instance *inst, double *col_span)
+{
+    int i, j, lo, hi;
+    double sum = 0.0;
+
+    for (i = 0; i < inst->num_row; i++) {
+        lo = inst->num_col;
+        hi = -1;
+        for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+            lo = ROW_AT(inst, j) < lo ? ROW_AT(inst, j) : lo;
+            hi = ROW_AT(inst, j) > hi ? ROW_AT(inst, j) : hi;
+        }
+        sum += hi >= lo ? hi - lo : 0;
+    }
+    *col_span = 0.0;
+    for (i = 0; i < inst->num_col; i++) {
+        j = inst->col_wise_idx[i];
+        if (j < inst->col_wise_idx[i+1]) {
+            // columns are sorted by row
+            *col_span += COL_AT(inst, inst->col_wise_idx[i+1]-1) - COL_AT(inst, j);
+        }
+    }
+    *col_span /= inst->num_col > 0 ? inst->num_col : 1;
+    return sum / (inst->num_row > 0 ? inst->num_row : 1);
+}
+
+
+/* Copies inst to reordered, in the order of rs, with maps to the parent of inst (if it
+has one) or inst itself.
+Returns 0 on success, otherwise returns -1. */
+static int build_reordered(const rcm_state *rs, scp_instance *reordered)
+{
+    int i, j, k, row, col;
+    int *new_col;
+    const scp_instance *inst = rs->inst;
+    const scp_instance *parent = inst->parent ? inst->parent : inst;
+
+    reordered->num_row = inst->num_row;
+    reordered->num_col = inst->num_col;
+    reordered->num_nonzero = inst->num_nonzero;
+    reordered->parent = parent;
+    reordered->fixed_cost = inst->fixed_cost;
+    reordered->cols_reduced = inst->cols_reduced;
+
+    k = inst->num_row > 0 ? inst->num_row : 1;
+    MALLOC(reordered->row_map, int *, k * sizeof(int))
+    MALLOC(reordered->row_sizes, int *, k * sizeof(int))
+    MALLOC(reordered->row_wise_idx, int *, (inst->num_row+1) * sizeof(int))
+    k = inst->num_col > 0 ? inst->num_col : 1;
+    MALLOC(reordered->col_map, int *, k * sizeof(int))
+    MALLOC(reordered->costs, int *, k * sizeof(int))
+    MALLOC(reordered->col_sizes, int *, k * sizeof(int))
+    k = inst->num_nonzero > 0 ? inst->num_nonzero : 1;
+    MALLOC(reordered->row_wise_a, int *, k * sizeof(int))
+    k = parent->num_row > 0 ? parent->num_row : 1;
+    MALLOC(reordered->row_index, int *, k * sizeof(int))
+    k = parent->num_col > 0 ? parent->num_col : 1;
+    MALLOC(reordered->col_index, int *, k * sizeof(int))
+
+    // maps of inst to its parent are composed with the new order
+    for (i = 0; i < parent->num_row; i++) reordered->row_index[i] = -1;
+    for (i = 0; i < parent->num_col; i++) reordered->col_index[i] = -1;
+    for (i = 0; i < inst->num_row; i++) {
+        row = rs->row_order[i];
+        reordered->row_map[i] = inst->row_map ? inst->row_map[row] : row;
+        reordered->row_index[reordered->row_map[i]] = i;
+    }
+    for (i = 0; i < inst->num_col; i++) {
+        col = rs->col_order[i];
+        reordered->col_map[i] = inst->col_map ? inst->col_map[col] : col;
+        reordered->col_index[reordered->col_map[i]] = i;
+        reordered->costs[i] = inst->costs[col];
+        reordered->col_sizes[i] = inst->col_wise_idx[col+1] - inst->col_wise_idx[col];
+    }
+
+    // rows in the new order, then columns from them (sorted by row), then the rows again
+    // from the columns, which sorts them by column
+    new_col = inst->parent ? NULL : reordered->col_index;
+    if (new_col == NULL) {
+        MALLOC(new_col, int *, (inst->num_col > 0 ? inst->num_col : 1) * sizeof(int))
+        for (i = 0; i < inst->num_col; i++) new_col[rs->col_order[i]] = i;
+    }
+    k = 0;
+    for (i = 0; i < inst->num_row; i++) {
+        row = rs->row_order[i];
+        reordered->row_wise_idx[i] = k;
+        for (j = inst->row_wise_idx[row]; j < inst->row_wise_idx[row+1]; j++) {
+            reordered->row_wise_a[k++] = new_col[ROW_AT(inst, j)];
+        }
+        reordered->row_sizes[i] = k - reordered->row_wise_idx[i];
+    }
+    reordered->row_wise_idx[inst->num_row] = k;
+    if (new_col != reordered->col_index) free(new_col);
+    if (build_col_wise_matrix(reordered, 0)) return -1;
+
+    // start indices serve as insertion points, so that each ends up as the next start
+    for (i = 0; i < inst->num_col; i++) {
+        for (j = reordered->col_wise_idx[i]; j < reordered->col_wise_idx[i+1]; j++) {
+            row = reordered->col_wise_a[j];
+            reordered->row_wise_a[reordered->row_wise_idx[row]++] = i;
+        }
+    }
+    for (i = inst->num_row; i > 0; i--) {
+        reordered->row_wise_idx[i] = reordered->row_wise_idx[i-1];
+    }
+    reordered->row_wise_idx[0] = 0;
+    return 0;
+}
+
+
+/* Creates copy of inst with rows and columns in reverse Cuthill-McKee order. inst must not
+be fixed, it may be presolved or reordered. Locality statistics are stored in
+stats (if not NULL).
+Returns NULL on failure. */
+scp_instance *reorder_scp_instance_r(const scp_instance *inst, scp_reorder_stats *stats)
+{
+    struct timespec begin_t, end_t;
+    rcm_state rs;
+    scp_reorder_stats local_stats;
+    scp_instance *reordered = NULL;
+
+    if (inst->num_fixed > 0) {
+        fprintf(stderr, "Error: cannot reorder a fixed instance\n");
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin_t);
+    if (stats == NULL) stats = &local_stats;
+    memset(stats, 0, sizeof(scp_reorder_stats));
+    stats->row_span_before = average_span(inst, &stats->col_span_before);
+
+    memset(&rs, 0, sizeof(rcm_state));
+    rs.inst = inst;
+    rs.row_order = (int *) malloc((inst->num_row + 1) * sizeof(int));
+    rs.col_order = (int *) malloc((inst->num_col + 1) * sizeof(int));
+    rs.row_seen = (int *) calloc(inst->num_row + 1, sizeof(int));
+    rs.col_seen = (int *) calloc(inst->num_col + 1, sizeof(int));
+    rs.keys = (long long *) malloc((inst->num_col + 1) * sizeof(long long));
+    reordered = (scp_instance *) calloc(1, sizeof(scp_instance));
+    if (!rs.row_order || !rs.col_order || !rs.row_seen || !rs.col_seen || !rs.keys
+        || !reordered) {
+        perror("Error malloc");
+        goto fail;
+    }
+
+    rcm_order(&rs);
+    if (build_reordered(&rs, reordered)) goto fail;
+
+    stats->row_span_after = average_span(reordered, &stats->col_span_after);
+    clock_gettime(CLOCK_MONOTONIC, &end_t);
+    stats->time = (end_t.tv_sec - begin_t.tv_sec) + (end_t.tv_nsec - begin_t.tv_nsec) * 1e-9;
+    goto cleanup;
+
+fail:
+    free_scp_instance_r(reordered);
+    reordered = NULL;
+cleanup:
+    free(rs.row_order);
+    free(rs.col_order);
+    free(rs.row_seen);
+    free(rs.col_seen);
+    free(rs.keys);
+    return reordered;
+}
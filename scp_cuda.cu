@@ -0,0 +1,951 @@
+/***
+CUDA backend of the subgradient methods
+
+The constraint matrix (both orientations), the costs and the working vectors stay in
+device memory for the whole solve, and the matrix also for the following solves on the
+same instance and result handle (fixings only send the costs and covered rows again).
+Each evaluation gathers the reduced costs of all columns again, one thread per column,
+which on the device is cheaper than the incremental scatters of the CPU kernels. The
+negative sum, the subgradient and the dot products of the step are block reductions into
+one device_sums record, and that record is the only data read back per iteration, except
+for the reduced costs of the Lagrangian heuristic; the host runs the control flow of the
+CPU solvers (line search, best solution, termination) on those scalars. Double atomics
+need sm_60 or newer.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <cuda_runtime.h>
+extern "C" {
+#include "scp_internal.h"
+}
+
+
+#define BLOCK       256     // threads per block, a multiple of the warp size
+#define MAX_GRID    4096    // blocks per launch, the grid-stride loops cover the rest
+
+#define CUDA_CHECK(call)    { cudaError_t e_ = (call); if (e_ != cudaSuccess) { \
+                                fprintf(stderr, "Error cuda: %s\n", cudaGetErrorString(e_)); \
+                                return -1; } }
+
+// phase timers, the device is synchronized so that its work counts to the phase
+#define PHASE_MARK(on, mark)            if (on) { cudaDeviceSynchronize(); \
+                                                  (mark) = wall_seconds(); }
+#define PHASE_ADD(on, mark, total)      if (on) { cudaDeviceSynchronize(); \
+                                                  double t_ = wall_seconds(); \
+                                                  (total) += t_ - (mark); (mark) = t_; }
+
+#define GRID_STRIDE(i, n)   for (i = blockIdx.x * blockDim.x + threadIdx.x; i < (n); \
+                                 i += blockDim.x * gridDim.x)
+
+
+/* Totals of the reductions of the kernels launched since the last reset, the only data
+read back per iteration. */
+typedef struct {
+    double sum;                     // dual sum, negative reduced cost sum or dual shift
+    double product;                 // SPS: dd . momentum
+    double dd_dd, dd_dg;            // SPS: dot products of the spectral step length
+    unsigned long long norm;        // squared norm of the subgradient
+    unsigned long long proj_norm;   // same without the rows BSM projects to 0
+    int nonzero;                    // nonzero entries of the subgradient
+    int moved;                      // rows whose dual moved
+} device_sums;
+
+/* Device copy of an instance and the working vectors of the solves on it. */
+struct scp_device {
+    int num_row, num_col, num_nonzero, memory;  // sizes the buffers were allocated for
+    int *costs, *col_wise_a, *col_wise_idx, *row_wise_a, *row_wise_idx;
+    int *row_covered;               // rows covered by fixed columns if > 0
+    scp_real *reduced_costs, *dual1, *dual2, *momentum, *dd;
+    int *subg, *dd_subg;            // subgradient, and the one the step was taken along
+    unsigned char *below;           // reduced cost < SUBG_TOL
+    device_sums *sums;
+
+    // instance the buffers hold, so that repeated solves on it only send what changed
+    const scp_instance *inst;       // NULL if none
+    const void *inst_col_wise_a;    // its matrix and size, in case the address is reused
+    int inst_nonzero;
+    int inst_fix_version;           // of the costs and covered rows sent
+
+    // host buffers
+    scp_real *host;                 // pinned staging of num_col (>= num_row) entries
+    double *past_objs;
+};
+
+
+template <typename T>
+static __device__ void block_add(T value, T *total)
+{
+    __shared__ T warp_sums[BLOCK / 32];
+    const int lane = threadIdx.x % 32, warp = threadIdx.x / 32;
+    int off;
+
+    __syncthreads(); // warp_sums may still be read by a previous call
+    for (off = 16; off > 0; off /= 2) {
+        value += __shfl_down_sync(0xffffffff, value, off);
+    }
+    if (lane == 0) warp_sums[warp] = value;
+    __syncthreads();
+    if (warp == 0) {
+        value = lane < BLOCK / 32 ? warp_sums[lane] : (T) 0;
+        for (off = 16; off > 0; off /= 2) {
+            value += __shfl_down_sync(0xffffffff, value, off);
+        }
+        if (lane == 0) atomicAdd(total, value);
+    }
+}
+
+
+// dual_i = min(cost_j / size_j) over the columns j of row i, 0 for covered rows
+static __global__ void init_dual_kernel(int num_row, const int *costs, const int *col_wise_idx,
+                                        const int *row_wise_idx, const int *row_wise_a,
+                                        const int *row_covered, scp_real *dual,
+                                        device_sums *sums)
+{
+    int i, j, idx;
+    double min_value, value, dual_sum = 0.0;
+
+    GRID_STRIDE(i, num_row) {
+        min_value = costs[row_wise_a[row_wise_idx[i]]];
+        for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+            idx = row_wise_a[j];
+            value = (double) costs[idx] / (col_wise_idx[idx+1] - col_wise_idx[idx]);
+            if (value < min_value) {
+                min_value = value;
+            }
+        }
+        if (row_covered != NULL && row_covered[i]) {
+            min_value = 0.0;
+        }
+        dual[i] = min_value;
+        dual_sum += dual[i];
+    }
+    block_add(dual_sum, &sums->sum);
+}
+
+
+// reduced costs of dual, one thread per column, and the sum of the negative ones
+static __global__ void reduced_costs_kernel(int num_col, const int *costs,
+                                            const int *col_wise_idx, const int *col_wise_a,
+                                            const scp_real *dual, scp_real *reduced_costs,
+                                            unsigned char *below, device_sums *sums)
+{
+    int i, j;
+    double value, neg_sum = 0.0;
+    scp_real rc;
+
+    GRID_STRIDE(i, num_col) {
+        value = costs[i];
+        for (j = col_wise_idx[i]; j < col_wise_idx[i+1]; j++) {
+            value -= dual[col_wise_a[j]];
+        }
+        reduced_costs[i] = rc = value;
+        below[i] = rc < SUBG_TOL;
+        if (rc < 0) {
+            neg_sum += rc;
+        }
+    }
+    block_add(neg_sum, &sums->sum);
+}
+
+
+/* subg_i = 1 - #{col j in row i : reduced cost < SUBG_TOL}, 0 for covered rows. proj_norm
+leaves out the rows that BSM projects to 0 at dual. */
+static __global__ void subgradient_kernel(int num_row, const int *row_wise_idx,
+                                          const int *row_wise_a, const unsigned char *below,
+                                          const int *row_covered, const scp_real *dual,
+                                          int *subg, device_sums *sums)
+{
+    int i, j, g, nonzero = 0;
+    unsigned long long norm = 0, proj_norm = 0;
+
+    GRID_STRIDE(i, num_row) {
+        g = 1;
+        for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+            g -= below[row_wise_a[j]];
+        }
+        if (row_covered != NULL && row_covered[i]) {
+            g = 0;
+        }
+        subg[i] = g;
+        nonzero += g != 0;
+        norm += g * g;
+        if (g > 0 || (g < 0 && dual[i] >= SUBG_TOL)) {
+            proj_norm += g * g;
+        }
+    }
+    block_add(nonzero, &sums->nonzero);
+    block_add(norm, &sums->norm);
+    block_add(proj_norm, &sums->proj_norm);
+}
+
+
+// SPS step of the dual vector along the momentum term, dd keeps the (projected) step
+static __global__ void sps_step_kernel(int num_row, double alpha, double mu, const int *subg,
+                                       const scp_real *old_dual, scp_real *curr_dual,
+                                       scp_real *momentum, scp_real *dd, int *dd_subg,
+                                       device_sums *sums)
+{
+    int i, moved = 0;
+    double value, dual_sum = 0.0, product = 0.0;
+
+    GRID_STRIDE(i, num_row) {
+        momentum[i] = alpha * subg[i] + mu * momentum[i];
+        value = old_dual[i] + momentum[i];
+        if (value < 0) {
+            value = 0;
+        }
+        value -= old_dual[i];
+        if (value < - ZERO_TOL || value > ZERO_TOL) {
+            curr_dual[i] = old_dual[i] + value;
+            product += value * momentum[i];
+            moved++;
+        } else {
+            curr_dual[i] = old_dual[i];
+            value = 0.0;
+        }
+        dd[i] = value;
+        dd_subg[i] = subg[i];
+        dual_sum += curr_dual[i];
+    }
+    block_add(dual_sum, &sums->sum);
+    block_add(product, &sums->product);
+    block_add(moved, &sums->moved);
+}
+
+
+// line search: dual -= back * dd, sum of the stored changes
+static __global__ void step_back_kernel(int num_row, double back, const scp_real *dd,
+                                        scp_real *dual, device_sums *sums)
+{
+    int i;
+    double value, shift = 0.0;
+    scp_real old;
+
+    GRID_STRIDE(i, num_row) {
+        value = back * dd[i];
+        if (value < - ZERO_TOL || value > ZERO_TOL) {
+            old = dual[i];
+            dual[i] = old - value;
+            shift += old - dual[i];
+        }
+    }
+    block_add(shift, &sums->sum);
+}
+
+
+// dot products of the spectral step length, dd is zero for the rows that did not move
+static __global__ void step_length_kernel(int num_row, const scp_real *dd, const int *dd_subg,
+                                          const int *subg, device_sums *sums)
+{
+    int i;
+    double value, aa = 0.0, ag = 0.0;
+
+    GRID_STRIDE(i, num_row) {
+        value = dd[i];
+        aa += value * value;
+        ag += value * (dd_subg[i] - subg[i]);
+    }
+    block_add(aa, &sums->dd_dd);
+    block_add(ag, &sums->dd_dg);
+}
+
+
+// BSM step of the dual vector along the projected subgradient
+static __global__ void bsm_step_kernel(int num_row, double step_size, const int *subg,
+                                       const scp_real *old_dual, scp_real *curr_dual,
+                                       device_sums *sums)
+{
+    int i, g, moved = 0;
+    double value, dual_sum = 0.0;
+
+    GRID_STRIDE(i, num_row) {
+        g = subg[i];
+        if (g < 0 && old_dual[i] < SUBG_TOL) {
+            g = 0; // projected
+        }
+        value = step_size * g;
+        curr_dual[i] = old_dual[i] + value;
+        if (curr_dual[i] < 0) {
+            value -= curr_dual[i];
+            curr_dual[i] = 0.0;
+        }
+        moved += value < - ZERO_TOL || value > ZERO_TOL;
+        dual_sum += curr_dual[i];
+    }
+    block_add(dual_sum, &sums->sum);
+    block_add(moved, &sums->moved);
+}
+
+
+static int grid_size(int n)
+{
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    return blocks < 1 ? 1 : blocks > MAX_GRID ? MAX_GRID : blocks;
+}
+
+
+static double wall_seconds()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+int cuda_device_count(void)
+{
+    int count;
+
+    if (cudaGetDeviceCount(&count) != cudaSuccess) return 0;
+    return count;
+}
+
+
+void free_scp_device(scp_device *dev)
+{
+    if (dev == NULL) return;
+    cudaFree(dev->costs);
+    cudaFree(dev->col_wise_a);
+    cudaFree(dev->col_wise_idx);
+    cudaFree(dev->row_wise_a);
+    cudaFree(dev->row_wise_idx);
+    cudaFree(dev->row_covered);
+    cudaFree(dev->reduced_costs);
+    cudaFree(dev->dual1);
+    cudaFree(dev->dual2);
+    cudaFree(dev->momentum);
+    cudaFree(dev->dd);
+    cudaFree(dev->subg);
+    cudaFree(dev->dd_subg);
+    cudaFree(dev->below);
+    cudaFree(dev->sums);
+    cudaFreeHost(dev->host);
+    free(dev->past_objs);
+    free(dev);
+}
+
+
+/* Makes sure ws holds device buffers for inst and a line search memory of M objective
+values, keeping the current ones if they fit.
+Returns 0 on success, otherwise returns -1. */
+static int reserve_device(scp_workspace *ws, const scp_instance *inst, int M)
+{
+    scp_device *dev = ws->dev;
+    const int num_row = inst->num_row > 0 ? inst->num_row : 1;
+    const int num_col = inst->num_col > num_row ? inst->num_col : num_row;
+    const int num_nonzero = inst->num_nonzero > 0 ? inst->num_nonzero : 1;
+
+    if (dev != NULL && dev->num_row == num_row && dev->num_col >= num_col
+        && dev->num_nonzero >= num_nonzero && dev->memory >= M) {
+        return 0;
+    }
+
+    free_scp_device(dev);
+    if ((ws->dev = dev = (scp_device *) calloc(1, sizeof(scp_device))) == NULL) {
+        perror("Error malloc"); return -1;
+    }
+    CUDA_CHECK(cudaMalloc(&dev->costs, num_col * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->col_wise_a, num_nonzero * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->col_wise_idx, (num_col + 1) * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->row_wise_a, num_nonzero * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->row_wise_idx, (num_row + 1) * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->row_covered, num_row * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->reduced_costs, num_col * sizeof(scp_real)))
+    CUDA_CHECK(cudaMalloc(&dev->dual1, num_row * sizeof(scp_real)))
+    CUDA_CHECK(cudaMalloc(&dev->dual2, num_row * sizeof(scp_real)))
+    CUDA_CHECK(cudaMalloc(&dev->momentum, num_row * sizeof(scp_real)))
+    CUDA_CHECK(cudaMalloc(&dev->dd, num_row * sizeof(scp_real)))
+    CUDA_CHECK(cudaMalloc(&dev->subg, num_row * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->dd_subg, num_row * sizeof(int)))
+    CUDA_CHECK(cudaMalloc(&dev->below, num_col * sizeof(unsigned char)))
+    CUDA_CHECK(cudaMalloc(&dev->sums, sizeof(device_sums)))
+    CUDA_CHECK(cudaMallocHost(&dev->host, num_col * sizeof(scp_real)))
+    MALLOC(dev->past_objs, double *, (M > 0 ? M : 1) * sizeof(double))
+    dev->num_row = num_row;
+    dev->num_col = num_col;
+    dev->num_nonzero = num_nonzero;
+    dev->memory = M;
+    return 0;
+}
+
+
+/* Copies costs (with the blocked costs of fixed columns) and covered rows of inst to dev.
+Returns 0 on success, otherwise returns -1. */
+static int upload_fixings(scp_device *dev, const scp_instance *inst)
+{
+    CUDA_CHECK(cudaMemcpy(dev->costs, inst->costs, inst->num_col * sizeof(int),
+                          cudaMemcpyHostToDevice))
+    if (inst->num_covered > 0) {
+        CUDA_CHECK(cudaMemcpy(dev->row_covered, inst->row_covered, inst->num_row * sizeof(int),
+                              cudaMemcpyHostToDevice))
+    }
+    dev->inst_fix_version = inst->fix_version;
+    return 0;
+}
+
+
+/* Copies the n entries of an index array to dst on the device, widening a 16-bit array
+(the compact layout has no int one) in a host buffer.
+Returns 0 on success, otherwise returns -1. */
+static int upload_index(int *dst, const uint16_t *a16, const int *a32, int n)
+{
+    int j, *buf;
+    cudaError_t e;
+
+    if (a16 == NULL) {
+        CUDA_CHECK(cudaMemcpy(dst, a32, n * sizeof(int), cudaMemcpyHostToDevice))
+        return 0;
+    }
+    MALLOC(buf, int *, (n > 0 ? n : 1) * sizeof(int))
+    for (j = 0; j < n; j++) {
+        buf[j] = a16[j];
+    }
+    e = cudaMemcpy(dst, buf, n * sizeof(int), cudaMemcpyHostToDevice);
+    free(buf);
+    CUDA_CHECK(e)
+    return 0;
+}
+
+
+/* Copies matrix, costs (with the blocked costs of fixed columns) and covered rows of inst
+to dev. The matrix stays on the device for the next solves on inst, and costs and covered
+rows are sent again only after fixings changed them; solves on one handle may alternate
+between instances, which uploads everything.
+Returns 0 on success, otherwise returns -1. */
+static int upload_instance(scp_device *dev, const scp_instance *inst)
+{
+    const int num_row = inst->num_row;
+    const int num_col = inst->num_col;
+    const int num_nonzero = inst->num_nonzero;
+    const void *col_wise_a = inst->col_wise_a16 ? (const void *) inst->col_wise_a16
+                             : (const void *) inst->col_wise_a;
+
+    if (dev->inst == inst && dev->inst_col_wise_a == col_wise_a
+        && dev->inst_nonzero == num_nonzero) {
+        if (dev->inst_fix_version == inst->fix_version) return 0;
+        return upload_fixings(dev, inst);
+    }
+
+    dev->inst = NULL; // until the upload completes
+    if (upload_index(dev->col_wise_a, inst->col_wise_a16, inst->col_wise_a, num_nonzero)) return -1;
+    CUDA_CHECK(cudaMemcpy(dev->col_wise_idx, inst->col_wise_idx, (num_col + 1) * sizeof(int),
+                          cudaMemcpyHostToDevice))
+    if (upload_index(dev->row_wise_a, inst->row_wise_a16, inst->row_wise_a, num_nonzero)) return -1;
+    CUDA_CHECK(cudaMemcpy(dev->row_wise_idx, inst->row_wise_idx, (num_row + 1) * sizeof(int),
+                          cudaMemcpyHostToDevice))
+    if (upload_fixings(dev, inst)) return -1;
+    dev->inst = inst;
+    dev->inst_col_wise_a = col_wise_a;
+    dev->inst_nonzero = num_nonzero;
+    return 0;
+}
+
+
+static int reset_sums(scp_device *dev)
+{
+    CUDA_CHECK(cudaMemset(dev->sums, 0, sizeof(device_sums)))
+    return 0;
+}
+
+
+/* Copies the totals of the kernels launched since reset_sums to sums.
+Returns 0 on success, otherwise returns -1. */
+static int read_sums(scp_device *dev, device_sums *sums)
+{
+    CUDA_CHECK(cudaGetLastError())
+    CUDA_CHECK(cudaMemcpy(sums, dev->sums, sizeof(device_sums), cudaMemcpyDeviceToHost))
+    return 0;
+}
+
+
+/* Sets up the initial dual vector dual of inst on dev: init_dual (negative entries raised
+to 0, indexed by original rows if presolved) or min(cost/size), 0 for covered rows.
+Returns 0 on success and the sum of its entries in dual_sum, otherwise returns -1. */
+static int init_device_dual(scp_device *dev, const scp_instance *inst, const double *init_dual,
+                            scp_real *dual, double *dual_sum)
+{
+    int i;
+    device_sums sums;
+    const int num_row = inst->num_row;
+    const int *row_covered = inst->num_covered > 0 ? inst->row_covered : NULL;
+    const int *row_map = inst->row_map;
+    scp_real *host = dev->host;
+
+    if (init_dual == NULL) {
+        if (reset_sums(dev)) return -1;
+        init_dual_kernel<<<grid_size(num_row), BLOCK>>>(num_row, dev->costs, dev->col_wise_idx,
+            dev->row_wise_idx, dev->row_wise_a, row_covered ? dev->row_covered : NULL, dual,
+            dev->sums);
+        if (read_sums(dev, &sums)) return -1;
+        *dual_sum = sums.sum;
+        return 0;
+    }
+
+    *dual_sum = 0.0;
+    for (i = 0; i < num_row; i++) {
+        host[i] = init_dual[row_map ? row_map[i] : i];
+        host[i] = host[i] > 0 ? host[i] : 0.0;
+        if (row_covered != NULL && row_covered[i]) {
+            host[i] = 0.0;
+        }
+        *dual_sum += host[i];
+    }
+    CUDA_CHECK(cudaMemcpy(dual, host, num_row * sizeof(scp_real), cudaMemcpyHostToDevice))
+    return 0;
+}
+
+
+/* Computes reduced costs of dual on dev.
+Returns 0 on success and the sum of the negative ones in neg_sum, otherwise returns -1. */
+static int device_reduced_costs(scp_device *dev, const scp_instance *inst, const scp_real *dual,
+                                double *neg_sum)
+{
+    device_sums sums;
+    const int num_col = inst->num_col;
+
+    if (reset_sums(dev)) return -1;
+    reduced_costs_kernel<<<grid_size(num_col), BLOCK>>>(num_col, dev->costs, dev->col_wise_idx,
+        dev->col_wise_a, dual, dev->reduced_costs, dev->below, dev->sums);
+    if (read_sums(dev, &sums)) return -1;
+    *neg_sum = sums.sum;
+    return 0;
+}
+
+
+// launches the subgradient of the reduced costs on dev, dual for the BSM projection
+static void launch_subgradient(scp_device *dev, const scp_instance *inst, const scp_real *dual)
+{
+    const int num_row = inst->num_row;
+
+    subgradient_kernel<<<grid_size(num_row), BLOCK>>>(num_row, dev->row_wise_idx,
+        dev->row_wise_a, dev->below, inst->num_covered > 0 ? dev->row_covered : NULL, dual,
+        dev->subg, dev->sums);
+}
+
+
+/* Runs the Lagrangian heuristic on the reduced costs of dev, the only per-iteration
+transfer of a vector.
+Returns 0 on success and the cost of the cover in cover, otherwise returns -1. */
+static int device_heuristic(scp_device *dev, const scp_instance *inst, scp_result *res,
+                            double *cover)
+{
+    CUDA_CHECK(cudaMemcpy(dev->host, dev->reduced_costs, inst->num_col * sizeof(scp_real),
+                          cudaMemcpyDeviceToHost))
+    *cover = lagrangian_cover(inst, dev->host, &res->ws.heur);
+    if (*cover < res->upper_bound) res->upper_bound = *cover;
+    return 0;
+}
+
+
+/* Copies dual from dev to the best dual vector of res.
+Returns the bound stored in res, or -1 on system failure. */
+static double store_device_dual(scp_device *dev, const scp_instance *inst, scp_result *res,
+                                const scp_real *dual, double best_obj)
+{
+    CUDA_CHECK(cudaMemcpy(dev->host, dual, inst->num_row * sizeof(scp_real),
+                          cudaMemcpyDeviceToHost))
+    return store_best_dual(inst, res, dev->host, best_obj, 1);
+}
+
+
+/************** Spectral projected subgradient **************
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double cuda_spectral_projected_subgradient(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state, scp_ctrl *ctrl)
+{
+    double curr_obj, best_obj, worst_obj, sub_obj, neg_sum, *past_objs;
+    scp_real *curr_dual, *old_dual, *best_dual;
+    int worst_obj_idx, newest_obj_idx, moved;
+    double alpha, eta, eta_not, tau, accept, product, cover;
+    int itr, i, j, halvings, stop;
+    unsigned char is_opt;
+    double phase_mark = 0.0, subg_norm;
+    device_sums sums;
+    stop_state st;
+    scp_trace_info info;
+    scp_device *dev;
+
+    const int M = params->sps_memory > 0 ? params->sps_memory : 1;
+    const double mu = params->sps_momentum;
+    const double gamma = params->sps_gamma;
+
+    const int num_row = inst->num_row;
+    const int max_itr = params->max_itr;
+    const int max_halvings = params->term.max_halvings;
+    const int timers = params->phase_timers;
+    const int heur_interval = params->heur_interval;
+    const int grid = grid_size(num_row);
+    double *phase_time = res->phase_time;
+
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+    res->ws.rc_inst = NULL; // the reduced costs stay on the device
+
+    // buffers of the result handle, allocated by the first solve
+    if (reserve_device(&res->ws, inst, M)) return -1;
+    if (heur_interval > 0 && reserve_heuristic(&res->ws.heur, inst)) return -1;
+    dev = res->ws.dev;
+    if (upload_instance(dev, inst)) return -1;
+    past_objs = dev->past_objs;
+
+    // init data
+    old_dual = curr_dual = dev->dual1;
+    best_dual = dev->dual2;
+    if (init_device_dual(dev, inst, init_dual, curr_dual, &sub_obj)) return -1;
+    if (device_reduced_costs(dev, inst, curr_dual, &neg_sum)) return -1;
+    curr_obj = sub_obj + neg_sum + inst->fixed_cost;
+    // the start is the best dual until an iteration improves on it
+    CUDA_CHECK(cudaMemcpy(best_dual, curr_dual, num_row * sizeof(scp_real),
+                          cudaMemcpyDeviceToDevice))
+    best_obj = worst_obj = past_objs[(worst_obj_idx=newest_obj_idx=0)] = curr_obj;
+
+    alpha = params->sps_alpha; // init alpha
+
+    // continue momentum, step length and line search history of a previous solve
+    if (restore_sps_state(state, num_row, M, inst->num_covered > 0 ? inst->row_covered : NULL,
+                          dev->host, &alpha, past_objs)) {
+        CUDA_CHECK(cudaMemcpy(dev->momentum, dev->host, num_row * sizeof(scp_real),
+                              cudaMemcpyHostToDevice))
+        past_objs[0] = curr_obj;
+        for (j = 1; j < M; j++) {
+            if (past_objs[j] < worst_obj) {
+                worst_obj = past_objs[j];
+                worst_obj_idx = j;
+            }
+        }
+    } else {
+        CUDA_CHECK(cudaMemset(dev->momentum, 0, num_row * sizeof(scp_real)))
+    }
+
+    itr = 0;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    if (reset_sums(dev)) return -1;
+    launch_subgradient(dev, inst, curr_dual);
+    if (read_sums(dev, &sums)) return -1;
+    is_opt = sums.nonzero == 0;
+    if (is_opt || stop) goto cleanup;
+
+    // compute eta_not
+    eta_not = subg_norm = sqrt((double) sums.norm);
+
+    for (itr = 0; itr < max_itr; itr++) {
+        PHASE_MARK(timers, phase_mark);
+
+        // update dual vector and objective value
+        if (reset_sums(dev)) return -1;
+        sps_step_kernel<<<grid, BLOCK>>>(num_row, alpha, mu, dev->subg, old_dual, curr_dual,
+                                         dev->momentum, dev->dd, dev->dd_subg, dev->sums);
+        if (read_sums(dev, &sums)) return -1;
+        sub_obj = inst->fixed_cost + sums.sum;
+        product = sums.product;
+        moved = sums.moved;
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_DUAL]);
+
+        // compute current obj value
+        if (device_reduced_costs(dev, inst, curr_dual, &neg_sum)) return -1;
+        curr_obj = sub_obj + neg_sum;
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_OBJECTIVE]);
+
+        // non-monotone line search along the direction dd
+        product /= alpha;
+        tau = 1.0;
+        eta = eta_not / pow(itr, 1.1);
+        accept = worst_obj + gamma * tau * product - eta;
+        halvings = 0;
+        while (curr_obj < accept) {
+            if (max_halvings > 0 && halvings++ == max_halvings) {
+                stop = SCP_STOP_LINE_SEARCH;
+                break;
+            }
+            tau *= 0.5;
+            if (reset_sums(dev)) return -1;
+            step_back_kernel<<<grid, BLOCK>>>(num_row, tau, dev->dd, curr_dual, dev->sums);
+            if (read_sums(dev, &sums)) return -1;
+            sub_obj -= sums.sum;
+            if (device_reduced_costs(dev, inst, curr_dual, &neg_sum)) return -1;
+
+            // compute adjusted obj value
+            curr_obj = sub_obj + neg_sum;
+            accept -= gamma * tau * product;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_LINE_SEARCH]);
+
+        // update best solution
+        if (best_obj < curr_obj) {
+            best_obj = curr_obj;
+
+            // swap
+            old_dual = curr_dual;
+            curr_dual = best_dual;
+            best_dual = old_dual;
+        }  else {
+            old_dual = curr_dual;
+        }
+
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = alpha;
+            info.tau = tau;
+            info.dd_size = moved;
+            info.subg_norm = subg_norm;
+            params->trace(&info, params->trace_data);
+        }
+
+        // covers from the reduced costs of the current dual vector
+        if (heur_interval > 0 && itr % heur_interval == 0) {
+            PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+            if (device_heuristic(dev, inst, res, &cover)) return -1;
+            PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_HEURISTIC]);
+        }
+
+        if (!stop && best_obj > res->upper_bound - 1 + GAP_TOL) stop = SCP_STOP_GAP;
+        if (!stop) stop = check_termination(&params->term, &st, itr, best_obj);
+        if (stop) {
+            itr++;
+            break;
+        }
+        if (ctrl != NULL && scp_ctrl_update(ctrl, itr, max_itr, best_obj)) {
+            stop = SCP_STOP_RACE;
+            itr++;
+            break;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+
+        // compute subgradient vector and the dot products of alpha in one read
+        if (reset_sums(dev)) return -1;
+        launch_subgradient(dev, inst, old_dual);
+        step_length_kernel<<<grid, BLOCK>>>(num_row, dev->dd, dev->dd_subg, dev->subg,
+                                            dev->sums);
+        if (read_sums(dev, &sums)) return -1;
+        subg_norm = sqrt((double) sums.norm);
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_SUBGRADIENT]);
+        if (sums.nonzero == 0) {
+            is_opt = 1;
+            itr++; // count the finished iteration
+            break;
+        }
+
+        // update alpha
+        if (sums.dd_dg < ZERO_TOL) {
+            alpha = params->sps_alpha;
+        } else {
+            alpha = tau * sums.dd_dd / sums.dd_dg;
+        }
+
+        // update worst_lb
+        i = (itr+1) % M;
+        past_objs[i] = curr_obj;
+        newest_obj_idx = i;
+        if (i == worst_obj_idx) {
+            if (curr_obj <= worst_obj) {
+                worst_obj = curr_obj;
+            } else {
+                worst_obj = curr_obj;
+                for (j = M-1; j >= 0; j--) {
+                    if (past_objs[j] < worst_obj) {
+                        worst_obj = past_objs[j];
+                        worst_obj_idx = j;
+                    }
+                }
+            }
+        } else if (curr_obj < worst_obj) {
+            worst_obj = curr_obj;
+            worst_obj_idx = i;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+    }
+
+
+cleanup:
+    if (is_opt) {
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
+        best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
+    }
+    if (ctrl != NULL && (stop == SCP_STOP_OPTIMAL || stop == SCP_STOP_TARGET)) {
+        scp_ctrl_optimal(ctrl, best_obj); // the other solves of the race are done as well
+    }
+
+    best_obj = store_device_dual(dev, inst, res, best_dual, best_obj);
+    if (best_obj == -1) return -1;
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+    if (state != NULL) {
+        CUDA_CHECK(cudaMemcpy(dev->host, dev->momentum, num_row * sizeof(scp_real),
+                              cudaMemcpyDeviceToHost))
+        save_sps_state(state, num_row, M, dev->host, alpha, past_objs, newest_obj_idx);
+    }
+
+    return best_obj;
+}
+
+
+/* Beasley's subgradient method
+Returns best (maximum) dual solution
+Returns -1 on system failure */
+double cuda_basic_subgradient(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual, scp_ctrl *ctrl)
+{
+    double curr_obj, best_obj, neg_sum, cover;
+    scp_real *curr_dual, *old_dual, *best_dual;
+    int itr, counter, stop, moved = 0;
+    long long norm;
+    double lambda, step_size = 0.0;
+    double phase_mark = 0.0;
+    device_sums sums;
+    stop_state st;
+    scp_trace_info info;
+    scp_device *dev;
+
+    const int counter_limit = params->bsm_patience;
+
+    const int num_row = inst->num_row;
+    const int max_itr = params->max_itr;
+    const int timers = params->phase_timers;
+    const int grid = grid_size(num_row);
+    double *phase_time = res->phase_time;
+
+    // the step size needs an upperbound, the heuristic supplies one if none is given
+    double upperbound = params->upperbound > 0 ? params->upperbound : HUGE_VAL;
+    const int heur_interval = params->heur_interval > 0 ? params->heur_interval
+                              : params->upperbound > 0 ? 0 : SCP_HEUR_INTERVAL;
+
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+    res->ws.rc_inst = NULL; // the reduced costs stay on the device
+
+    // buffers of the result handle, allocated by the first solve
+    if (reserve_device(&res->ws, inst, 0)) return -1;
+    if (heur_interval > 0 && reserve_heuristic(&res->ws.heur, inst)) return -1;
+    dev = res->ws.dev;
+    if (upload_instance(dev, inst)) return -1;
+
+    // init data
+    old_dual = curr_dual = dev->dual1;
+    best_dual = dev->dual2;
+    if (init_device_dual(dev, inst, init_dual, curr_dual, &curr_obj)) return -1;
+    if (device_reduced_costs(dev, inst, curr_dual, &neg_sum)) return -1;
+    curr_obj += neg_sum + inst->fixed_cost;
+    CUDA_CHECK(cudaMemcpy(best_dual, curr_dual, num_row * sizeof(scp_real),
+                          cudaMemcpyDeviceToDevice))
+    best_obj = curr_obj;
+
+    norm = 0;
+    counter = 0;
+    lambda = params->bsm_lambda;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    for (itr = 0; itr < max_itr && !stop; itr++) {
+        PHASE_MARK(timers, phase_mark);
+
+        // covers from the reduced costs of the current dual vector
+        if (heur_interval > 0 && itr % heur_interval == 0) {
+            if (device_heuristic(dev, inst, res, &cover)) return -1;
+            upperbound = cover < upperbound ? cover : upperbound;
+            PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_HEURISTIC]);
+        }
+
+        // compute subgradient vector and step size
+        if (reset_sums(dev)) return -1;
+        launch_subgradient(dev, inst, old_dual);
+        if (read_sums(dev, &sums)) return -1;
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_SUBGRADIENT]);
+        if (sums.nonzero == 0) {
+            norm = -1;
+            break;
+        }
+        norm = sums.proj_norm > 0 ? (long long) sums.proj_norm : 1;
+
+        step_size = lambda * (1.05 * upperbound - curr_obj) / norm;
+
+        // update dual vector and objective value
+        if (reset_sums(dev)) return -1;
+        bsm_step_kernel<<<grid, BLOCK>>>(num_row, step_size, dev->subg, old_dual, curr_dual,
+                                         dev->sums);
+        if (read_sums(dev, &sums)) return -1;
+        curr_obj = inst->fixed_cost + sums.sum;
+        moved = sums.moved;
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_DUAL]);
+
+        // compute current obj value
+        if (device_reduced_costs(dev, inst, curr_dual, &neg_sum)) return -1;
+        curr_obj += neg_sum;
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_OBJECTIVE]);
+
+        // update best solution
+        if (best_obj < curr_obj) {
+            best_obj = curr_obj;
+            counter = 0;
+
+            // swap
+            old_dual = curr_dual;
+            curr_dual = best_dual;
+            best_dual = old_dual;
+        } else {
+            counter++;
+            old_dual = curr_dual;
+        }
+
+        if (counter > counter_limit) {
+            lambda *= 0.5;
+            counter = 0;
+        }
+
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = step_size;
+            info.tau = 1.0;
+            info.subg_norm = sqrt((double) norm);
+            info.dd_size = moved;
+            params->trace(&info, params->trace_data);
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+
+        if (best_obj > res->upper_bound - 1 + GAP_TOL) stop = SCP_STOP_GAP;
+        if (stop || (stop = check_termination(&params->term, &st, itr, best_obj)) != 0) {
+            itr++;
+            break;
+        }
+        if (ctrl != NULL && scp_ctrl_update(ctrl, itr, max_itr, best_obj)) {
+            stop = SCP_STOP_RACE;
+            itr++;
+            break;
+        }
+    }
+
+
+    if (norm < 0) {
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
+        best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
+    }
+    if (ctrl != NULL && (stop == SCP_STOP_OPTIMAL || stop == SCP_STOP_TARGET)) {
+        scp_ctrl_optimal(ctrl, best_obj); // the other solves of the race are done as well
+    }
+
+    best_obj = store_device_dual(dev, inst, res, best_dual, best_obj);
+    if (best_obj == -1) return -1;
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+
+    return best_obj;
+}
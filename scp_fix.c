@@ -0,0 +1,122 @@
+/***
+Column fixing on a loaded SCP instance, for branch-and-bound subproblems.
+
+The constraint matrix is never touched. Fixed columns get SCP_BLOCKED_COST in a working
+copy of the cost vector, so that the solver kernels skip them without extra branches,
+and rows covered by columns fixed to 1 are counted in row_covered. Every fixing is
+pushed on fix_stack, undoing pops it and restores the cost.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scp_internal.h"
+
+
+/* Allocates the fixing state of inst on first use.
+Returns 0 on success, otherwise returns -1. */
+static int init_fixing(scp_instance *inst)
+{
+    int *costs;
+
+    if (inst->col_fixed != NULL) return 0;
+
+    inst->col_fixed = (unsigned char *) calloc(inst->num_col > 0 ? inst->num_col : 1, 1);
+    inst->row_covered = (int *) calloc(inst->num_row > 0 ? inst->num_row : 1, sizeof(int));
+    inst->fix_stack = (int *) malloc((inst->num_col > 0 ? inst->num_col : 1) * sizeof(int));
+    costs = (int *) malloc((inst->num_col > 0 ? inst->num_col : 1) * sizeof(int));
+    if (inst->col_fixed == NULL || inst->row_covered == NULL || inst->fix_stack == NULL
+        || costs == NULL) {
+        perror("Error malloc");
+        free(inst->col_fixed);
+        free(inst->row_covered);
+        free(inst->fix_stack);
+        free(costs);
+        inst->col_fixed = NULL;
+        inst->row_covered = NULL;
+        inst->fix_stack = NULL;
+        return -1;
+    }
+
+    memcpy(costs, inst->costs, inst->num_col * sizeof(int));
+    inst->orig_costs = inst->costs;
+    inst->costs = costs;
+    inst->num_fixed = inst->num_covered = 0;
+    return 0;
+}
+
+
+/* Fixes column col of inst to 0 (value = SCP_FIX_0) or 1 (value = SCP_FIX_1).
+Returns 0 on success, otherwise returns -1 (bad column or value, or already fixed). */
+int fix_scp_column_r(scp_instance *inst, int col, int value)
+{
+    int j, row;
+
+    if (col < 0 || col >= get_num_col_r(inst) || (value != SCP_FIX_0 && value != SCP_FIX_1)) {
+        if (value == SCP_FIX_0 || value == SCP_FIX_1) {
+            fprintf(stderr, "Error: cannot fix column %d to %d\n", col, value == SCP_FIX_1);
+        } else {
+            fprintf(stderr, "Error: bad fixing value %d for column %d\n", value, col);
+        }
+        return -1;
+    }
+    if (inst->cols_reduced) {
+        fprintf(stderr, "Error: cannot fix columns after presolve removed columns\n");
+        return -1;
+    }
+    if (inst->col_index != NULL) {
+        // presolved or reordered instance, which keeps all columns, col is an original index
+        col = inst->col_index[col];
+    }
+    if (init_fixing(inst)) return -1;
+    if (inst->col_fixed[col]) {
+        fprintf(stderr, "Error: column %d is already fixed\n", col);
+        return -1;
+    }
+
+    inst->col_fixed[col] = value;
+    inst->costs[col] = SCP_BLOCKED_COST;
+    inst->fix_stack[inst->num_fixed++] = col;
+    inst->fix_version++;
+
+    if (value == SCP_FIX_1) {
+        inst->fixed_cost += inst->orig_costs[col];
+        for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+            row = COL_AT(inst, j);
+            if (inst->row_covered[row]++ == 0) {
+                inst->num_covered++;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Undoes the latest fixings of inst until num_fixed fixings remain.
+void undo_scp_fixes_r(scp_instance *inst, int num_fixed)
+{
+    int j, col, row;
+
+    if (num_fixed < 0) num_fixed = 0;
+    while (inst->num_fixed > num_fixed) {
+        col = inst->fix_stack[--inst->num_fixed];
+
+        if (inst->col_fixed[col] == SCP_FIX_1) {
+            inst->fixed_cost -= inst->orig_costs[col];
+            for (j = inst->col_wise_idx[col]; j < inst->col_wise_idx[col+1]; j++) {
+                row = COL_AT(inst, j);
+                if (--inst->row_covered[row] == 0) {
+                    inst->num_covered--;
+                }
+            }
+        }
+        inst->col_fixed[col] = 0;
+        inst->costs[col] = inst->orig_costs[col];
+        inst->fix_version++;
+    }
+}
+
+
+// Returns number of fixed columns of inst (the depth to pass to undo_scp_fixes_r).
+int get_num_fixed_r(const scp_instance *inst) { return inst->num_fixed; }
@@ -0,0 +1,349 @@
+/*** internal header, shared by the translation units of the subgradient library
+
+Definitions of the opaque handles declared in subgradient.h and the helper
+macros used across the implementation. Not part of the public API.
+
+***/
+
+#ifndef Scp_internal_h
+#define Scp_internal_h
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "subgradient.h"
+#include "scp_simd.h"
+
+
+#define FILE_FORMAT_ERR    fprintf(stderr, "Error: wrong SCP file format\n")
+
+#define MALLOC(var, type, size)     if ((var = (type) malloc(size)) == NULL) \
+                                        { perror("Error malloc"); return -1; }
+
+#define REALLOC(var, type, size)    { type p_; if ((p_ = (type) realloc(var, size)) == NULL) \
+                                        { perror("Error realloc"); return -1; } var = p_; }
+
+
+/* SCP instance: cost vector and constraint matrix in both orientations.
+Read-only once loaded, so any number of solves may share it. */
+struct scp_instance {
+    int num_col, num_row, num_nonzero;
+    int *costs;           // cost vector
+    int *col_wise_a;      // column-wise constraint matrix, NULL if col_wise_a16 replaces it
+    int *col_wise_idx;    // start index of each column in col_wise_a
+    int *row_wise_a;      // row-wise constraint matrix, NULL if row_wise_a16 replaces it
+    int *row_wise_idx;    // start index of each row in row_wise_a
+    int *col_sizes;       // NULL once compacted, sizes follow from the start indices
+    int *row_sizes;
+    uint16_t *col_wise_a16;   // compact col_wise_a if the rows fit in 16 bits
+    uint16_t *row_wise_a16;   // compact row_wise_a if the columns fit in 16 bits
+    void *mapped_base;    // mapping of .scpb file backing the arrays above, if any
+    size_t mapped_size;
+
+    // column fixing, allocated by the first fix_scp_column_r; costs then points to a
+    // working copy in which fixed columns cost SCP_BLOCKED_COST
+    int *orig_costs;
+    unsigned char *col_fixed; // 0 (free), SCP_FIX_0 or SCP_FIX_1
+    int *row_covered;         // number of columns fixed to 1 in each row
+    int *fix_stack;           // fixed columns, in fixing order
+    int num_fixed;
+    int num_covered;          // rows with row_covered > 0
+    int fix_version;          // changed by every fixing and undo
+    double fixed_cost;        // total cost of the columns fixed to 1 (or forced by presolve)
+
+    // presolved instance: maps to the instance it was reduced from
+    const scp_instance *parent;
+    int *row_map;             // parent row of each row
+    int *col_map;             // parent column of each column
+    int *row_index;           // row of each parent row, -1 if removed
+    int *col_index;           // column of each parent column, -1 if removed
+    unsigned char cols_reduced;   // presolve removed columns, so fixings are not valid
+};
+
+/* Index arrays of both widths: where the compact layout has a 16-bit array, the int one is
+freed (unless mapped from a .scpb file), so every reader picks the 16-bit array if there is
+one. INDEX_AT reads entry j, for the readers outside the iterations (heuristic, presolve,
+fixing, writer). INDEX_CALL calls the _u16 or _i32 variant of a kernel generated per width
+on list i, idx holding the start indices of the lists. ROW_* and COL_* take the arrays of
+an instance. */
+#define INDEX_AT(a16, a32, j)   ((a16) != NULL ? (int) (a16)[j] : (a32)[j])
+#define ROW_AT(inst, j)         INDEX_AT((inst)->row_wise_a16, (inst)->row_wise_a, j)
+#define COL_AT(inst, j)         INDEX_AT((inst)->col_wise_a16, (inst)->col_wise_a, j)
+
+#define INDEX_CALL(name, a16, a32, idx, i, ...)                                              \
+    ((a16) != NULL ? name##_u16((a16), (idx)[i], (idx)[(i)+1], __VA_ARGS__)                  \
+     : name##_i32((a32), (idx)[i], (idx)[(i)+1], __VA_ARGS__))
+#define ROW_CALL(name, inst, i, ...)                                                         \
+    INDEX_CALL(name, (inst)->row_wise_a16, (inst)->row_wise_a, (inst)->row_wise_idx, i,      \
+               __VA_ARGS__)
+#define COL_CALL(name, inst, i, ...)                                                         \
+    INDEX_CALL(name, (inst)->col_wise_a16, (inst)->col_wise_a, (inst)->col_wise_idx, i,      \
+               __VA_ARGS__)
+
+// cost of fixed columns in the working copy, keeps their reduced costs above any dual sum
+#define SCP_BLOCKED_COST    (1 << 29)
+
+#define GAP_TOL     1e-6    // slack of rounding the bound up to the next integer cost
+#define ZERO_TOL    1e-12
+#define SUBG_TOL    1e-14   // column is in the Lagrangian solution if its reduced cost is below
+
+/* Subtracts value from *x.
+Returns the change of *x as stored, which float working vectors round (steps below their
+resolution are lost), so that sums kept alongside follow the stored entries. */
+static inline double step_down(scp_real *x, double value)
+{
+#ifdef SCP_FLOAT
+    scp_real old = *x;
+    *x = old - value;
+    return (double) old - *x;
+#else
+    *x -= value;
+    return value;
+#endif
+}
+
+// alignment of the workspace buffers, a cache line and an AVX-512 vector
+#define SCP_WS_ALIGN        64
+
+/* Buffers and best cover of the Lagrangian heuristic. */
+typedef struct {
+    int num_row, num_col;   // sizes the buffers were allocated for (at least num_col)
+    int *row_count;         // columns of the cover in each row
+    int *cover;             // columns of the last cover
+    int cover_size;
+    long long *keys;        // (cost, column) pairs of the redundancy check
+} scp_heuristic;
+
+/* Makes sure h holds buffers for inst.
+Returns 0 on success, otherwise returns -1. */
+int reserve_heuristic(scp_heuristic *h, const scp_instance *inst);
+
+void free_heuristic(scp_heuristic *h);
+
+/* Builds a cover of inst from reduced_costs, its columns are left in h->cover.
+Returns cost of the cover including the fixed cost of inst, HUGE_VAL if a row is empty. */
+double lagrangian_cover(const scp_instance *inst, const scp_real *reduced_costs, scp_heuristic *h);
+
+/* Kink of the Lagrangian along a line search direction: the step length tau at which a
+column's reduced cost changes sign, and the change of the slope there. */
+typedef struct {
+    double tau;
+    double weight;
+} scp_breakpoint;
+
+/* Buffers of the breakpoint line search of SPS. */
+typedef struct {
+    int num_col;            // size the buffers were allocated for (at least num_col)
+    double *slope;          // per-column sum of dd over its rows, 0 outside of a search
+    unsigned char *seen;    // column is in cols
+    int *cols;              // columns touched by dd
+    scp_breakpoint *breaks;
+} scp_line_search;
+
+/* Buffers of the solvers, carved from one aligned block that is kept by the result
+handle and reused by every solve of the same size. */
+typedef struct {
+    void *block;          // NULL until the first solve
+    int num_row, num_col, memory;  // sizes the block was carved for (at least num_col)
+    scp_real *reduced_costs, *step, *dual1, *dual2, *momentum, *dd;
+    double *past_objs;
+    int *subg, *queue, *dd_idx, *dd_subg;
+    unsigned char *col_state;
+    double *partial;      // block sums of the deterministic mode
+
+    // reduced_costs as left by the last solve (of dual vector rc_dual) stay valid as long
+    // as rc_inst is not fixed or undone
+    const scp_instance *rc_inst;  // NULL if none
+    int rc_fix_version;
+    const scp_real *rc_dual;
+
+    scp_heuristic heur;   // allocated by the first solve that runs the heuristic
+    scp_line_search ls;   // allocated by the first solve with SCP_LS_BREAKPOINTS
+    struct scp_device *dev;   // buffers of the CUDA backend, NULL until its first solve
+} scp_workspace;
+
+/* Outcome of the last solve on a result handle. */
+struct scp_result {
+    int num_row;
+    int orig_num_row;     // rows of the original instance if presolved, otherwise num_row
+    const int *row_map;   // row map of the presolved instance, NULL if not presolved
+    double best_obj;
+    double working_obj;   // best_obj as tracked in the precision of the working vectors
+    int num_itr;          // iterations performed
+    int stop_reason;      // SCP_STOP_* of the last solve
+    double upper_bound;   // cost of the best cover of the heuristic, HUGE_VAL if none
+    double phase_time[SCP_NUM_PHASES]; // seconds per SCP_PHASE_*, if timed
+    long long phase_counters[SCP_NUM_PHASES][SCP_NUM_COUNTERS]; // -1 if not counted
+    double *best_dual;    // best (maximum) dual vector
+    scp_workspace ws;
+};
+
+/* SPS iteration state carried from one solve to the next (warm start). */
+struct scp_sps_state {
+    int num_row;
+    int memory;           // length of past_objs (sps_memory)
+    unsigned char valid;  // set once a solve saved its state
+    double alpha;         // next spectral step length
+    double *momentum;
+    double *past_objs;    // objective values of the line search, newest first
+};
+
+/* Restores momentum, alpha and past_objs (newest first) of SPS from state.
+Returns 1 if state was restored, 0 if it does not match the instance or params. */
+int restore_sps_state(const scp_sps_state *state, int num_row, int M, const int *row_covered,
+                      scp_real *momentum, double *alpha, double *past_objs);
+
+/* Saves momentum, alpha and past_objs (newest at index newest) of SPS to state. */
+void save_sps_state(scp_sps_state *state, int num_row, int M, const scp_real *momentum,
+                    double alpha, const double *past_objs, int newest);
+
+// first row of share part of num_parts of n rows, shares are contiguous and differ by <= 1 row
+#define SCP_PART_BEGIN(part, num_parts, n)  ((int) ((long long) (part) * (n) / (num_parts)))
+
+/* Reads the rows of share part of num_parts of SCP instance file (text format), with all
+costs and without col-wise matrix; col_sizes counts the entries of the kept rows only. The
+number of rows of the file is stored in file_rows.
+Returns new instance, or NULL on failure. */
+scp_instance *load_scp_instance_part_r(const char *filename, int part, int num_parts,
+                                       int *file_rows);
+
+/* Creates col-wise constraint matrix from row-wise matrix (of either width) and col_sizes,
+as 16-bit col_wise_a16 if narrow is set and the rows fit, otherwise as int col_wise_a.
+Returns 0 on success, otherwise returns -1. */
+int build_col_wise_matrix(scp_instance *inst, int narrow);
+
+/* State shared by the concurrent solves of a portfolio. */
+typedef struct {
+    double best_obj;      // best bound of all solves, accessed atomically
+    int optimal;          // set once a solve proved its dual vector optimal
+} scp_race;
+
+/* Per-solve handle on a portfolio race. */
+typedef struct {
+    scp_race *race;
+    int check_interval;   // iterations between progress checks
+    int mark_itr;         // iteration and own best bound of the last check
+    double mark_obj;
+} scp_ctrl;
+
+/* Publishes best_obj of a solve at iteration itr.
+Returns 1 if the solve should stop, otherwise returns 0. */
+int scp_ctrl_update(scp_ctrl *ctrl, int itr, int max_itr, double best_obj);
+
+// Publishes obj as proven optimal, which stops all solves of the race.
+void scp_ctrl_optimal(scp_ctrl *ctrl, double obj);
+
+/* Solvers behind the _ex and _warm entry points, init_dual, state and ctrl may be NULL.
+Return best (maximum) dual solution, or -1 on system failure. */
+double spectral_projected_subgradient_ctrl(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state, scp_ctrl *ctrl);
+double basic_subgradient_ctrl(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual, scp_ctrl *ctrl);
+
+/* Progress of a solve against the termination policy of its params. */
+typedef struct {
+    struct timespec begin;      // start of the solve
+    int mark_itr;               // iteration and best bound at the start of the stall window
+    double mark_obj;
+} stop_state;
+
+/* Checks term after iteration itr reached best bound best_obj.
+Returns SCP_STOP_* reason if the solve should stop, otherwise returns 0. */
+int check_termination(const scp_termination *term, stop_state *st, int itr, double best_obj);
+
+/* Stores best_dual and its bound best_obj, as tracked by the iterations, in res. With
+float working vectors, the bound is recomputed in double from the stored dual vector.
+Returns the bound stored in res. */
+double store_best_dual(const scp_instance *inst, scp_result *res, const scp_real *best_dual,
+                       double best_obj, int num_threads);
+
+// Clears the phase times and counters of res at the start of a solve.
+static inline void clear_phase_stats(scp_result *res)
+{
+    int p, k;
+
+    memset(res->phase_time, 0, SCP_NUM_PHASES * sizeof(double));
+    for (p = 0; p < SCP_NUM_PHASES; p++) {
+        for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+            res->phase_counters[p][k] = -1;
+        }
+    }
+}
+
+/*** hardware counters of the phases (scp_perf.c) ***/
+
+typedef struct scp_perf scp_perf;
+
+/* Opens the counters of the calling thread, with counters (per phase) as the totals. The
+totals of the events that opened are set to 0, the others to -1.
+Returns new handle, or NULL if no counter could be opened. */
+scp_perf *open_scp_perf(long long (*counters)[SCP_NUM_COUNTERS]);
+
+// Starts the interval of the next scp_perf_add.
+void scp_perf_mark(scp_perf *perf);
+
+// Adds the counts since the last mark or add to phase, and starts the next interval.
+void scp_perf_add(scp_perf *perf, int phase);
+
+void close_scp_perf(scp_perf *perf);
+
+// Returns the number of threads to use for requested num_threads (0 = all available).
+int resolve_num_threads(int num_threads);
+
+/*** batched kernels (multi.c)
+
+K dual vectors of one instance are stored interleaved, entry k of row i at
+[i * stride + k], and likewise their reduced costs by column and their subgradients by
+row, so that one pass over an index array serves all of them. The entries of lanes
+stride - K .. stride - 1 are padding, they are updated like the others. Each kernel
+splits its pass over num_threads OpenMP threads.
+***/
+
+// Returns the stride of num_lanes interleaved vectors, num_lanes rounded up to the width
+int multi_stride(int num_lanes);
+
+/* Computes the reduced costs of the interleaved dual vectors in one pass over col_wise_a,
+with below set where a reduced cost is below SUBG_TOL (the column is in the Lagrangian
+solution of its lane) and the sum of the negative reduced costs of each lane in neg_sum
+(stride entries). */
+void multi_reduced_costs(const scp_instance *inst, int stride, const scp_real *dual,
+                         scp_real *reduced_costs, unsigned char *below, double *neg_sum,
+                         int num_threads);
+
+/* Computes the subgradient vectors of the interleaved Lagrangian solutions below in one
+pass over row_wise_a (0 in rows covered by fixed columns), with the number of nonzero
+entries and the square norm of the subgradient projected at dual of each lane (stride
+entries). */
+void multi_subgradients(const scp_instance *inst, int stride, const unsigned char *below,
+                        const scp_real *dual, int *subg, int *nonzero, long long *norm,
+                        int num_threads);
+
+/* Moves each lane k of the interleaved dual vectors by step_size[k] along its projected
+subgradient, clipped at 0, and sums the new entries of each lane in dual_sum. */
+void multi_dual_steps(int num_row, int stride, scp_real *dual, const int *subg,
+                      const double *step_size, double *dual_sum, int num_threads);
+
+/*** CUDA backend (scp_cuda.cu, built with make CUDA=1) ***/
+
+typedef struct scp_device scp_device;
+
+/* The _ctrl solvers on the device, for params->backend = SCP_BACKEND_CUDA. Matrix and
+working vectors stay in device memory, each iteration copies back only the scalars of its
+reductions; the reduced costs cross only for the heuristic. The breakpoint line search is
+run as halving, num_threads is ignored.
+Return best (maximum) dual solution, or -1 on system failure. */
+double cuda_spectral_projected_subgradient(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state, scp_ctrl *ctrl);
+double cuda_basic_subgradient(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual, scp_ctrl *ctrl);
+
+void free_scp_device(scp_device *dev);
+
+// Returns number of CUDA devices, 0 if none or the driver is missing.
+int cuda_device_count(void);
+
+#endif /* Scp_internal_h */
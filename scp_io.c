@@ -0,0 +1,751 @@
+/***
+Reading and writing set-covering problem (SCP) instances
+
+1) OR-library text format, read through stdio or through mmap
+2) binary pre-built format (.scpb), mapped in place
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scp_internal.h"
+
+
+#define GETLINE(buf, buf_size, fp)  if (getline(&buf, &buf_size, fp) == -1) \
+                                        { FILE_FORMAT_ERR; return -1; }
+
+#define STR_TOKEN(token, s, delim)  if ((token = strtok_r(s, delim, &save_ptr)) == NULL) \
+                                        { FILE_FORMAT_ERR; return -1; }
+
+#define SCAN_INT(pos, end, value)   if (scan_int(&pos, end, &value)) \
+                                        { FILE_FORMAT_ERR; return -1; }
+
+/* binary instance file (.scpb): fixed-size header followed by the arrays,
+each section starting at a multiple of SCPB_ALIGN bytes. */
+#define SCPB_MAGIC      "SCPB"
+#define SCPB_VERSION    1
+#define SCPB_ENDIAN     0x01020304u
+#define SCPB_ALIGN      64
+// sections: costs, col_sizes, row_sizes, col_wise_idx, col_wise_a, row_wise_idx, row_wise_a
+#define SCPB_SECTIONS   7
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;        // SCPB_ENDIAN in the writer's byte order
+    uint32_t align;
+    int32_t num_row;
+    int32_t num_col;
+    int32_t num_nonzero;
+    int32_t reserved;
+    uint64_t file_size;
+    uint64_t offsets[SCPB_SECTIONS];    // byte offset of each section
+    uint64_t padding[4];                // header is 128 bytes
+} scpb_header;
+
+
+/* Reads SCP instance from text stream into inst, keeping only the rows of share part of
+num_parts (see SCP_PART_BEGIN), the number of rows of the file is stored in file_rows.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_text(scp_instance *inst, FILE *fp, char **buf, size_t *buf_size, int part,
+                         int num_parts, int *file_rows);
+
+/* Reads SCP instance from text held in memory [data, end) into inst, with the row-wise
+matrix in 16 bits if narrow is set and the columns fit.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_text_mapped(scp_instance *inst, const char *data, const char *end,
+                                int narrow);
+
+/* Reads SCP instance file through mmap, into the compact layout if narrow is set.
+Returns new instance, or NULL on failure. */
+static scp_instance *load_scp_instance_text_mapped(const char *filename, int narrow);
+
+/* Points inst arrays into mapped binary instance file.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_bin(scp_instance *inst, char *data, size_t size);
+
+/* Scans the next non-negative decimal integer in [*pos, end) and advances *pos.
+Returns 0 on success, -1 on end of input or on a malformed token. */
+static inline int scan_int(const char **pos, const char *end, int *value);
+
+/* Writes inst with the given size and index arrays to binary file (.scpb).
+Returns 0 on success, otherwise returns -1. */
+static int write_scp_instance_bin_sized(const scp_instance *inst, const int *col_sizes,
+                                        const int *row_sizes, const int *col_wise_a,
+                                        const int *row_wise_a, const char *filename);
+
+
+
+/* Reads SCP instance file and creates cost vector and constraint matrix.
+Returns new instance, or NULL on failure. */
+scp_instance *load_scp_instance_r(const char *filename)
+{
+    scp_instance *inst;
+    FILE *fp;
+    char *buf = NULL;
+    size_t buf_size = 0;
+    int file_rows, ret;
+
+    if ((inst = (scp_instance *) calloc(1, sizeof(scp_instance))) == NULL) {
+        perror("Error malloc"); return NULL;
+    }
+    if ((fp = fopen(filename, "r")) == NULL) {
+        perror("Error opening file"); free(inst); return NULL;
+    }
+
+    ret = read_scp_text(inst, fp, &buf, &buf_size, 0, 1, &file_rows);
+
+    free(buf);
+    fclose(fp);
+
+    if (ret || build_col_wise_matrix(inst, 0)) {
+        free_scp_instance_r(inst);
+        return NULL;
+    }
+    return inst;
+}
+
+
+/* Reads the rows of share part of num_parts of SCP instance file, with all costs.
+Returns new instance without col-wise matrix, or NULL on failure. */
+scp_instance *load_scp_instance_part_r(const char *filename, int part, int num_parts,
+                                       int *file_rows)
+{
+    scp_instance *inst;
+    FILE *fp;
+    char *buf = NULL;
+    size_t buf_size = 0;
+    int ret;
+
+    if ((inst = (scp_instance *) calloc(1, sizeof(scp_instance))) == NULL) {
+        perror("Error malloc"); return NULL;
+    }
+    if ((fp = fopen(filename, "r")) == NULL) {
+        perror("Error opening file"); free(inst); return NULL;
+    }
+
+    ret = read_scp_text(inst, fp, &buf, &buf_size, part, num_parts, file_rows);
+
+    free(buf);
+    fclose(fp);
+
+    if (ret) {
+        free_scp_instance_r(inst);
+        return NULL;
+    }
+    return inst;
+}
+
+
+/* Reads SCP instance from text stream into inst, keeping only the rows of share part of
+num_parts. Rows of the other shares are scanned and dropped, col_sizes counts the kept ones.
+Line buffer *buf is (re)allocated by getline and freed by the caller.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_text(scp_instance *inst, FILE *fp, char **buf, size_t *buf_size, int part,
+                         int num_parts, int *file_rows)
+{
+    int i, j, k, r, num_row, num_col, col_idx, capacity, size, first_row, end_row;
+    int *costs, *row_sizes, *col_sizes;
+    char *token, *save_ptr;
+
+    // read first line: the number of row and the number of col
+    GETLINE(*buf, *buf_size, fp)
+    STR_TOKEN(token, *buf, " ")
+    *file_rows = num_row = atoi(token);
+    STR_TOKEN(token, NULL, " ")
+    inst->num_col = num_col = atoi(token);
+    if (num_row < 0 || num_col < 0) {
+        FILE_FORMAT_ERR; return -1;
+    }
+    first_row = SCP_PART_BEGIN(part, num_parts, num_row);
+    end_row = SCP_PART_BEGIN(part + 1, num_parts, num_row);
+    inst->num_row = end_row - first_row;
+
+    MALLOC(inst->costs, int *, num_col * sizeof(int))
+    costs = inst->costs;
+
+    // read cost vector
+    for (i = 0, token = NULL; i < num_col; token = strtok_r(NULL, " ", &save_ptr)) {
+        if (token == NULL) {
+            GETLINE(*buf, *buf_size, fp)
+            STR_TOKEN(token, *buf, " ")
+        }
+
+        if (*token != '\n') {
+            costs[i++] = atoi(token);
+        }
+    }
+
+    MALLOC(inst->col_sizes, int *, num_col * sizeof(int))
+    col_sizes = inst->col_sizes;
+    memset(col_sizes, 0, num_col * sizeof(int));
+    MALLOC(inst->row_sizes, int *, (inst->num_row > 0 ? inst->num_row : 1) * sizeof(int))
+    row_sizes = inst->row_sizes;
+    MALLOC(inst->row_wise_idx, int *, (inst->num_row+1) * sizeof(int))
+
+    // read rows (constraints) straight into the row-wise matrix.
+    // the number of nonzeros is not known in advance, so row_wise_a grows
+    // geometrically and is trimmed to its final size afterwards.
+    capacity = num_row > num_col ? num_row : num_col;
+    if (capacity < 1) capacity = 1;
+    MALLOC(inst->row_wise_a, int *, capacity * sizeof(int))
+    k = 0;
+
+    for (r = 0; r < end_row; r++) {
+        i = r - first_row; // kept row, if >= 0
+        GETLINE(*buf, *buf_size, fp)
+        STR_TOKEN(token, *buf, " ")
+        size = atoi(token);
+
+        if (size < 0 || size > num_col) {
+            FILE_FORMAT_ERR; return -1;
+        }
+        if (i >= 0) {
+            row_sizes[i] = size;
+            inst->row_wise_idx[i] = k; // start index of i-th row
+        }
+        if (i >= 0 && k + size > capacity) {
+            while (k + size > capacity) {
+                capacity *= 2;
+            }
+            REALLOC(inst->row_wise_a, int *, capacity * sizeof(int))
+        }
+
+        for (j = 0, token = NULL; j < size; token = strtok_r(NULL, " ", &save_ptr)) {
+            if (token == NULL) {
+                GETLINE(*buf, *buf_size, fp)
+                STR_TOKEN(token, *buf, " ")
+            }
+
+            if (*token != '\n') {
+                if ((col_idx = atoi(token) - 1) < 0 || col_idx >= num_col) {
+                    FILE_FORMAT_ERR; return -1;
+                }
+                if (i >= 0) {
+                    col_sizes[col_idx]++;
+                    inst->row_wise_a[k++] = col_idx;
+                }
+                j++;
+            }
+        }
+    }
+    inst->row_wise_idx[inst->num_row] = k;
+    inst->num_nonzero = k;
+    if (k > 0) {
+        REALLOC(inst->row_wise_a, int *, k * sizeof(int))
+    }
+
+    return 0;
+}
+
+
+/* Reads SCP instance file through mmap and creates cost vector and constraint matrix.
+Accepts the same format as load_scp_instance_r, without per-line allocation.
+Returns new instance, or NULL on failure. */
+scp_instance *load_scp_instance_mmap_r(const char *filename)
+{
+    return load_scp_instance_text_mapped(filename, 0);
+}
+
+
+/* Reads SCP instance file like load_scp_instance_mmap_r, straight into the layout of
+compact_scp_instance_r: the index lists that fit in 16 bits are never stored as int.
+Returns new instance, or NULL on failure. */
+scp_instance *load_scp_instance_compact_r(const char *filename)
+{
+    return load_scp_instance_text_mapped(filename, 1);
+}
+
+
+/* Reads SCP instance file through mmap, into the compact layout if narrow is set.
+Returns new instance, or NULL on failure. */
+static scp_instance *load_scp_instance_text_mapped(const char *filename, int narrow)
+{
+    scp_instance *inst;
+    int fd, ret;
+    struct stat st;
+    const char *data;
+
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        perror("Error opening file"); return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        perror("Error fstat"); close(fd); return NULL;
+    }
+    if (st.st_size == 0) {
+        FILE_FORMAT_ERR; close(fd); return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mmap"); return NULL;
+    }
+    madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+
+    if ((inst = (scp_instance *) calloc(1, sizeof(scp_instance))) == NULL) {
+        perror("Error malloc"); munmap((void *) data, st.st_size); return NULL;
+    }
+
+    ret = read_scp_text_mapped(inst, data, data + st.st_size, narrow);
+
+    munmap((void *) data, st.st_size);
+
+    if (ret || build_col_wise_matrix(inst, narrow) || (narrow && compact_scp_instance_r(inst))) {
+        free_scp_instance_r(inst);
+        return NULL;
+    }
+    return inst;
+}
+
+
+/* Reads SCP instance from text held in memory [data, end) into inst, with the row-wise
+matrix in 16 bits if narrow is set and the columns fit.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_text_mapped(scp_instance *inst, const char *data, const char *end,
+                                int narrow)
+{
+    int i, j, k, num_row, num_col, col_idx, capacity;
+    int *costs, *row_sizes, *col_sizes;
+    const char *pos = data;
+
+    // the number of row and the number of col
+    SCAN_INT(pos, end, num_row)
+    SCAN_INT(pos, end, num_col)
+    inst->num_row = num_row;
+    inst->num_col = num_col;
+
+    MALLOC(inst->costs, int *, num_col * sizeof(int))
+    costs = inst->costs;
+    MALLOC(inst->col_sizes, int *, num_col * sizeof(int))
+    col_sizes = inst->col_sizes;
+    memset(col_sizes, 0, num_col * sizeof(int));
+    MALLOC(inst->row_sizes, int *, num_row * sizeof(int))
+    row_sizes = inst->row_sizes;
+    MALLOC(inst->row_wise_idx, int *, (num_row+1) * sizeof(int))
+
+    // cost vector, possibly wrapped over several lines
+    for (i = 0; i < num_col; i++) {
+        SCAN_INT(pos, end, costs[i])
+    }
+
+    // row lists, read straight into the row-wise matrix
+    narrow = narrow && num_col <= 65536;
+    capacity = num_row > num_col ? num_row : num_col;
+    if (capacity < 1) capacity = 1;
+    if (narrow) {
+        MALLOC(inst->row_wise_a16, uint16_t *, capacity * sizeof(uint16_t))
+    } else {
+        MALLOC(inst->row_wise_a, int *, capacity * sizeof(int))
+    }
+    k = 0;
+    for (i = 0; i < num_row; i++) {
+        inst->row_wise_idx[i] = k; // start index of i-th row
+        SCAN_INT(pos, end, row_sizes[i])
+        if (row_sizes[i] > num_col) {
+            FILE_FORMAT_ERR; return -1;
+        }
+        if (k + row_sizes[i] > capacity) {
+            while (k + row_sizes[i] > capacity) {
+                capacity *= 2;
+            }
+            if (narrow) {
+                REALLOC(inst->row_wise_a16, uint16_t *, capacity * sizeof(uint16_t))
+            } else {
+                REALLOC(inst->row_wise_a, int *, capacity * sizeof(int))
+            }
+        }
+        for (j = 0; j < row_sizes[i]; j++) {
+            SCAN_INT(pos, end, col_idx)
+            if (--col_idx < 0 || col_idx >= num_col) {
+                FILE_FORMAT_ERR; return -1;
+            }
+            col_sizes[col_idx]++;
+            if (narrow) {
+                inst->row_wise_a16[k++] = (uint16_t) col_idx;
+            } else {
+                inst->row_wise_a[k++] = col_idx;
+            }
+        }
+    }
+    inst->row_wise_idx[num_row] = k;
+    inst->num_nonzero = k;
+    if (k > 0 && narrow) {
+        REALLOC(inst->row_wise_a16, uint16_t *, k * sizeof(uint16_t))
+    } else if (k > 0) {
+        REALLOC(inst->row_wise_a, int *, k * sizeof(int))
+    }
+
+    return 0;
+}
+
+
+/* Scans the next non-negative decimal integer in [*pos, end) and advances *pos.
+Returns 0 on success, -1 on end of input or on a malformed token. */
+static inline int scan_int(const char **pos, const char *end, int *value)
+{
+    const char *p = *pos;
+    unsigned int digit;
+    long long v;
+
+    // skip white spaces (including line breaks)
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    if (p == end || (digit = (unsigned char) *p - '0') > 9) {
+        return -1;
+    }
+
+    v = 0;
+    do {
+        v = v * 10 + digit;
+        if (v > INT_MAX) return -1;
+        p++;
+    } while (p < end && (digit = (unsigned char) *p - '0') <= 9);
+
+    *pos = p;
+    *value = (int) v;
+    return 0;
+}
+
+
+/* Writes SCP instance to binary file (.scpb) that can be mapped by load_scp_instance_bin_r.
+Returns 0 on success, otherwise returns -1. */
+int write_scp_instance_bin_r(const scp_instance *inst, const char *filename)
+{
+    int i, ret = -1;
+    const size_t n = inst->num_nonzero > 0 ? inst->num_nonzero : 1;
+    int *col_sizes = NULL, *row_sizes = NULL, *col_wise_a = NULL, *row_wise_a = NULL;
+
+    // compact instances dropped the size arrays and the int index arrays that have a 16-bit
+    // one, the file format keeps them
+    if (inst->col_sizes == NULL) {
+        col_sizes = (int *) malloc((inst->num_col > 0 ? inst->num_col : 1) * sizeof(int));
+        row_sizes = (int *) malloc((inst->num_row > 0 ? inst->num_row : 1) * sizeof(int));
+    }
+    if (inst->col_wise_a == NULL) col_wise_a = (int *) malloc(n * sizeof(int));
+    if (inst->row_wise_a == NULL) row_wise_a = (int *) malloc(n * sizeof(int));
+
+    if ((inst->col_sizes == NULL && (col_sizes == NULL || row_sizes == NULL))
+        || (inst->col_wise_a == NULL && col_wise_a == NULL)
+        || (inst->row_wise_a == NULL && row_wise_a == NULL)) {
+        perror("Error malloc");
+    } else {
+        for (i = 0; col_sizes != NULL && i < inst->num_col; i++) {
+            col_sizes[i] = inst->col_wise_idx[i+1] - inst->col_wise_idx[i];
+        }
+        for (i = 0; row_sizes != NULL && i < inst->num_row; i++) {
+            row_sizes[i] = inst->row_wise_idx[i+1] - inst->row_wise_idx[i];
+        }
+        for (i = 0; col_wise_a != NULL && i < inst->num_nonzero; i++) {
+            col_wise_a[i] = COL_AT(inst, i);
+        }
+        for (i = 0; row_wise_a != NULL && i < inst->num_nonzero; i++) {
+            row_wise_a[i] = ROW_AT(inst, i);
+        }
+        ret = write_scp_instance_bin_sized(inst, col_sizes ? col_sizes : inst->col_sizes,
+                                           row_sizes ? row_sizes : inst->row_sizes,
+                                           col_wise_a ? col_wise_a : inst->col_wise_a,
+                                           row_wise_a ? row_wise_a : inst->row_wise_a, filename);
+    }
+    free(col_sizes);
+    free(row_sizes);
+    free(col_wise_a);
+    free(row_wise_a);
+    return ret;
+}
+
+
+/* Compacts inst: drops col_sizes and row_sizes, and replaces the index arrays whose range
+fits by 16-bit arrays. The int arrays of a mapped .scpb file stay mapped, the readers go to
+the 16-bit ones all the same.
+Returns 0 on success, otherwise returns -1. */
+int compact_scp_instance_r(scp_instance *inst)
+{
+    int i;
+
+    if (inst->num_row <= 65536 && inst->col_wise_a16 == NULL) {
+        MALLOC(inst->col_wise_a16, uint16_t *, (inst->num_nonzero > 0 ? inst->num_nonzero : 1)
+                                               * sizeof(uint16_t))
+        for (i = 0; i < inst->num_nonzero; i++) {
+            inst->col_wise_a16[i] = (uint16_t) inst->col_wise_a[i];
+        }
+        if (!inst->mapped_base) {
+            free(inst->col_wise_a);
+            inst->col_wise_a = NULL;
+        }
+    }
+    if (inst->num_col <= 65536 && inst->row_wise_a16 == NULL) {
+        MALLOC(inst->row_wise_a16, uint16_t *, (inst->num_nonzero > 0 ? inst->num_nonzero : 1)
+                                               * sizeof(uint16_t))
+        for (i = 0; i < inst->num_nonzero; i++) {
+            inst->row_wise_a16[i] = (uint16_t) inst->row_wise_a[i];
+        }
+        if (!inst->mapped_base) {
+            free(inst->row_wise_a);
+            inst->row_wise_a = NULL;
+        }
+    }
+
+    if (!inst->mapped_base) {
+        free(inst->col_sizes);
+        free(inst->row_sizes);
+    }
+    inst->col_sizes = inst->row_sizes = NULL;
+    return 0;
+}
+
+
+/* Writes inst with the given size and index arrays to binary file (.scpb).
+Returns 0 on success, otherwise returns -1. */
+static int write_scp_instance_bin_sized(const scp_instance *inst, const int *col_sizes,
+                                        const int *row_sizes, const int *col_wise_a,
+                                        const int *row_wise_a, const char *filename)
+{
+    int i;
+    FILE *fp;
+    scpb_header header;
+    uint64_t offset;
+    static const char zeros[SCPB_ALIGN];
+
+    const void *sections[SCPB_SECTIONS] = {
+        inst->orig_costs ? inst->orig_costs : inst->costs, col_sizes, row_sizes,
+        inst->col_wise_idx, col_wise_a, inst->row_wise_idx, row_wise_a
+    };
+    const size_t lengths[SCPB_SECTIONS] = {
+        inst->num_col, inst->num_col, inst->num_row,
+        inst->num_col+1, inst->num_nonzero, inst->num_row+1, inst->num_nonzero
+    };
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCPB_MAGIC, 4);
+    header.version = SCPB_VERSION;
+    header.endian = SCPB_ENDIAN;
+    header.align = SCPB_ALIGN;
+    header.num_row = inst->num_row;
+    header.num_col = inst->num_col;
+    header.num_nonzero = inst->num_nonzero;
+
+    offset = sizeof(header);
+    for (i = 0; i < SCPB_SECTIONS; i++) {
+        header.offsets[i] = offset;
+        offset += lengths[i] * sizeof(int);
+        offset = (offset + SCPB_ALIGN - 1) / SCPB_ALIGN * SCPB_ALIGN;
+    }
+    header.file_size = offset;
+
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        perror("Error opening file"); return -1;
+    }
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) goto write_err;
+    offset = sizeof(header);
+    for (i = 0; i < SCPB_SECTIONS; i++) {
+        if (fwrite(zeros, 1, header.offsets[i] - offset, fp) != header.offsets[i] - offset)
+            goto write_err;
+        if (fwrite(sections[i], sizeof(int), lengths[i], fp) != lengths[i]) goto write_err;
+        offset = header.offsets[i] + lengths[i] * sizeof(int);
+    }
+    if (fwrite(zeros, 1, header.file_size - offset, fp) != header.file_size - offset)
+        goto write_err;
+
+    if (fclose(fp)) {
+        perror("Error writing file"); return -1;
+    }
+    return 0;
+
+write_err:
+    perror("Error writing file");
+    fclose(fp);
+    return -1;
+}
+
+
+/* Maps binary SCP instance file (.scpb) written by write_scp_instance_bin_r.
+Constraint matrix is not copied: the arrays point into the read-only shared mapping.
+Returns new instance, or NULL on failure. */
+scp_instance *load_scp_instance_bin_r(const char *filename)
+{
+    scp_instance *inst;
+    int fd;
+    struct stat st;
+    char *data;
+
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        perror("Error opening file"); return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        perror("Error fstat"); close(fd); return NULL;
+    }
+    if ((size_t) st.st_size < sizeof(scpb_header)) {
+        FILE_FORMAT_ERR; close(fd); return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mmap"); return NULL;
+    }
+
+    if ((inst = (scp_instance *) calloc(1, sizeof(scp_instance))) == NULL) {
+        perror("Error malloc"); munmap(data, st.st_size); return NULL;
+    }
+    if (read_scp_bin(inst, data, st.st_size)) {
+        munmap(data, st.st_size);
+        free(inst);
+        return NULL;
+    }
+    inst->mapped_base = data;
+    inst->mapped_size = st.st_size;
+
+    return inst;
+}
+
+
+/* Points inst arrays into mapped binary instance file.
+Returns 0 on success, otherwise returns -1. */
+static int read_scp_bin(scp_instance *inst, char *data, size_t size)
+{
+    int i;
+    const scpb_header *header;
+    size_t lengths[SCPB_SECTIONS];
+    int **sections[SCPB_SECTIONS] = {
+        &inst->costs, &inst->col_sizes, &inst->row_sizes,
+        &inst->col_wise_idx, &inst->col_wise_a, &inst->row_wise_idx, &inst->row_wise_a
+    };
+
+    // validate header, the arrays themselves are trusted (written by write_scp_instance_bin_r)
+    header = (const scpb_header *) data;
+    if (memcmp(header->magic, SCPB_MAGIC, 4) || header->endian != SCPB_ENDIAN
+        || header->version != SCPB_VERSION || header->align != SCPB_ALIGN
+        || header->file_size != (uint64_t) size
+        || header->num_row < 0 || header->num_col < 0 || header->num_nonzero < 0) {
+        FILE_FORMAT_ERR; return -1;
+    }
+    inst->num_row = header->num_row;
+    inst->num_col = header->num_col;
+    inst->num_nonzero = header->num_nonzero;
+
+    lengths[0] = lengths[1] = inst->num_col;
+    lengths[2] = inst->num_row;
+    lengths[3] = inst->num_col + 1;
+    lengths[4] = lengths[6] = inst->num_nonzero;
+    lengths[5] = inst->num_row + 1;
+    for (i = 0; i < SCPB_SECTIONS; i++) {
+        if (header->offsets[i] % SCPB_ALIGN
+            || header->offsets[i] + lengths[i] * sizeof(int) > header->file_size) {
+            FILE_FORMAT_ERR; return -1;
+        }
+        *sections[i] = (int *) (data + header->offsets[i]);
+    }
+    if (inst->col_wise_idx[inst->num_col] != inst->num_nonzero
+        || inst->row_wise_idx[inst->num_row] != inst->num_nonzero) {
+        FILE_FORMAT_ERR; return -1;
+    }
+
+    return 0;
+}
+
+
+/* Creates col-wise constraint matrix from row-wise matrix (of either width) and col_sizes,
+as 16-bit col_wise_a16 if narrow is set and the rows fit, otherwise as int col_wise_a.
+Counting pass is done by the reader (col_sizes), this is the fill pass.
+Returns 0 on success, otherwise returns -1. */
+int build_col_wise_matrix(scp_instance *inst, int narrow)
+{
+    int i, j, k, col_idx;
+    int *col_wise_a = NULL, *col_wise_idx;
+    uint16_t *col_wise_a16 = NULL;
+    const int num_col = inst->num_col;
+    const int num_row = inst->num_row;
+    const int *row_wise_idx = inst->row_wise_idx;
+    const size_t n = inst->num_nonzero > 0 ? inst->num_nonzero : 1;
+
+    if (narrow && num_row <= 65536) {
+        MALLOC(inst->col_wise_a16, uint16_t *, n * sizeof(uint16_t))
+        col_wise_a16 = inst->col_wise_a16;
+    } else {
+        MALLOC(inst->col_wise_a, int *, n * sizeof(int))
+        col_wise_a = inst->col_wise_a;
+    }
+    MALLOC(inst->col_wise_idx, int *, (num_col+1) * sizeof(int))
+    col_wise_idx = inst->col_wise_idx;
+
+    // col_wise_idx[i+1] = start index of i-th column. it is used as insertion
+    // point of i-th column in the fill pass, so that it ends up as the start
+    // index of (i+1)-th column. rows are visited in order, hence each column
+    // stays sorted by row.
+    col_wise_idx[0] = 0;
+    k = 0;
+    for (i = 0; i < num_col; i++) {
+        col_wise_idx[i+1] = k;
+        k += inst->col_sizes[i];
+    }
+    for (i = 0; i < num_row; i++) {
+        for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+            col_idx = ROW_AT(inst, j);
+            if (col_wise_a16 != NULL) {
+                col_wise_a16[col_wise_idx[col_idx+1]++] = (uint16_t) i;
+            } else {
+                col_wise_a[col_wise_idx[col_idx+1]++] = i;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+// presolved instances report the dimensions of the original instance
+int get_num_col_r(const scp_instance *inst)
+{
+    return inst->parent ? get_num_col_r(inst->parent) : inst->num_col;
+}
+
+int get_num_row_r(const scp_instance *inst)
+{
+    return inst->parent ? get_num_row_r(inst->parent) : inst->num_row;
+}
+
+// nonzeros the iterations work on, so a presolved instance counts its own
+int get_num_nonzero_r(const scp_instance *inst)
+{
+    return inst->num_nonzero;
+}
+
+
+void free_scp_instance_r(scp_instance *inst)
+{
+    if (inst == NULL) return;
+
+    if (inst->orig_costs) {
+        free(inst->costs); // working copy of column fixing
+        inst->costs = inst->orig_costs;
+    }
+    free(inst->col_fixed);
+    free(inst->row_covered);
+    free(inst->fix_stack);
+    free(inst->row_map);
+    free(inst->col_map);
+    free(inst->row_index);
+    free(inst->col_index);
+    free(inst->col_wise_a16);
+    free(inst->row_wise_a16);
+
+    if (inst->mapped_base) {
+        munmap(inst->mapped_base, inst->mapped_size);
+    } else {
+        free(inst->costs);
+        free(inst->col_wise_a);
+        free(inst->col_wise_idx);
+        free(inst->row_wise_a);
+        free(inst->row_wise_idx);
+        free(inst->col_sizes);
+        free(inst->row_sizes);
+    }
+    free(inst);
+}
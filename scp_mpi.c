@@ -0,0 +1,783 @@
+/***
+Row-partitioned subgradient methods over MPI ranks, see scp_mpi.h
+
+Every rank keeps the reduced costs of all columns. A dual step scatters the moved rows of
+the rank into a per-column shift, one allreduce adds up the shifts of all ranks (with the
+scalars of the step in its tail), and every rank applies the total to its copy, so the
+copies stay equal. The line search steps back along the same total and only reduces the
+change of the dual sum. Subgradient entries belong to the rows, so each rank computes
+its own and reduces their norm.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "scp_internal.h"
+#include "scp_mpi.h"
+
+
+// scalars reduced in the tail of the column shift
+#define TAIL_DUAL_SUM   0   // sum of the dual entries after the step
+#define TAIL_PRODUCT    1   // SPS: dd . momentum
+#define TAIL_MOVED      2   // rows whose dual moved
+#define TAIL_SIZE       3
+
+// scalars of a subgradient reduction
+#define SUBG_NONZERO    0   // nonzero entries
+#define SUBG_NORM       1   // squared norm
+#define SUBG_PROJ_NORM  2   // squared norm without the rows BSM projects to 0
+#define SUBG_DD_DD      3   // SPS: dot products of the spectral step length
+#define SUBG_DD_DG      4
+#define SUBG_SIZE       5
+
+// SPS iterations between recomputations of the float reduced costs from the dual vector
+#define FLOAT_REFRESH   64
+
+// phase timers of a solve, a predictable branch when params->phase_timers is off
+#define PHASE_MARK(on, mark)            if (on) { (mark) = MPI_Wtime(); }
+#define PHASE_ADD(on, mark, total)      if (on) { double t_ = MPI_Wtime(); \
+                                                  (total) += t_ - (mark); (mark) = t_; }
+
+
+/* Share of a rank of a row-partitioned instance. */
+struct scp_dist {
+    MPI_Comm comm;                  // duplicate of the communicator of load_scp_dist_r
+    int rank, num_ranks;
+    int num_row, num_col;           // of the instance
+    int first_row, local_rows;      // rows [first_row, first_row + local_rows) are held here
+    scp_instance *part;             // rows of this rank (text) or the mapped file (.scpb)
+    const int *row_wise_idx;        // start of each local row in row_wise_a
+    const int *row_wise_a;
+    const int *costs;
+    int *col_sizes;                 // entries of each column over all ranks
+
+    // working vectors, allocated with the instance so that no rank fails halfway a solve
+    scp_real *reduced_costs;        // of all columns, equal on every rank
+    double *col_shift;              // per-column step of all ranks, then TAIL_SIZE scalars
+    scp_real *dual1, *dual2, *momentum, *dd;
+    int *subg, *dd_subg;
+};
+
+
+/* Returns 1 if failed is set on any rank of comm, otherwise returns 0. */
+static int any_failed(MPI_Comm comm, int failed)
+{
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, comm);
+    return failed;
+}
+
+
+/* Loads the rows of this rank into dist.
+Returns 0 on success, otherwise returns -1. */
+static int load_part(scp_dist *dist, const char *filename)
+{
+    const size_t len = strlen(filename);
+
+    if (len > 5 && strcmp(filename + len - 5, ".scpb") == 0) {
+        if ((dist->part = load_scp_instance_bin_r(filename)) == NULL) return -1;
+        dist->num_row = dist->part->num_row;
+        dist->first_row = SCP_PART_BEGIN(dist->rank, dist->num_ranks, dist->num_row);
+        dist->local_rows = SCP_PART_BEGIN(dist->rank + 1, dist->num_ranks, dist->num_row)
+                           - dist->first_row;
+        dist->row_wise_idx = dist->part->row_wise_idx + dist->first_row;
+    } else {
+        dist->part = load_scp_instance_part_r(filename, dist->rank, dist->num_ranks,
+                                              &dist->num_row);
+        if (dist->part == NULL) return -1;
+        dist->first_row = SCP_PART_BEGIN(dist->rank, dist->num_ranks, dist->num_row);
+        dist->local_rows = dist->part->num_row;
+        dist->row_wise_idx = dist->part->row_wise_idx;
+    }
+    dist->num_col = dist->part->num_col;
+    dist->row_wise_a = dist->part->row_wise_a;
+    dist->costs = dist->part->costs;
+    return 0;
+}
+
+
+/* Allocates the column sizes and working vectors of dist.
+Returns 0 on success, otherwise returns -1. */
+static int alloc_working(scp_dist *dist)
+{
+    const int num_col = dist->num_col > 0 ? dist->num_col : 1;
+    const int num_row = dist->local_rows > 0 ? dist->local_rows : 1;
+
+    MALLOC(dist->col_sizes, int *, num_col * sizeof(int))
+    MALLOC(dist->reduced_costs, scp_real *, num_col * sizeof(scp_real))
+    MALLOC(dist->col_shift, double *, (num_col + TAIL_SIZE) * sizeof(double))
+    MALLOC(dist->dual1, scp_real *, num_row * sizeof(scp_real))
+    MALLOC(dist->dual2, scp_real *, num_row * sizeof(scp_real))
+    MALLOC(dist->momentum, scp_real *, num_row * sizeof(scp_real))
+    MALLOC(dist->dd, scp_real *, num_row * sizeof(scp_real))
+    MALLOC(dist->subg, int *, num_row * sizeof(int))
+    MALLOC(dist->dd_subg, int *, num_row * sizeof(int))
+    return 0;
+}
+
+
+scp_dist *load_scp_dist_r(const char *filename, MPI_Comm comm)
+{
+    int i, sizes[2];
+    scp_dist *dist;
+
+    if ((dist = (scp_dist *) calloc(1, sizeof(scp_dist))) == NULL) {
+        perror("Error malloc");
+    } else {
+        MPI_Comm_dup(comm, &dist->comm);
+        comm = dist->comm;
+        MPI_Comm_rank(comm, &dist->rank);
+        MPI_Comm_size(comm, &dist->num_ranks);
+    }
+    if (any_failed(comm, dist == NULL || load_part(dist, filename) || alloc_working(dist))) {
+        free_scp_dist_r(dist);
+        return NULL;
+    }
+
+    // all ranks must have read the same instance
+    sizes[0] = dist->num_row;
+    sizes[1] = dist->num_col;
+    MPI_Bcast(sizes, 2, MPI_INT, 0, comm);
+    if (any_failed(comm, sizes[0] != dist->num_row || sizes[1] != dist->num_col)) {
+        if (dist->rank == 0) fprintf(stderr, "Error: ranks read different instances\n");
+        free_scp_dist_r(dist);
+        return NULL;
+    }
+
+    // column sizes over all rows, for the initial dual vector
+    if (dist->part->col_wise_idx != NULL) {
+        for (i = 0; i < dist->num_col; i++) {
+            dist->col_sizes[i] = dist->part->col_wise_idx[i+1] - dist->part->col_wise_idx[i];
+        }
+    } else {
+        MPI_Allreduce(dist->part->col_sizes, dist->col_sizes, dist->num_col, MPI_INT, MPI_SUM,
+                      comm);
+    }
+    return dist;
+}
+
+
+void free_scp_dist_r(scp_dist *dist)
+{
+    if (dist == NULL) return;
+    free_scp_instance_r(dist->part);
+    free(dist->col_sizes);
+    free(dist->reduced_costs);
+    free(dist->col_shift);
+    free(dist->dual1);
+    free(dist->dual2);
+    free(dist->momentum);
+    free(dist->dd);
+    free(dist->subg);
+    free(dist->dd_subg);
+    if (dist->comm != MPI_COMM_NULL) MPI_Comm_free(&dist->comm);
+    free(dist);
+}
+
+
+int get_dist_num_row(const scp_dist *dist) { return dist->num_row; }
+
+int get_dist_num_col(const scp_dist *dist) { return dist->num_col; }
+
+int get_dist_first_row(const scp_dist *dist) { return dist->first_row; }
+
+int get_dist_local_rows(const scp_dist *dist) { return dist->local_rows; }
+
+
+scp_result *create_scp_dist_result(const scp_dist *dist)
+{
+    scp_instance rows;
+
+    // a result handle only needs the number of rows of its dual vector
+    memset(&rows, 0, sizeof(scp_instance));
+    rows.num_row = dist->local_rows;
+    return create_scp_result(&rows);
+}
+
+
+int gather_dist_dual_vector(const scp_dist *dist, const scp_result *res, double *dual, int root)
+{
+    int r, *counts = NULL, *displs = NULL, failed = 0;
+
+    if (dist->rank == root) {
+        counts = (int *) malloc(dist->num_ranks * sizeof(int));
+        displs = (int *) malloc(dist->num_ranks * sizeof(int));
+        if (counts == NULL || displs == NULL) {
+            perror("Error malloc");
+            failed = 1;
+        } else {
+            for (r = 0; r < dist->num_ranks; r++) {
+                displs[r] = SCP_PART_BEGIN(r, dist->num_ranks, dist->num_row);
+                counts[r] = SCP_PART_BEGIN(r + 1, dist->num_ranks, dist->num_row) - displs[r];
+            }
+        }
+    }
+    if (!any_failed(dist->comm, failed)) {
+        MPI_Gatherv(res->best_dual, dist->local_rows, MPI_DOUBLE, dual, counts, displs,
+                    MPI_DOUBLE, root, dist->comm);
+    }
+    free(counts);
+    free(displs);
+    return failed ? -1 : 0;
+}
+
+
+/* Sets the local entries of dual to init_dual (negative entries raised to 0), or without
+init_dual, to min(cost/size) over the columns of each row.
+Returns the sum of the local entries. */
+static double init_dist_dual(const scp_dist *dist, const double *init_dual, scp_real *dual)
+{
+    int i, j, idx;
+    double min_value, value, dual_sum = 0.0;
+    const int *costs = dist->costs;
+    const int *row_wise_idx = dist->row_wise_idx;
+    const int *row_wise_a = dist->row_wise_a;
+
+    for (i = 0; i < dist->local_rows; i++) {
+        if (init_dual != NULL) {
+            dual[i] = init_dual[dist->first_row + i];
+            dual[i] = dual[i] > 0 ? dual[i] : 0.0;
+        } else {
+            min_value = costs[row_wise_a[row_wise_idx[i]]];
+            for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+                idx = row_wise_a[j];
+                value = (double) costs[idx] / dist->col_sizes[idx];
+                if (value < min_value) {
+                    min_value = value;
+                }
+            }
+            dual[i] = min_value;
+        }
+        dual_sum += dual[i];
+    }
+    return dual_sum;
+}
+
+
+/* Scatters the local step x (entries within ZERO_TOL skipped) into the column shift and
+adds up the shifts and the tail scalars of all ranks. */
+static void reduce_col_shift(scp_dist *dist, const scp_real *x)
+{
+    int i, j;
+    double value;
+    double *col_shift = dist->col_shift;
+    const int *row_wise_idx = dist->row_wise_idx;
+    const int *row_wise_a = dist->row_wise_a;
+
+    memset(col_shift, 0, dist->num_col * sizeof(double));
+    for (i = 0; i < dist->local_rows; i++) {
+        value = x[i];
+        if (value < - ZERO_TOL || value > ZERO_TOL) {
+            for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+                col_shift[row_wise_a[j]] += value;
+            }
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, col_shift, dist->num_col + TAIL_SIZE, MPI_DOUBLE, MPI_SUM,
+                  dist->comm);
+}
+
+
+/* Subtracts scale times the column shift from the reduced costs.
+Returns the sum of the negative reduced costs. */
+static double shift_dist_reduced_costs(scp_dist *dist, double scale)
+{
+    int j;
+    double neg_sum = 0.0;
+    scp_real *reduced_costs = dist->reduced_costs;
+    const double *col_shift = dist->col_shift;
+
+    for (j = 0; j < dist->num_col; j++) {
+        reduced_costs[j] -= scale * col_shift[j];
+        if (reduced_costs[j] < 0) {
+            neg_sum += reduced_costs[j];
+        }
+    }
+    return neg_sum;
+}
+
+
+/* Computes reduced costs of dual (the local entries summing to dual_sum).
+Returns obj value of dual. */
+static double init_dist_reduced_costs(scp_dist *dist, const scp_real *dual, double dual_sum)
+{
+    int j;
+
+    for (j = 0; j < dist->num_col; j++) {
+        dist->reduced_costs[j] = dist->costs[j];
+    }
+    dist->col_shift[dist->num_col + TAIL_DUAL_SUM] = dual_sum;
+    reduce_col_shift(dist, dual);
+    return dist->col_shift[dist->num_col + TAIL_DUAL_SUM] + shift_dist_reduced_costs(dist, 1.0);
+}
+
+
+/* Computes the local subgradient entries and reduces the SUBG_* scalars of all ranks into
+sums; dual is for the projection of BSM, with_step adds the dot products of SPS. */
+static void dist_subgradient(scp_dist *dist, const scp_real *dual, int with_step, double *sums)
+{
+    int i, j, g;
+    double value;
+    int *subg = dist->subg;
+    const scp_real *reduced_costs = dist->reduced_costs;
+    const int *row_wise_idx = dist->row_wise_idx;
+    const int *row_wise_a = dist->row_wise_a;
+
+    memset(sums, 0, SUBG_SIZE * sizeof(double));
+    for (i = 0; i < dist->local_rows; i++) {
+        g = 1;
+        for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
+            g -= reduced_costs[row_wise_a[j]] < SUBG_TOL;
+        }
+        subg[i] = g;
+        sums[SUBG_NONZERO] += g != 0;
+        sums[SUBG_NORM] += g * g;
+        if (g > 0 || (g < 0 && dual[i] >= SUBG_TOL)) {
+            sums[SUBG_PROJ_NORM] += g * g;
+        }
+        if (with_step) {
+            value = dist->dd[i];
+            sums[SUBG_DD_DD] += value * value;
+            sums[SUBG_DD_DG] += value * (dist->dd_subg[i] - g);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, sums, SUBG_SIZE, MPI_DOUBLE, MPI_SUM, dist->comm);
+}
+
+
+/* Returns SCP_STOP_* reason if the solve should stop on any rank, otherwise returns 0. The
+time limit is the only criterion that can differ between the ranks. */
+static int dist_termination(scp_dist *dist, const scp_termination *term, stop_state *st,
+                            int itr, double best_obj)
+{
+    int stop = check_termination(term, st, itr, best_obj);
+
+    if (term->time_limit > 0) {
+        MPI_Allreduce(MPI_IN_PLACE, &stop, 1, MPI_INT, MPI_MAX, dist->comm);
+    }
+    return stop;
+}
+
+
+/* Stores the local entries of best_dual and its bound best_obj, as tracked by the
+iterations, in res. With float working vectors, the bound is recomputed in double.
+Returns the bound stored in res. */
+static double store_dist_dual(scp_dist *dist, scp_result *res, const scp_real *best_dual,
+                              double best_obj)
+{
+    int i;
+
+    for (i = 0; i < dist->local_rows; i++) {
+        res->best_dual[i] = best_dual[i];
+    }
+    res->working_obj = best_obj;
+#ifdef SCP_FLOAT
+    {
+        int j;
+        double value, *col_shift = dist->col_shift;
+
+        // reduce_col_shift of the double dual vector, without skipping small entries
+        memset(col_shift, 0, (dist->num_col + TAIL_SIZE) * sizeof(double));
+        for (i = 0; i < dist->local_rows; i++) {
+            for (j = dist->row_wise_idx[i]; j < dist->row_wise_idx[i+1]; j++) {
+                col_shift[dist->row_wise_a[j]] += res->best_dual[i];
+            }
+            col_shift[dist->num_col + TAIL_DUAL_SUM] += res->best_dual[i];
+        }
+        MPI_Allreduce(MPI_IN_PLACE, col_shift, dist->num_col + TAIL_SIZE, MPI_DOUBLE, MPI_SUM,
+                      dist->comm);
+        best_obj = col_shift[dist->num_col + TAIL_DUAL_SUM];
+        for (j = 0; j < dist->num_col; j++) {
+            value = dist->costs[j] - col_shift[j];
+            if (value < 0) {
+                best_obj += value;
+            }
+        }
+    }
+#endif
+    res->best_obj = best_obj;
+    return best_obj;
+}
+
+
+/************** Spectral projected subgradient **************
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double spectral_projected_subgradient_dist(scp_dist *dist, scp_result *res,
+                                           const scp_params *params, const double *init_dual)
+{
+    double curr_obj, best_obj, worst_obj, sub_obj, neg_sum, *past_objs;
+    scp_real *curr_dual, *old_dual, *best_dual, *momentum, *dd;
+    int worst_obj_idx, moved;
+    double alpha, eta, eta_not, tau, accept, product, value, shift, subg_norm;
+    double sums[SUBG_SIZE];
+    double *tail = dist->col_shift + dist->num_col;
+    int itr, i, j, halvings, stop;
+    unsigned char is_opt;
+    double phase_mark = 0.0;
+    stop_state st;
+    scp_trace_info info;
+
+    const int M = params->sps_memory > 0 ? params->sps_memory : 1;
+    const double mu = params->sps_momentum;
+    const double gamma = params->sps_gamma;
+
+    const int num_row = dist->local_rows;
+    const int *subg = dist->subg;
+    int *dd_subg = dist->dd_subg;
+    const int max_itr = params->max_itr;
+    const int max_halvings = params->term.max_halvings;
+    const int timers = params->phase_timers;
+    double *phase_time = res->phase_time;
+
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+
+    past_objs = (double *) malloc(M * sizeof(double));
+    if (past_objs == NULL) perror("Error malloc");
+    if (any_failed(dist->comm, past_objs == NULL)) {
+        free(past_objs);
+        return -1;
+    }
+    momentum = dist->momentum;
+    memset(momentum, 0, num_row * sizeof(scp_real));
+    dd = dist->dd;
+
+    // init data
+    old_dual = curr_dual = dist->dual1;
+    best_dual = dist->dual2;
+    curr_obj = init_dist_reduced_costs(dist, curr_dual, init_dist_dual(dist, init_dual,
+                                                                       curr_dual));
+    memcpy(best_dual, curr_dual, num_row * sizeof(scp_real)); // until an iteration improves
+    best_obj = worst_obj = past_objs[(worst_obj_idx=0)] = curr_obj;
+
+    alpha = params->sps_alpha; // init alpha
+
+    itr = 0;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    dist_subgradient(dist, curr_dual, 0, sums);
+    is_opt = sums[SUBG_NONZERO] == 0;
+    if (is_opt || stop) goto cleanup;
+
+    // compute eta_not
+    eta_not = subg_norm = sqrt(sums[SUBG_NORM]);
+
+    for (itr = 0; itr < max_itr; itr++) {
+        PHASE_MARK(timers, phase_mark);
+
+        // update dual vector, the step of all ranks goes through the column shift
+        sub_obj = product = 0.0;
+        moved = 0;
+        for (i = 0; i < num_row; i++) {
+            momentum[i] = alpha * subg[i] + mu * momentum[i];
+            value = old_dual[i] + momentum[i];
+            if (value < 0) {
+                value = 0;
+            }
+            value -= old_dual[i];
+            if (value < - ZERO_TOL || value > ZERO_TOL) {
+                curr_dual[i] = old_dual[i] + value;
+                product += value * momentum[i];
+                moved++;
+            } else {
+                curr_dual[i] = old_dual[i];
+                value = 0.0;
+            }
+            dd[i] = value;
+            dd_subg[i] = subg[i];
+            sub_obj += curr_dual[i];
+        }
+        tail[TAIL_DUAL_SUM] = sub_obj;
+        tail[TAIL_PRODUCT] = product;
+        tail[TAIL_MOVED] = moved;
+        reduce_col_shift(dist, dd);
+        sub_obj = tail[TAIL_DUAL_SUM];
+        product = tail[TAIL_PRODUCT];
+        moved = (int) tail[TAIL_MOVED];
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_DUAL]);
+
+        // compute current obj value
+        curr_obj = sub_obj + shift_dist_reduced_costs(dist, 1.0);
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_OBJECTIVE]);
+
+        // non-monotone line search along the direction dd, all ranks see the same test
+        product /= alpha;
+        tau = 1.0;
+        eta = eta_not / pow(itr, 1.1);
+        accept = worst_obj + gamma * tau * product - eta;
+        halvings = 0;
+        while (curr_obj < accept) {
+            if (max_halvings > 0 && halvings++ == max_halvings) {
+                stop = SCP_STOP_LINE_SEARCH;
+                break;
+            }
+            // step back by tau * dd
+            tau *= 0.5;
+            shift = 0.0;
+            for (i = 0; i < num_row; i++) {
+                value = tau * dd[i];
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    shift += step_down(&curr_dual[i], value);
+                }
+            }
+            MPI_Allreduce(MPI_IN_PLACE, &shift, 1, MPI_DOUBLE, MPI_SUM, dist->comm);
+            sub_obj -= shift;
+            neg_sum = shift_dist_reduced_costs(dist, -tau);
+
+            // compute adjusted obj value
+            curr_obj = sub_obj + neg_sum;
+            accept -= gamma * tau * product;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_LINE_SEARCH]);
+#ifdef SCP_FLOAT
+        if (itr % FLOAT_REFRESH == FLOAT_REFRESH - 1) {
+            for (i = 0, value = 0.0; i < num_row; i++) {
+                value += curr_dual[i];
+            }
+            curr_obj = init_dist_reduced_costs(dist, curr_dual, value);
+            PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_OBJECTIVE]);
+        }
+#endif
+
+        // update best solution
+        if (best_obj < curr_obj) {
+            best_obj = curr_obj;
+
+            // swap
+            old_dual = curr_dual;
+            curr_dual = best_dual;
+            best_dual = old_dual;
+        }  else {
+            old_dual = curr_dual;
+        }
+
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = alpha;
+            info.tau = tau;
+            info.dd_size = moved;
+            info.subg_norm = subg_norm;
+            params->trace(&info, params->trace_data);
+        }
+
+        if (!stop) stop = dist_termination(dist, &params->term, &st, itr, best_obj);
+        if (stop) {
+            itr++;
+            break;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+
+        // compute subgradient vector, with the dot products of alpha in one reduction
+        dist_subgradient(dist, old_dual, 1, sums);
+        subg_norm = sqrt(sums[SUBG_NORM]);
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_SUBGRADIENT]);
+        if (sums[SUBG_NONZERO] == 0) {
+            is_opt = 1;
+            itr++; // count the finished iteration
+            break;
+        }
+
+        // update alpha
+        if (sums[SUBG_DD_DG] < ZERO_TOL) {
+            alpha = params->sps_alpha;
+        } else {
+            alpha = tau * sums[SUBG_DD_DD] / sums[SUBG_DD_DG];
+        }
+
+        // update worst_lb
+        i = (itr+1) % M;
+        past_objs[i] = curr_obj;
+        if (i == worst_obj_idx) {
+            if (curr_obj <= worst_obj) {
+                worst_obj = curr_obj;
+            } else {
+                worst_obj = curr_obj;
+                for (j = M-1; j >= 0; j--) {
+                    if (past_objs[j] < worst_obj) {
+                        worst_obj = past_objs[j];
+                        worst_obj_idx = j;
+                    }
+                }
+            }
+        } else if (curr_obj < worst_obj) {
+            worst_obj = curr_obj;
+            worst_obj_idx = i;
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+    }
+
+
+cleanup:
+    if (is_opt) {
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
+        best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
+    }
+
+    best_obj = store_dist_dual(dist, res, best_dual, best_obj);
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+    free(past_objs);
+
+    return best_obj;
+}
+
+
+/* Beasley's subgradient method
+Returns best (maximum) dual solution
+Returns -1 on system failure */
+double basic_subgradient_dist(scp_dist *dist, scp_result *res, const scp_params *params,
+                              const double *init_dual)
+{
+    double curr_obj, best_obj;
+    scp_real *curr_dual, *old_dual, *best_dual, *dd;
+    int itr, counter, i, g, stop, moved;
+    double norm, lambda, step_size, value;
+    double sums[SUBG_SIZE];
+    double *tail = dist->col_shift + dist->num_col;
+    double phase_mark = 0.0;
+    stop_state st;
+    scp_trace_info info;
+
+    const int counter_limit = params->bsm_patience;
+
+    const int num_row = dist->local_rows;
+    const int *subg = dist->subg;
+    const int max_itr = params->max_itr;
+    const int timers = params->phase_timers;
+    const double upperbound = params->upperbound;
+    double *phase_time = res->phase_time;
+
+    // the heuristic needs whole columns, so the step size takes the given upperbound only
+    if (params->upperbound <= 0) {
+        if (dist->rank == 0) fprintf(stderr, "Error: distributed BSM needs an upperbound\n");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+    dd = dist->dd;
+
+    // init data
+    old_dual = curr_dual = dist->dual1;
+    best_dual = dist->dual2;
+    curr_obj = init_dist_reduced_costs(dist, curr_dual, init_dist_dual(dist, init_dual,
+                                                                       curr_dual));
+    memcpy(best_dual, curr_dual, num_row * sizeof(scp_real)); // until an iteration improves
+    best_obj = curr_obj;
+
+    itr = counter = 0;
+    norm = 0;
+    lambda = params->bsm_lambda;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    for (itr = 0; itr < max_itr && !stop; itr++) {
+        PHASE_MARK(timers, phase_mark);
+
+        // compute subgradient vector and step size
+        dist_subgradient(dist, old_dual, 0, sums);
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_SUBGRADIENT]);
+        if (sums[SUBG_NONZERO] == 0) {
+            norm = -1;
+            break;
+        }
+        norm = sums[SUBG_PROJ_NORM] > 0 ? sums[SUBG_PROJ_NORM] : 1;
+
+        step_size = lambda * (1.05 * upperbound - curr_obj) / norm;
+
+        // update dual vector and objective value
+        curr_obj = 0.0;
+        moved = 0;
+        for (i = 0; i < num_row; i++) {
+            g = subg[i];
+            if (g < 0 && old_dual[i] < SUBG_TOL) {
+                g = 0; // projected
+            }
+            value = step_size * g;
+            curr_dual[i] =  old_dual[i] + value;
+            if (curr_dual[i] < 0) {
+                value -= curr_dual[i];
+                curr_dual[i] = 0.0;
+            }
+
+            if (value < - ZERO_TOL || value > ZERO_TOL) {
+                moved++;
+            } else {
+                value = 0.0;
+            }
+            dd[i] = value;
+            curr_obj += curr_dual[i];
+        }
+        tail[TAIL_DUAL_SUM] = curr_obj;
+        tail[TAIL_PRODUCT] = 0.0;
+        tail[TAIL_MOVED] = moved;
+        reduce_col_shift(dist, dd);
+        curr_obj = tail[TAIL_DUAL_SUM];
+        moved = (int) tail[TAIL_MOVED];
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_DUAL]);
+
+        // compute current obj value
+        curr_obj += shift_dist_reduced_costs(dist, 1.0);
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_OBJECTIVE]);
+
+        // update best solution
+        if (best_obj < curr_obj) {
+            best_obj = curr_obj;
+            counter = 0;
+
+            // swap
+            old_dual = curr_dual;
+            curr_dual = best_dual;
+            best_dual = old_dual;
+        } else {
+            counter++;
+            old_dual = curr_dual;
+        }
+
+        if (counter > counter_limit) {
+            lambda *= 0.5;
+            counter = 0;
+        }
+
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = step_size;
+            info.tau = 1.0;
+            info.subg_norm = sqrt(norm);
+            info.dd_size = moved;
+            params->trace(&info, params->trace_data);
+        }
+        PHASE_ADD(timers, phase_mark, phase_time[SCP_PHASE_BOOKKEEPING]);
+
+        if ((stop = dist_termination(dist, &params->term, &st, itr, best_obj)) != 0) {
+            itr++;
+            break;
+        }
+    }
+
+
+    if (norm < 0) {
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
+        best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
+    }
+
+    best_obj = store_dist_dual(dist, res, best_dual, best_obj);
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+
+    return best_obj;
+}
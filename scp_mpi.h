@@ -0,0 +1,52 @@
+/*** header file, row-partitioned solve over MPI ranks (built with make MPI=1)
+
+The rows of an instance are split into contiguous shares, one per rank of a communicator.
+A rank holds the row-wise matrix of its share and the dual entries of its rows, plus the
+costs and the reduced costs of all columns; no rank holds a col-wise matrix. The column
+shifts of the dual step of all ranks are combined with one allreduce over the columns per
+iteration, the scalars (objective, subgradient norm, step length, line search test) with
+small allreduces, so that every rank takes the same decisions. All functions below are
+collective over the communicator of the instance.
+***/
+
+#ifndef Scp_mpi_h
+#define Scp_mpi_h
+
+#include <mpi.h>
+#include "subgradient.h"
+
+typedef struct scp_dist scp_dist;
+
+/* Loads the share of this rank of instance file over the ranks of comm. Text files are
+parsed by every rank, which keeps its own rows only; .scpb files are mapped in place.
+Returns new instance on all ranks, or NULL on all ranks if loading failed on any. */
+scp_dist *load_scp_dist_r(const char *filename, MPI_Comm comm);
+
+void free_scp_dist_r(scp_dist *dist);
+
+int get_dist_num_row(const scp_dist *dist);     // rows of the instance
+int get_dist_num_col(const scp_dist *dist);
+int get_dist_first_row(const scp_dist *dist);   // first row held by this rank
+int get_dist_local_rows(const scp_dist *dist);  // rows held by this rank
+
+/* Creates result handle for the rows of this rank, get_dual_vector_r copies their duals.
+Returns NULL on failure. */
+scp_result *create_scp_dist_result(const scp_dist *dist);
+
+/* SPS and BSM on dist with the settings of params. The Lagrangian heuristic, the
+breakpoint line search (run as halving) and num_threads do not apply, so BSM needs
+params->upperbound > 0. init_dual, indexed by the rows of the instance, is the warm start
+of the solve, NULL for the cold start.
+Returns best (maximum) dual solution on all ranks.
+Returns -1 on system failure. */
+double spectral_projected_subgradient_dist(scp_dist *dist, scp_result *res,
+                                           const scp_params *params, const double *init_dual);
+double basic_subgradient_dist(scp_dist *dist, scp_result *res, const scp_params *params,
+                              const double *init_dual);
+
+/* Gathers the best dual vectors of res of all ranks into dual (get_dist_num_row entries)
+on rank root, dual is ignored on the other ranks.
+Returns 0 on success, otherwise returns -1. */
+int gather_dist_dual_vector(const scp_dist *dist, const scp_result *res, double *dual, int root);
+
+#endif /* Scp_mpi_h */
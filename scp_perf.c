@@ -0,0 +1,144 @@
+/***
+Hardware performance counters of the solver phases, on Linux perf_event_open.
+
+The counters are opened as one group led by the cycle counter, so that a single read
+returns all of them for the same interval, and count the user space of the calling thread
+only. Events the CPU (or the kernel, see perf_event_paranoid) does not offer are left out
+of the group and reported as -1. Elsewhere no counter opens.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scp_internal.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+struct scp_perf {
+    int fd[SCP_NUM_COUNTERS];           // -1 if the event did not open
+    int slot[SCP_NUM_COUNTERS];         // position of the event in a group read
+    int num_open;
+    long long last[SCP_NUM_COUNTERS];   // values of the last read
+    long long (*counters)[SCP_NUM_COUNTERS];
+};
+
+
+#ifdef __linux__
+static int open_event(unsigned long long config, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+
+/* Reads the group of perf into values (SCP_NUM_COUNTERS entries, 0 for closed events).
+Returns 0 on success, otherwise returns -1. */
+static int read_group(const scp_perf *perf, long long *values)
+{
+    int k;
+    unsigned long long buf[1 + SCP_NUM_COUNTERS];
+
+    if (read(perf->fd[0], buf, sizeof(buf)) < (ssize_t) ((1 + perf->num_open) * sizeof(buf[0]))) {
+        return -1;
+    }
+    for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+        values[k] = perf->fd[k] != -1 ? (long long) buf[1 + perf->slot[k]] : 0;
+    }
+    return 0;
+}
+#endif
+
+
+scp_perf *open_scp_perf(long long (*counters)[SCP_NUM_COUNTERS])
+{
+    int p, k;
+    scp_perf *perf = NULL;
+
+    for (p = 0; p < SCP_NUM_PHASES; p++) {
+        for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+            counters[p][k] = -1;
+        }
+    }
+#ifdef __linux__
+    static const unsigned long long configs[SCP_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_STALLED_CYCLES_BACKEND
+    };
+
+    if ((perf = (scp_perf *) malloc(sizeof(scp_perf))) == NULL) {
+        perror("Error malloc");
+        return NULL;
+    }
+    perf->num_open = 0;
+    perf->counters = counters;
+    for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+        perf->fd[k] = -1;
+    }
+    for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+        perf->fd[k] = open_event(configs[k], k == 0 ? -1 : perf->fd[0]);
+        if (perf->fd[k] == -1 && k == 0) break; // without the leader there is no group
+        if (perf->fd[k] != -1) perf->slot[k] = perf->num_open++;
+    }
+    if (perf->fd[0] == -1 || read_group(perf, perf->last)) {
+        close_scp_perf(perf);
+        return NULL;
+    }
+    for (p = 0; p < SCP_NUM_PHASES; p++) {
+        for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+            counters[p][k] = perf->fd[k] != -1 ? 0 : -1;
+        }
+    }
+#endif
+    return perf;
+}
+
+
+void scp_perf_mark(scp_perf *perf)
+{
+#ifdef __linux__
+    read_group(perf, perf->last);
+#endif
+}
+
+
+void scp_perf_add(scp_perf *perf, int phase)
+{
+#ifdef __linux__
+    int k;
+    long long values[SCP_NUM_COUNTERS];
+
+    if (read_group(perf, values)) return;
+    for (k = 0; k < SCP_NUM_COUNTERS; k++) {
+        if (perf->fd[k] == -1) continue;
+        perf->counters[phase][k] += values[k] - perf->last[k];
+        perf->last[k] = values[k];
+    }
+#endif
+}
+
+
+void close_scp_perf(scp_perf *perf)
+{
+#ifdef __linux__
+    int k;
+
+    if (perf == NULL) return;
+    for (k = SCP_NUM_COUNTERS - 1; k >= 0; k--) {
+        if (perf->fd[k] != -1) close(perf->fd[k]);
+    }
+#endif
+    free(perf);
+}
@@ -0,0 +1,390 @@
+/***
+Vectorized kernels of the subgradient iterations, with runtime CPU dispatch.
+
+The AVX2 and AVX-512 versions are compiled through target attributes, so the rest of
+the library keeps the baseline instruction set and runs on any x86-64 CPU. With float
+working vectors (SCP_FLOAT), they load twice as many entries per vector and widen them to
+double before accumulating.
+
+***/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scp_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCP_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+/*** scalar ***/
+
+static double sum_negative_scalar(const scp_real *x, int n)
+{
+    int i;
+    double sum = 0.0;
+
+    for (i = 0; i < n; i++) {
+        if (x[i] < 0) {
+            sum += x[i];
+        }
+    }
+    return sum;
+}
+
+
+static void below_mask_scalar(const scp_real *x, int n, double tol, unsigned char *mask)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        mask[i] = x[i] < tol;
+    }
+}
+
+
+static void dd_dots_scalar(const scp_real *dd, const int *idx, const int *old_g, const int *g,
+                           int n, double *dd_dd, double *dd_dg)
+{
+    int i, k;
+    double value, aa = 0.0, ag = 0.0;
+
+    for (k = 0; k < n; k++) {
+        i = idx[k];
+        value = dd[i];
+        aa += value * value;
+        ag += value * (old_g[k] - g[i]);
+    }
+    *dd_dd += aa;
+    *dd_dg += ag;
+}
+
+
+static const scp_simd_kernels kernels_scalar = {
+    "scalar", sum_negative_scalar, below_mask_scalar, dd_dots_scalar
+};
+
+
+#ifdef SCP_SIMD_X86
+
+// little-endian bytes 0/1 of a 4-bit mask
+static const unsigned int mask_bytes[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101,
+    0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101,
+    0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+#ifdef SCP_FLOAT
+// smallest float >= tol, float x is below it exactly if x < tol
+static float float_bound(double tol)
+{
+    float t = (float) tol;
+    return t < tol ? nextafterf(t, HUGE_VALF) : t;
+}
+#endif
+
+
+/*** AVX2 ***/
+
+__attribute__((target("avx2,fma")))
+static double hsum_avx2(__m256d v)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+
+#ifdef SCP_FLOAT
+__attribute__((target("avx2,fma")))
+static double sum_negative_avx2(const float *x, int n)
+{
+    int i;
+    double sum;
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 v0, v1;
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v0 = _mm256_min_ps(_mm256_loadu_ps(x + i), zero);
+        v1 = _mm256_min_ps(_mm256_loadu_ps(x + i + 8), zero);
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(v0)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(v0, 1)));
+        acc2 = _mm256_add_pd(acc2, _mm256_cvtps_pd(_mm256_castps256_ps128(v1)));
+        acc3 = _mm256_add_pd(acc3, _mm256_cvtps_pd(_mm256_extractf128_ps(v1, 1)));
+    }
+    sum = hsum_avx2(_mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3)));
+    return sum + sum_negative_scalar(x + i, n - i);
+}
+
+
+__attribute__((target("avx2,fma")))
+static void below_mask_avx2(const float *x, int n, double tol, unsigned char *mask)
+{
+    int i;
+    unsigned int m;
+    const __m256 t = _mm256_set1_ps(float_bound(tol));
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        m = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + i), t, _CMP_LT_OQ));
+        memcpy(mask + i, &mask_bytes[m & 15], 4);
+        memcpy(mask + i + 4, &mask_bytes[m >> 4], 4);
+    }
+    below_mask_scalar(x + i, n - i, tol, mask + i);
+}
+
+
+__attribute__((target("avx2,fma")))
+static void dd_dots_avx2(const float *dd, const int *idx, const int *old_g, const int *g, int n,
+                         double *dd_dd, double *dd_dg)
+{
+    int k;
+    __m128i vidx, diff;
+    __m256d value, aa = _mm256_setzero_pd(), ag = _mm256_setzero_pd();
+
+    for (k = 0; k + 4 <= n; k += 4) {
+        vidx = _mm_loadu_si128((const __m128i *) (idx + k));
+        value = _mm256_cvtps_pd(_mm_i32gather_ps(dd, vidx, 4));
+        diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (old_g + k)),
+                             _mm_i32gather_epi32(g, vidx, 4));
+        aa = _mm256_fmadd_pd(value, value, aa);
+        ag = _mm256_fmadd_pd(value, _mm256_cvtepi32_pd(diff), ag);
+    }
+    *dd_dd += hsum_avx2(aa);
+    *dd_dg += hsum_avx2(ag);
+    dd_dots_scalar(dd, idx + k, old_g + k, g, n - k, dd_dd, dd_dg);
+}
+
+#else
+__attribute__((target("avx2,fma")))
+static double sum_negative_avx2(const double *x, int n)
+{
+    int i;
+    double sum;
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+    // min(x, 0) is x for negative x and 0 otherwise
+    for (i = 0; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_min_pd(_mm256_loadu_pd(x + i), zero));
+        acc1 = _mm256_add_pd(acc1, _mm256_min_pd(_mm256_loadu_pd(x + i + 4), zero));
+        acc2 = _mm256_add_pd(acc2, _mm256_min_pd(_mm256_loadu_pd(x + i + 8), zero));
+        acc3 = _mm256_add_pd(acc3, _mm256_min_pd(_mm256_loadu_pd(x + i + 12), zero));
+    }
+    sum = hsum_avx2(_mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3)));
+    return sum + sum_negative_scalar(x + i, n - i);
+}
+
+
+__attribute__((target("avx2,fma")))
+static void below_mask_avx2(const double *x, int n, double tol, unsigned char *mask)
+{
+    int i;
+    unsigned int m0, m1;
+    const __m256d t = _mm256_set1_pd(tol);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        m0 = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(x + i), t, _CMP_LT_OQ));
+        m1 = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(x + i + 4), t, _CMP_LT_OQ));
+        memcpy(mask + i, &mask_bytes[m0], 4);
+        memcpy(mask + i + 4, &mask_bytes[m1], 4);
+    }
+    below_mask_scalar(x + i, n - i, tol, mask + i);
+}
+
+
+__attribute__((target("avx2,fma")))
+static void dd_dots_avx2(const double *dd, const int *idx, const int *old_g, const int *g, int n,
+                         double *dd_dd, double *dd_dg)
+{
+    int k;
+    __m128i vidx, diff;
+    __m256d value, aa = _mm256_setzero_pd(), ag = _mm256_setzero_pd();
+
+    for (k = 0; k + 4 <= n; k += 4) {
+        vidx = _mm_loadu_si128((const __m128i *) (idx + k));
+        value = _mm256_i32gather_pd(dd, vidx, 8);
+        diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (old_g + k)),
+                             _mm_i32gather_epi32(g, vidx, 4));
+        aa = _mm256_fmadd_pd(value, value, aa);
+        ag = _mm256_fmadd_pd(value, _mm256_cvtepi32_pd(diff), ag);
+    }
+    *dd_dd += hsum_avx2(aa);
+    *dd_dg += hsum_avx2(ag);
+    dd_dots_scalar(dd, idx + k, old_g + k, g, n - k, dd_dd, dd_dg);
+}
+#endif /* SCP_FLOAT */
+
+
+static const scp_simd_kernels kernels_avx2 = {
+    "avx2", sum_negative_avx2, below_mask_avx2, dd_dots_avx2
+};
+
+
+/*** AVX-512 ***/
+
+#ifdef SCP_FLOAT
+// widens float lanes 8..15 of v to double
+__attribute__((target("avx512f")))
+static __m512d high_pd_avx512(__m512 v)
+{
+    return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+}
+
+
+__attribute__((target("avx512f")))
+static double sum_negative_avx512(const float *x, int n)
+{
+    int i;
+    const __m512 zero = _mm512_setzero_ps();
+    __m512 v;
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = acc0;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v = _mm512_min_ps(_mm512_loadu_ps(x + i), zero);
+        acc0 = _mm512_add_pd(acc0, _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+        acc1 = _mm512_add_pd(acc1, high_pd_avx512(v));
+    }
+    return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1)) + sum_negative_scalar(x + i, n - i);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void below_mask_avx512(const float *x, int n, double tol, unsigned char *mask)
+{
+    int i;
+    __mmask16 m;
+    const __m512 t = _mm512_set1_ps(float_bound(tol));
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        m = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), t, _CMP_LT_OQ);
+        _mm_storeu_si128((__m128i *) (mask + i), _mm_maskz_set1_epi8(m, 1));
+    }
+    below_mask_scalar(x + i, n - i, tol, mask + i);
+}
+
+
+__attribute__((target("avx512f")))
+static void dd_dots_avx512(const float *dd, const int *idx, const int *old_g, const int *g, int n,
+                           double *dd_dd, double *dd_dg)
+{
+    int k;
+    __m256i vidx, diff;
+    __m512d value, aa = _mm512_setzero_pd(), ag = _mm512_setzero_pd();
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        vidx = _mm256_loadu_si256((const __m256i *) (idx + k));
+        value = _mm512_cvtps_pd(_mm256_i32gather_ps(dd, vidx, 4));
+        diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (old_g + k)),
+                                _mm256_i32gather_epi32(g, vidx, 4));
+        aa = _mm512_fmadd_pd(value, value, aa);
+        ag = _mm512_fmadd_pd(value, _mm512_cvtepi32_pd(diff), ag);
+    }
+    *dd_dd += _mm512_reduce_add_pd(aa);
+    *dd_dg += _mm512_reduce_add_pd(ag);
+    dd_dots_scalar(dd, idx + k, old_g + k, g, n - k, dd_dd, dd_dg);
+}
+
+#else
+__attribute__((target("avx512f")))
+static double sum_negative_avx512(const double *x, int n)
+{
+    int i;
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d acc0 = zero, acc1 = zero;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        acc0 = _mm512_add_pd(acc0, _mm512_min_pd(_mm512_loadu_pd(x + i), zero));
+        acc1 = _mm512_add_pd(acc1, _mm512_min_pd(_mm512_loadu_pd(x + i + 8), zero));
+    }
+    return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1)) + sum_negative_scalar(x + i, n - i);
+}
+
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void below_mask_avx512(const double *x, int n, double tol, unsigned char *mask)
+{
+    int i;
+    __mmask16 m;
+    const __m512d t = _mm512_set1_pd(tol);
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        m = _mm512_cmp_pd_mask(_mm512_loadu_pd(x + i), t, _CMP_LT_OQ)
+            | (_mm512_cmp_pd_mask(_mm512_loadu_pd(x + i + 8), t, _CMP_LT_OQ) << 8);
+        _mm_storeu_si128((__m128i *) (mask + i), _mm_maskz_set1_epi8(m, 1));
+    }
+    below_mask_scalar(x + i, n - i, tol, mask + i);
+}
+
+
+__attribute__((target("avx512f")))
+static void dd_dots_avx512(const double *dd, const int *idx, const int *old_g, const int *g, int n,
+                           double *dd_dd, double *dd_dg)
+{
+    int k;
+    __m256i vidx, diff;
+    __m512d value, aa = _mm512_setzero_pd(), ag = _mm512_setzero_pd();
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        vidx = _mm256_loadu_si256((const __m256i *) (idx + k));
+        value = _mm512_i32gather_pd(vidx, dd, 8);
+        diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (old_g + k)),
+                                _mm256_i32gather_epi32(g, vidx, 4));
+        aa = _mm512_fmadd_pd(value, value, aa);
+        ag = _mm512_fmadd_pd(value, _mm512_cvtepi32_pd(diff), ag);
+    }
+    *dd_dd += _mm512_reduce_add_pd(aa);
+    *dd_dg += _mm512_reduce_add_pd(ag);
+    dd_dots_scalar(dd, idx + k, old_g + k, g, n - k, dd_dd, dd_dg);
+}
+#endif /* SCP_FLOAT */
+
+
+static const scp_simd_kernels kernels_avx512 = {
+    "avx512", sum_negative_avx512, below_mask_avx512, dd_dots_avx512
+};
+
+#endif /* SCP_SIMD_X86 */
+
+
+const scp_simd_kernels *scp_simd = &kernels_scalar;
+
+
+/* Looks up kernel variant by name (scalar, avx2, avx512).
+Returns NULL if unknown or not supported by this CPU. */
+const scp_simd_kernels *scp_simd_find(const char *name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        return &kernels_scalar;
+    }
+#ifdef SCP_SIMD_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0
+        && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return &kernels_avx2;
+    }
+    if (strcmp(name, "avx512") == 0
+        && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vl")) {
+        return &kernels_avx512;
+    }
+#endif
+    return NULL;
+}
+
+
+// selects the kernels before main, so that solver threads only ever read scp_simd
+__attribute__((constructor))
+static void select_simd_kernels(void)
+{
+    const scp_simd_kernels *k;
+    const char *name = getenv("SCP_SIMD");
+
+    if (name != NULL && (k = scp_simd_find(name)) != NULL) {
+        scp_simd = k;
+    } else if ((k = scp_simd_find("avx512")) != NULL || (k = scp_simd_find("avx2")) != NULL) {
+        scp_simd = k;
+    }
+}
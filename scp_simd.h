@@ -0,0 +1,42 @@
+/*** internal header, vectorized kernels of the subgradient iterations
+
+Each kernel has a scalar version and, on x86, AVX2 and AVX-512 versions. The widest
+one supported by the CPU is selected when the library is loaded; set SCP_SIMD to
+scalar, avx2 or avx512 to force a variant. Not part of the public API.
+
+***/
+
+#ifndef Scp_simd_h
+#define Scp_simd_h
+
+// element type of the working vectors of the iterations (reduced costs, dual vectors,
+// momentum, dd), float when built with -DSCP_FLOAT; sums and dot products stay double
+#ifdef SCP_FLOAT
+typedef float scp_real;
+#else
+typedef double scp_real;
+#endif
+
+typedef struct {
+    const char *name;
+
+    /* Returns the sum of negative entries of x[0..n). */
+    double (*sum_negative)(const scp_real *x, int n);
+
+    /* Sets mask[i] = 1 if x[i] < tol, otherwise 0. */
+    void (*below_mask)(const scp_real *x, int n, double tol, unsigned char *mask);
+
+    /* Over the n rows i = idx[k]: adds dd[i]^2 to *dd_dd and dd[i] * (old_g[k] - g[i])
+    to *dd_dg. */
+    void (*dd_dots)(const scp_real *dd, const int *idx, const int *old_g, const int *g, int n,
+                    double *dd_dd, double *dd_dg);
+} scp_simd_kernels;
+
+// kernels selected for this CPU
+extern const scp_simd_kernels *scp_simd;
+
+/* Looks up kernel variant by name (scalar, avx2, avx512).
+Returns NULL if unknown or not supported by this CPU. */
+const scp_simd_kernels *scp_simd_find(const char *name);
+
+#endif /* Scp_simd_h */
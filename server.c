@@ -0,0 +1,508 @@
+/*** bound server, keeps SCP instances loaded and solves them on request
+
+Loaded instances are kept in a list of named entries. A request takes a reference on its
+entry while it runs, so that an unload only unlinks the entry and the last reference
+frees it. Each entry owns one result handle, whose working buffers are reused by all of
+its solves, and a lock held for the whole fix, solve and undo of a request.
+
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+typedef struct server_instance {
+	char *name;
+	scp_instance *inst;
+	scp_result *res;
+	double *dual; 			// warm start and reply buffer, one entry per row
+	int refs; 			// list reference plus running requests
+	pthread_mutex_t solve_lock;
+	struct server_instance *next;
+} server_instance;
+
+typedef struct {
+	const scp_params *params;
+	server_instance *instances;
+	pthread_mutex_t lock; 		// instances, refs, num_conns, stopping
+	pthread_cond_t conn_done;
+	int num_conns;
+	int listen_fd;
+	unsigned char stopping;
+} server_ctx;
+
+typedef struct {
+	server_ctx *ctx;
+	int fd;
+} server_conn;
+
+
+static double elapsed(const struct timespec *begin, const struct timespec *end)
+{
+	return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) * 1e-9;
+}
+
+
+static scp_instance *load_instance(const char *path)
+{
+	size_t len = strlen(path);
+
+	if (len > 5 && strcmp(path + len - 5, ".scpb") == 0) {
+		return load_scp_instance_bin_r(path);
+	}
+	return load_scp_instance_mmap_r(path);
+}
+
+
+static void free_entry(server_instance *si)
+{
+	pthread_mutex_destroy(&si->solve_lock);
+	free_scp_result(si->res);
+	free_scp_instance_r(si->inst);
+	free(si->dual);
+	free(si->name);
+	free(si);
+}
+
+
+// Returns entry of name with a reference taken, or NULL if there is none.
+static server_instance *acquire_entry(server_ctx *ctx, const char *name)
+{
+	server_instance *si;
+
+	pthread_mutex_lock(&ctx->lock);
+	for (si = ctx->instances; si != NULL && strcmp(si->name, name); si = si->next);
+	if (si != NULL) si->refs++;
+	pthread_mutex_unlock(&ctx->lock);
+	return si;
+}
+
+
+static void release_entry(server_ctx *ctx, server_instance *si)
+{
+	int refs;
+
+	pthread_mutex_lock(&ctx->lock);
+	refs = --si->refs;
+	pthread_mutex_unlock(&ctx->lock);
+	if (refs == 0) free_entry(si);
+}
+
+
+static void do_load(server_ctx *ctx, char *args, FILE *out)
+{
+	char *name, *path, *save_ptr;
+	server_instance *si, *p;
+	struct timespec begin_t, end_t;
+
+	name = strtok_r(args, " \t", &save_ptr);
+	path = strtok_r(NULL, " \t", &save_ptr);
+	if (name == NULL || path == NULL) {
+		fprintf(out, "error usage: load NAME PATH\n");
+		return;
+	}
+	if ((si = (server_instance *) calloc(1, sizeof(server_instance))) == NULL
+		|| (si->name = strdup(name)) == NULL) {
+		fprintf(out, "error out of memory\n");
+		free(si);
+		return;
+	}
+
+	// parsing runs outside the lock, so that solves go on meanwhile
+	clock_gettime(CLOCK_MONOTONIC, &begin_t);
+	if ((si->inst = load_instance(path)) == NULL) {
+		fprintf(out, "error cannot load %s\n", path);
+		free(si->name);
+		free(si);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end_t);
+	if ((si->res = create_scp_result(si->inst)) == NULL
+		|| (si->dual = (double *) malloc(get_num_row_r(si->inst) * sizeof(double))) == NULL) {
+		fprintf(out, "error out of memory\n");
+		pthread_mutex_init(&si->solve_lock, NULL);
+		free_entry(si);
+		return;
+	}
+	pthread_mutex_init(&si->solve_lock, NULL);
+	si->refs = 1;
+
+	pthread_mutex_lock(&ctx->lock);
+	for (p = ctx->instances; p != NULL && strcmp(p->name, name); p = p->next);
+	if (p == NULL) {
+		si->next = ctx->instances;
+		ctx->instances = si;
+	}
+	pthread_mutex_unlock(&ctx->lock);
+	if (p != NULL) {
+		fprintf(out, "error %s is loaded already\n", name);
+		free_entry(si);
+		return;
+	}
+	fprintf(out, "ok rows=%d cols=%d load_s=%.6f\n", get_num_row_r(si->inst),
+		get_num_col_r(si->inst), elapsed(&begin_t, &end_t));
+}
+
+
+static void do_unload(server_ctx *ctx, char *args, FILE *out)
+{
+	char *name, *save_ptr;
+	server_instance *si, **p;
+
+	if ((name = strtok_r(args, " \t", &save_ptr)) == NULL) {
+		fprintf(out, "error usage: unload NAME\n");
+		return;
+	}
+	pthread_mutex_lock(&ctx->lock);
+	for (p = &ctx->instances; *p != NULL && strcmp((*p)->name, name); p = &(*p)->next);
+	si = *p;
+	if (si != NULL) *p = si->next;
+	pthread_mutex_unlock(&ctx->lock);
+	if (si == NULL) {
+		fprintf(out, "error no instance %s\n", name);
+		return;
+	}
+	release_entry(ctx, si);
+	fprintf(out, "ok\n");
+}
+
+
+static void do_list(server_ctx *ctx, FILE *out)
+{
+	server_instance *si;
+
+	pthread_mutex_lock(&ctx->lock);
+	fprintf(out, "ok");
+	for (si = ctx->instances; si != NULL; si = si->next) {
+		fprintf(out, " %s", si->name);
+	}
+	fprintf(out, "\n");
+	pthread_mutex_unlock(&ctx->lock);
+}
+
+
+/* Reads n comma-separated numbers of s into x.
+Returns 0 on success, otherwise returns -1. */
+static int parse_doubles(const char *s, double *x, int n)
+{
+	int i;
+	char *end;
+
+	for (i = 0; i < n; i++) {
+		x[i] = strtod(s, &end);
+		if (end == s || *end != (i + 1 < n ? ',' : '\0')) return -1;
+		s = end + 1;
+	}
+	return 0;
+}
+
+
+/* Fixes the columns of a COL:0|1,... list on inst.
+Returns 0 on success, otherwise returns -1 (fixings made so far are kept). */
+static int apply_fixes(scp_instance *inst, const char *s)
+{
+	long col, value;
+	char *end;
+
+	while (*s) {
+		col = strtol(s, &end, 10);
+		if (end == s || *end != ':') return -1;
+		s = end + 1;
+		value = strtol(s, &end, 10);
+		if (end == s || (*end != ',' && *end != '\0') || (value != 0 && value != 1)) return -1;
+		if (fix_scp_column_r(inst, (int) col, value ? SCP_FIX_1 : SCP_FIX_0)) return -1;
+		s = *end ? end + 1 : end;
+	}
+	return 0;
+}
+
+
+static void do_solve(server_ctx *ctx, char *args, FILE *out)
+{
+	int i, num_row, num_fixed;
+	unsigned char basic = 0, warm = 0, duals = 0;
+	char *name, *token, *value, *fixes = NULL, *save_ptr;
+	double bound;
+	server_instance *si;
+	scp_params params = *ctx->params;
+	struct timespec begin_t, end_t;
+
+	if ((name = strtok_r(args, " \t", &save_ptr)) == NULL) {
+		fprintf(out, "error usage: solve NAME [KEY=VALUE ...]\n");
+		return;
+	}
+	if ((si = acquire_entry(ctx, name)) == NULL) {
+		fprintf(out, "error no instance %s\n", name);
+		return;
+	}
+	num_row = get_num_row_r(si->inst);
+
+	pthread_mutex_lock(&si->solve_lock);
+	while ((token = strtok_r(NULL, " \t", &save_ptr)) != NULL) {
+		if ((value = strchr(token, '=')) == NULL) break;
+		*value++ = '\0';
+		if (strcmp(token, "method") == 0 && strcmp(value, "sps") == 0) {
+			basic = 0;
+		} else if (strcmp(token, "method") == 0 && strcmp(value, "bsm") == 0) {
+			basic = 1;
+		} else if (strcmp(token, "itr") == 0) {
+			params.max_itr = atoi(value);
+		} else if (strcmp(token, "ub") == 0) {
+			params.upperbound = atoi(value);
+		} else if (strcmp(token, "threads") == 0) {
+			params.num_threads = atoi(value);
+		} else if (strcmp(token, "time") == 0) {
+			params.term.time_limit = atof(value);
+		} else if (strcmp(token, "target") == 0) {
+			params.term.target_bound = atof(value);
+		} else if (strcmp(token, "halvings") == 0) {
+			params.term.max_halvings = atoi(value);
+		} else if (strcmp(token, "fix") == 0) {
+			fixes = value;
+		} else if (strcmp(token, "dual") == 0) {
+			if (parse_doubles(value, si->dual, num_row)) {
+				fprintf(out, "error dual needs %d comma-separated entries\n", num_row);
+				goto unlock;
+			}
+			warm = 1;
+		} else if (strcmp(token, "duals") == 0) {
+			duals = atoi(value) != 0;
+		} else {
+			break;
+		}
+	}
+	if (token != NULL) {
+		fprintf(out, "error bad key %s\n", token);
+		goto unlock;
+	}
+
+	num_fixed = get_num_fixed_r(si->inst);
+	if (fixes != NULL && apply_fixes(si->inst, fixes)) {
+		undo_scp_fixes_r(si->inst, num_fixed);
+		fprintf(out, "error bad fixing list %s\n", fixes);
+		goto unlock;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &begin_t);
+	if (basic) {
+		bound = basic_subgradient_warm(si->inst, si->res, &params, warm ? si->dual : NULL);
+	} else {
+		bound = spectral_projected_subgradient_warm(si->inst, si->res, &params,
+			warm ? si->dual : NULL, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end_t);
+	undo_scp_fixes_r(si->inst, num_fixed);
+
+	if (bound < 0) {
+		fprintf(out, "error solve failed\n");
+		goto unlock;
+	}
+	fprintf(out, "ok bound=%.17g itr=%d stop=%s solve_s=%.6f", bound, get_num_itr_r(si->res),
+		get_stop_reason_name(get_stop_reason_r(si->res)), elapsed(&begin_t, &end_t));
+	if (get_upper_bound_r(si->res) < HUGE_VAL) {
+		fprintf(out, " upper=%.17g", get_upper_bound_r(si->res));
+	}
+	fprintf(out, "\n");
+	if (duals) {
+		get_dual_vector_r(si->res, si->dual);
+		fprintf(out, "dual");
+		for (i = 0; i < num_row; i++) {
+			fprintf(out, " %.17g", si->dual[i]);
+		}
+		fprintf(out, "\n");
+	}
+
+unlock:
+	pthread_mutex_unlock(&si->solve_lock);
+	release_entry(ctx, si);
+}
+
+
+/* Answers the requests read from in on out until quit, shutdown or the end of in.
+Returns 1 after shutdown, otherwise returns 0. */
+static int serve_client(server_ctx *ctx, FILE *in, FILE *out)
+{
+	int stop = 0;
+	char *line = NULL, *cmd, *args;
+	size_t line_size = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &line_size, in)) != -1) {
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+		cmd = line + strspn(line, " \t");
+		if (*cmd == '\0') continue;
+		args = cmd + strcspn(cmd, " \t");
+		if (*args) *args++ = '\0';
+
+		if (strcmp(cmd, "load") == 0) {
+			do_load(ctx, args, out);
+		} else if (strcmp(cmd, "solve") == 0) {
+			do_solve(ctx, args, out);
+		} else if (strcmp(cmd, "unload") == 0) {
+			do_unload(ctx, args, out);
+		} else if (strcmp(cmd, "list") == 0) {
+			do_list(ctx, out);
+		} else if (strcmp(cmd, "quit") == 0) {
+			break;
+		} else if (strcmp(cmd, "shutdown") == 0) {
+			fprintf(out, "ok\n");
+			stop = 1;
+			break;
+		} else {
+			fprintf(out, "error unknown request %s\n", cmd);
+		}
+		if (fflush(out)) break;
+	}
+	fflush(out);
+	free(line);
+	return stop;
+}
+
+
+static void *conn_main(void *arg)
+{
+	server_conn *conn = (server_conn *) arg;
+	server_ctx *ctx = conn->ctx;
+	int out_fd;
+	FILE *in = NULL, *out = NULL;
+
+	if ((out_fd = dup(conn->fd)) != -1 && (out = fdopen(out_fd, "w")) != NULL
+		&& (in = fdopen(conn->fd, "r")) != NULL) {
+		if (serve_client(ctx, in, out)) {
+			// wakes the accept loop
+			pthread_mutex_lock(&ctx->lock);
+			ctx->stopping = 1;
+			pthread_mutex_unlock(&ctx->lock);
+			shutdown(ctx->listen_fd, SHUT_RDWR);
+		}
+	}
+	if (in != NULL) fclose(in); else close(conn->fd);
+	if (out != NULL) fclose(out); else if (out_fd != -1) close(out_fd);
+	free(conn);
+
+	pthread_mutex_lock(&ctx->lock);
+	ctx->num_conns--;
+	pthread_cond_signal(&ctx->conn_done);
+	pthread_mutex_unlock(&ctx->lock);
+	return NULL;
+}
+
+
+static void accept_loop(server_ctx *ctx)
+{
+	int fd;
+	unsigned char stopping;
+	server_conn *conn;
+	pthread_t thread;
+
+	for (;;) {
+		fd = accept(ctx->listen_fd, NULL, NULL);
+		pthread_mutex_lock(&ctx->lock);
+		stopping = ctx->stopping;
+		pthread_mutex_unlock(&ctx->lock);
+		if (stopping) {
+			if (fd != -1) close(fd);
+			return;
+		}
+		if (fd == -1) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			perror("Error accept");
+			return;
+		}
+		if ((conn = (server_conn *) malloc(sizeof(server_conn))) == NULL) {
+			perror("Error malloc");
+			close(fd);
+			continue;
+		}
+		conn->ctx = ctx;
+		conn->fd = fd;
+		pthread_mutex_lock(&ctx->lock);
+		ctx->num_conns++;
+		pthread_mutex_unlock(&ctx->lock);
+		if (pthread_create(&thread, NULL, conn_main, conn)) {
+			perror("Error pthread_create");
+			pthread_mutex_lock(&ctx->lock);
+			ctx->num_conns--;
+			pthread_mutex_unlock(&ctx->lock);
+			close(fd);
+			free(conn);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+}
+
+
+/* Serves requests on the Unix socket at path (created, and removed on exit), or on
+stdin/stdout if path is "-". params are the settings of all solves, which the keys of a
+solve request override for that solve.
+Returns 0 after shutdown (or the end of stdin), otherwise returns -1. */
+int run_server(const char *path, const scp_params *params)
+{
+	int ret = 0;
+	struct sockaddr_un addr;
+	server_instance *si;
+	server_ctx ctx;
+
+	memset(&ctx, 0, sizeof(server_ctx));
+	ctx.params = params;
+	ctx.listen_fd = -1;
+	pthread_mutex_init(&ctx.lock, NULL);
+	pthread_cond_init(&ctx.conn_done, NULL);
+
+	// a client that goes away mid-reply must not end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	if (strcmp(path, "-") == 0) {
+		serve_client(&ctx, stdin, stdout);
+	} else {
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(addr.sun_path)) {
+			fprintf(stderr, "Error: socket path %s is too long\n", path);
+			ret = -1;
+			goto cleanup;
+		}
+		strcpy(addr.sun_path, path);
+		if ((ctx.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+			perror("Error socket");
+			ret = -1;
+			goto cleanup;
+		}
+		unlink(path);
+		if (bind(ctx.listen_fd, (struct sockaddr *) &addr, sizeof(addr))
+			|| listen(ctx.listen_fd, 64)) {
+			perror(path);
+			ret = -1;
+			goto cleanup;
+		}
+		fprintf(stderr, "Listening on %s\n", path);
+		accept_loop(&ctx);
+
+		pthread_mutex_lock(&ctx.lock);
+		while (ctx.num_conns > 0) {
+			pthread_cond_wait(&ctx.conn_done, &ctx.lock);
+		}
+		pthread_mutex_unlock(&ctx.lock);
+		unlink(path);
+	}
+
+cleanup:
+	if (ctx.listen_fd != -1) close(ctx.listen_fd);
+	while ((si = ctx.instances) != NULL) {
+		ctx.instances = si->next;
+		free_entry(si);
+	}
+	pthread_mutex_destroy(&ctx.lock);
+	pthread_cond_destroy(&ctx.conn_done);
+	return ret;
+}
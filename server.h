@@ -0,0 +1,43 @@
+/*** bound server, keeps SCP instances loaded and solves them on request
+
+Requests and replies are text lines. The server listens on a Unix stream socket, or
+serves a single client on stdin/stdout (a pipe) if the socket path is "-". Each client
+connection gets its own thread, so solves on different instances run concurrently, while
+solves on one instance are serialized (column fixings apply to the instance itself).
+
+    load NAME PATH              loads PATH (.scpb files are mapped) as instance NAME
+                                -> ok rows=R cols=C load_s=T
+    solve NAME [KEY=VALUE ...]  solves NAME with the keys
+        method=sps|bsm          solver, sps by default
+        itr=N ub=N threads=N    max_itr, upperbound and num_threads of this solve
+        time=S target=B halvings=N
+                                termination of this solve
+        fix=COL:0|1,...         fixings of this solve, undone after it
+        dual=Y0,Y1,...          warm start, one entry per row
+        duals=1                 also reply with the best dual vector
+                                -> ok bound=B itr=N stop=REASON solve_s=T [upper=U]
+                                -> dual Y0 Y1 ...
+    unload NAME                 frees NAME once its running solve ends
+                                -> ok
+    list                        -> ok NAME ...
+    quit                        closes the connection
+    shutdown                    stops accepting connections, the server exits once the
+                                open ones are closed
+
+Failed requests reply "error MESSAGE". Numbers of replies are printed with %.17g, so the
+bound and the duals read back exactly.
+
+***/
+
+#ifndef Server_h
+#define Server_h
+
+#include "subgradient.h"
+
+/* Serves requests on the Unix socket at path (created, and removed on exit), or on
+stdin/stdout if path is "-". params are the settings of all solves, which the keys of a
+solve request override for that solve.
+Returns 0 after shutdown (or the end of stdin), otherwise returns -1. */
+int run_server(const char *path, const scp_params *params);
+
+#endif /* Server_h */
@@ -15,361 +15,1223 @@ Naval Research Logistics, 37(1), 151–164."
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <math.h>
-#include "subgradient.h"
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "scp_internal.h"
+#include "scp_simd.h"
+
+
+#define SIMD_BLOCK  4096    // rows/columns per simd kernel call in parallel loops
+
+// rows/columns per partial sum of the deterministic mode, fixed for any number of threads
+#define DET_BLOCK   4096
+#define DET_BLOCKS(n)   (((n) + DET_BLOCK - 1) / DET_BLOCK)
+
+// bytes of n elements of type in the workspace block, rounded up to whole cache lines
+#define WS_BYTES(n, type)   (((size_t) ((n) > 0 ? (n) : 1) * sizeof(type) + SCP_WS_ALIGN - 1) \
+                             / SCP_WS_ALIGN * SCP_WS_ALIGN)
+
+// tracking the objective and the subgradient while shifting reduced costs pays off when
+// the moved rows touch few columns, otherwise sequential rescans are cheaper
+#define USE_INCREMENTAL(touched, num_col)   (2 * (long long) (touched) < (num_col))
+
+// SPS iterations between recomputations of the float reduced costs from the dual vector
+#define FLOAT_REFRESH   64
+
+// phase timers of a solve, a predictable branch when params->phase_timers is off; they add
+// to phase_time and, if perf is open, to the counters of the solve in scope
+#define PHASE_MARK(on, mark)            if (on) { (mark) = wall_seconds(); \
+                                                  if (perf != NULL) scp_perf_mark(perf); }
+#define PHASE_ADD(on, mark, phase)      if (on) { double t_ = wall_seconds(); \
+                                                  phase_time[phase] += t_ - (mark); (mark) = t_; \
+                                                  if (perf != NULL) scp_perf_add(perf, phase); }
+
+// per-column flags of lagr_state
+#define COL_BELOW   1   // reduced cost < SUBG_TOL, as accounted for in subg
+#define COL_QUEUED  2   // column is in the queue
+
+
+/* Reduced costs of the current dual vector, with the sum of negative reduced costs
+and the subgradient vector maintained alongside. */
+typedef struct {
+    scp_real *reduced_costs;
+    double neg_rc_sum;          // sum of negative reduced costs
+    int *subg;                  // subg[i] = 1 - #{col j in row i : reduced_costs[j] < SUBG_TOL}
+    int subg_nonzero;           // number of nonzero entries of subg
+    unsigned char *col_state;   // COL_BELOW | COL_QUEUED
+    int *queue;                 // columns whose reduced cost may have crossed SUBG_TOL
+    int queue_size;
+    int num_threads;            // > 1: conflict-free parallel kernels on non-incremental updates
+    scp_real *step;             // dense per-row shift of the parallel reduced cost gather
+    unsigned char deterministic; // sums in fixed blocks (det_sum), see scp_params
+    double *partial;            // block sums of the deterministic mode
+    const int *row_covered;     // rows covered by columns fixed to 1 if > 0, NULL if none
+    double fixed_cost;          // cost of the columns fixed to 1, part of the obj value
+} lagr_state;
+
+
+/* Loops over entries [begin, end) of the index array a, setting idx to each. */
+#define EACH_INDEX(a, begin, end, j, idx)   for (j = (begin); j < (end) && ((idx) = (a)[j], 1); j++)
+
+/* Inner loops over one index list of a, generated for each index width of the compact
+layout (int: _i32, uint16_t: _u16) and called through ROW_CALL and COL_CALL. */
+#define DEFINE_INDEX_KERNELS(suffix, index_t)                                                \
+/* Returns value minus the sum of x over a. */                                               \
+static inline double gather_##suffix(const index_t *a, int begin, int end,                  \
+                                     const scp_real *x, double value)                       \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        value -= x[idx];                                                                     \
+    }                                                                                        \
+    return value;                                                                            \
+}                                                                                            \
+                                                                                             \
+/* Returns value minus the sum of the double vector x over a. */                             \
+static inline double gather_exact_##suffix(const index_t *a, int begin, int end,            \
+                                           const double *x, double value)                   \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        value -= x[idx];                                                                     \
+    }                                                                                        \
+    return value;                                                                            \
+}                                                                                            \
+                                                                                             \
+/* Returns the sum of state over a. */                                                       \
+static inline int count_##suffix(const index_t *a, int begin, int end,                       \
+                                 const unsigned char *state)                                 \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0, n = 0;                                                                      \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        n += state[idx];                                                                     \
+    }                                                                                        \
+    return n;                                                                                \
+}                                                                                            \
+                                                                                             \
+/* Subtracts value from x over a. */                                                         \
+static inline void scatter_##suffix(const index_t *a, int begin, int end, scp_real *x,       \
+                                    double value)                                            \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        x[idx] -= value;                                                                     \
+    }                                                                                        \
+}                                                                                            \
+                                                                                             \
+/* Decrements x over a. */                                                                   \
+static inline void decrement_##suffix(const index_t *a, int begin, int end, int *x)         \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        x[idx]--;                                                                            \
+    }                                                                                        \
+}                                                                                            \
+                                                                                             \
+/* Subtracts value from the reduced costs of the columns in a, queues the ones whose state \
+disagrees with the new reduced cost. Returns delta plus the change of the negative sum. */   \
+static inline double scatter_queue_##suffix(const index_t *a, int begin, int end,            \
+                                            double value, lagr_state *ls, double delta)      \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    scp_real old_rc, new_rc;                                                                 \
+    scp_real *reduced_costs = ls->reduced_costs;                                             \
+    unsigned char *col_state = ls->col_state;                                                \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        old_rc = reduced_costs[idx];                                                         \
+        new_rc = old_rc - value;                                                             \
+        reduced_costs[idx] = new_rc;                                                         \
+        delta += (new_rc < 0 ? new_rc : 0.0) - (old_rc < 0 ? old_rc : 0.0);                  \
+        if (col_state[idx] == (new_rc < SUBG_TOL ? 0 : COL_BELOW)) {                         \
+            col_state[idx] |= COL_QUEUED;                                                    \
+            ls->queue[ls->queue_size++] = idx;                                               \
+        }                                                                                    \
+    }                                                                                        \
+    return delta;                                                                            \
+}                                                                                            \
+                                                                                             \
+/* Adds step to the subgradient of the rows in a, except covered ones.                       \
+Returns nonzero adjusted by the entries that became or stopped being zero. */               \
+static inline int shift_subg_##suffix(const index_t *a, int begin, int end, int step,        \
+                                      int *subg, const int *row_covered, int nonzero)        \
+{                                                                                            \
+    int j;                                                                                   \
+    int i = 0, old_g;                                                                        \
+    EACH_INDEX(a, begin, end, j, i) {                                                        \
+        if (row_covered != NULL && row_covered[i]) {                                         \
+            continue; /* removed row, subgradient stays 0 */                                 \
+        }                                                                                    \
+        old_g = subg[i];                                                                     \
+        subg[i] = old_g + step;                                                              \
+        nonzero += (old_g == 0) - (old_g + step == 0);                                       \
+    }                                                                                        \
+    return nonzero;                                                                          \
+}                                                                                            \
+                                                                                             \
+/* Adds value to the slope of the columns in a, appending the ones first seen to cols.       \
+Returns the new number of columns in cols. */                                                \
+static inline int add_slope_##suffix(const index_t *a, int begin, int end, double value,     \
+                                     scp_line_search *lsb, int n)                            \
+{                                                                                            \
+    int j;                                                                                   \
+    int idx = 0;                                                                             \
+    EACH_INDEX(a, begin, end, j, idx) {                                                      \
+        lsb->slope[idx] += value;                                                            \
+        if (!lsb->seen[idx]) {                                                               \
+            lsb->seen[idx] = 1;                                                              \
+            lsb->cols[n++] = idx;                                                            \
+        }                                                                                    \
+    }                                                                                        \
+    return n;                                                                                \
+}
 
+DEFINE_INDEX_KERNELS(i32, int)
+DEFINE_INDEX_KERNELS(u16, uint16_t)
 
-#define FILE_FORMAT_ERR    fprintf(stderr, "Error: wrong SCP file format\n")
-    
-#define GETLINE(buf, buf_size, fp)  if (getline(&buf, &buf_size, fp) == -1) \
-                                        { FILE_FORMAT_ERR; return -1; }
 
-#define STR_TOKEN(token, s, delim)  if ((token = strtok(s, delim)) == NULL) \
-                                        { FILE_FORMAT_ERR; return -1; }
 
-#define MALLOC(var, type, size)     if ((var = (type) malloc(size)) == NULL) \
-                                        { perror("Error malloc"); return -1; }
+// process-wide instance and result behind the non-reentrant API
+static scp_instance *global_inst;
+static scp_result *global_res;
+static scp_instance *global_parent;  // instance global_inst was presolved from
 
-#define ZERO_TOL    pow(10, -12)
 
+/* Makes sure lsb holds breakpoint line search buffers for inst.
+Returns 0 on success, otherwise returns -1. */
+static int reserve_line_search(scp_line_search *lsb, const scp_instance *inst);
 
-static int num_col, num_row, num_nonzero;
-static int *costs;           // cost vector
-static int *col_wise_a;      // column-wise constraint matrix
-static int *col_wise_idx;    // start index of each column in colwise_a 
-static int *row_wise_a;      // row-wise constraint matrix
-static int *row_wise_idx;    // start index of each row in rowwise_a 
-static int *col_sizes;
-static int *row_sizes;
-static double *best_dual_copy;
+static void free_line_search(scp_line_search *lsb);
 
+/* Makes sure ws holds buffers for inst and a line search memory of M objective values,
+keeping the current ones if they fit.
+Returns 0 on success, otherwise returns -1. */
+static int reserve_workspace(scp_workspace *ws, const scp_instance *inst, int M);
+
+// Sets up Lagrangian state for inst on the buffers of ws with the threads of params.
+static void init_lagr_state(const scp_instance *inst, lagr_state *ls, scp_workspace *ws,
+                            const scp_params *params);
+
+/* Sums of the deterministic mode: entries are added in index order within blocks of
+DET_BLOCK, and the block sums in block order, so that the result only depends on the
+input, not on the number of threads or their schedule.
+Returns the sum of x[0 .. n-1] (det_sum), or of its negative entries (det_sum_negative). */
+static double det_sum(const scp_real *x, int n, const lagr_state *ls);
+static double det_sum_negative(const scp_real *x, int n, const lagr_state *ls);
+
+/* Deterministic sums over the rows i = idx[k] of an ascending list, all rows in order
+with several threads: of dd[i] * y[i] into *s0 if y != NULL, otherwise of dd[i]^2 into *s0
+and dd[i] * (old_g[k] - g[i]) into *s1. Rows missing from the list add 0, so the sums of
+a list of the moved rows equal those of the dense dd of the parallel iterations. */
+static void det_dd_sums(const scp_real *dd, const int *idx, int n, const scp_real *y,
+                        const int *old_g, const int *g, const lagr_state *ls,
+                        double *s0, double *s1);
 
 /* Initializes dual vector and computes its reduced cost and obj value.
 Returns the initial obj value. */
-static double init_dual_vector(double *dual, double *reduced_costs);
+static double init_dual_vector(const scp_instance *inst, scp_real *dual, lagr_state *ls);
+
+/* Copies init_dual (negative entries raised to 0) to dual and computes its reduced cost
+and obj value.
+Returns the initial obj value. */
+static double copy_dual_vector(const scp_instance *inst, const double *init_dual, scp_real *dual,
+                               lagr_state *ls);
+
+/* Computes reduced costs of dual and the sum of their negative entries in one pass over
+col_wise_a, where dual_sum is the sum of dual entries.
+Returns obj value of dual. */
+static double init_reduced_costs(const scp_instance *inst, const scp_real *dual,
+                                 double dual_sum, lagr_state *ls);
+
+/* Subtracts scale * dd[i] from reduced costs of the columns in each row i of dd_idx
+and keeps the sum of negative reduced costs up to date. */
+static void shift_reduced_costs(const scp_instance *inst, lagr_state *ls,
+                                const scp_real *dd, const int *dd_idx, int dd_size, double scale,
+                                unsigned char incremental);
+
+/* Brings subgradient vector up to date with the reduced costs. */
+static void update_subg_vector(const scp_instance *inst, lagr_state *ls, unsigned char incremental);
 
 /* Computes subgradient vector (sps)
 Returns -1 if current solution is optimal (i.e., subgradient vector becomes zero vector).
 Returns 0 otherwise. */
-static int compute_subg_vector_sps(int *subg, double *reduced_costs);
+static int compute_subg_vector_sps(const scp_instance *inst, lagr_state *ls,
+                                   unsigned char incremental);
 
 /* Computes subgradient vector (basic) 
 Returns square norm of subgradient vector.
 Returns -1 if current solution is optimal (i.e., subgradient vector becomes zero vector). */
-static long long compute_subg_vector_basic(int *subg, double *reduced_costs, double *dual);
+static long long compute_subg_vector_basic(const scp_instance *inst, lagr_state *ls,
+                                           scp_real *dual, unsigned char incremental);
 
+// Returns monotonic wall clock in seconds.
+static double wall_seconds();
+
+/* Runs the Lagrangian heuristic on the reduced costs of ls and keeps its cover cost in res
+if it improves. Returns the cost of the new cover. */
+static double run_heuristic(const scp_instance *inst, const lagr_state *ls, scp_result *res);
+
+/* Finds the largest tau = 2^-k, k = 1..max_k (unbounded if max_k <= 0), at which the obj
+value along the direction dd passes the accept test obj(tau) >= accept0 + tau * accept_slope,
+where obj and the reduced costs of ls are those of the full step (tau = 1). The obj value is
+piecewise linear in tau with a kink wherever a touched column's reduced cost changes sign,
+so one sweep over the sorted kinks evaluates every candidate tau.
+Returns 1 if the test passed at *tau, 0 if max_k halvings were not enough. */
+static int breakpoint_line_search(const scp_instance *inst, const lagr_state *ls,
+                                  scp_line_search *lsb, const scp_real *dd, const int *dd_idx,
+                                  int dd_size, double obj, double accept0, double accept_slope,
+                                  int max_k, double *tau);
+
+
+
+/* Returns the number of threads to use for requested num_threads (0 = all available). */
+int resolve_num_threads(int num_threads)
+{
+#ifdef _OPENMP
+    if (num_threads <= 0) {
+        num_threads = omp_get_max_threads();
+    }
+    return num_threads;
+#else
+    return 1; // built without OpenMP
+#endif
+}
 
 
-/* Reads SCP instance file and creates cost vector and constraint matrix.
+/* Makes sure ws holds buffers for inst and a line search memory of M objective values,
+keeping the current ones if they fit.
 Returns 0 on success, otherwise returns -1. */
-int load_scp_instance(char *filename)
+static int reserve_workspace(scp_workspace *ws, const scp_instance *inst, int M)
 {
-    int i, j, k;
-    FILE *fp;
-    char *buf = NULL;
-    size_t buf_size = 0;
-    char *token;
+    int ret;
+    char *p;
+    size_t size;
+    const int num_row = inst->num_row;
+    const int num_col = inst->num_col;
+
+    ws->rc_inst = NULL;
+    if (ws->block != NULL && ws->num_row == num_row && ws->num_col >= num_col
+        && ws->memory >= M) {
+        return 0;
+    }
 
-    if ((fp = fopen(filename, "r")) == NULL) { 
-        perror("Error opening file"); return -1; 
+    free(ws->block);
+    ws->block = NULL;
+    size = WS_BYTES(num_col, scp_real) + 5 * WS_BYTES(num_row, scp_real) + WS_BYTES(M, double)
+           + 3 * WS_BYTES(num_row, int) + WS_BYTES(num_col, int)
+           + WS_BYTES(num_col, unsigned char) + WS_BYTES(2 * DET_BLOCKS(num_row + num_col), double);
+    if ((ret = posix_memalign(&ws->block, SCP_WS_ALIGN, size)) != 0) {
+        ws->block = NULL;
+        errno = ret;
+        perror("Error malloc");
+        return -1;
     }
+    ws->num_row = num_row;
+    ws->num_col = num_col;
+    ws->memory = M;
+
+    p = (char *) ws->block;
+    ws->reduced_costs = (scp_real *) p; p += WS_BYTES(num_col, scp_real);
+    ws->step = (scp_real *) p;          p += WS_BYTES(num_row, scp_real);
+    ws->dual1 = (scp_real *) p;         p += WS_BYTES(num_row, scp_real);
+    ws->dual2 = (scp_real *) p;         p += WS_BYTES(num_row, scp_real);
+    ws->momentum = (scp_real *) p;      p += WS_BYTES(num_row, scp_real);
+    ws->dd = (scp_real *) p;            p += WS_BYTES(num_row, scp_real);
+    ws->past_objs = (double *) p;       p += WS_BYTES(M, double);
+    ws->subg = (int *) p;               p += WS_BYTES(num_row, int);
+    ws->dd_idx = (int *) p;             p += WS_BYTES(num_row, int);
+    ws->dd_subg = (int *) p;            p += WS_BYTES(num_row, int);
+    ws->queue = (int *) p;              p += WS_BYTES(num_col, int);
+    ws->col_state = (unsigned char *) p; p += WS_BYTES(num_col, unsigned char);
+    ws->partial = (double *) p;
+    return 0;
+}
 
-    // read first line: the number of row and the number of col
-    GETLINE(buf, buf_size, fp)
-    STR_TOKEN(token, buf, " ")
-    num_row = atoi(token);
-    STR_TOKEN(token, NULL, " ")
-    num_col = atoi(token);
 
-    if ((costs = (int *) malloc(num_col * sizeof(int))) == NULL) { 
-        perror("Error malloc"); return -1;
-    }
+// Sets up Lagrangian state for inst on the buffers of ws with the threads of params.
+static void init_lagr_state(const scp_instance *inst, lagr_state *ls, scp_workspace *ws,
+                            const scp_params *params)
+{
+    memset(ls, 0, sizeof(lagr_state));
+    ls->num_threads = resolve_num_threads(params->num_threads);
+    ls->deterministic = params->deterministic != 0;
+    ls->partial = ws->partial;
+    ls->row_covered = inst->num_covered > 0 ? inst->row_covered : NULL;
+    ls->fixed_cost = inst->fixed_cost;
+    ls->reduced_costs = ws->reduced_costs;
+    ls->subg = ws->subg;
+    ls->col_state = ws->col_state;
+    ls->queue = ws->queue;
+    ls->step = ls->num_threads > 1 ? ws->step : NULL;
+}
 
-    // read cost vector
-    for (i = 0, token = NULL; i < num_col; token = strtok(NULL, " ")) {
-        if (token == NULL) {
-            GETLINE(buf, buf_size, fp)
-            STR_TOKEN(token, buf, " ")
-        }
 
-        if (*token != '\n') {
-            costs[i++] = atoi(token);
+static double det_sum(const scp_real *x, int n, const lagr_state *ls)
+{
+    int b, i, end;
+    double part, sum = 0.0;
+    double *partial = ls->partial;
+    const int nb = DET_BLOCKS(n);
+
+    #pragma omp parallel for if (ls->num_threads > 1) num_threads(ls->num_threads) \
+        private(i, end, part)
+    for (b = 0; b < nb; b++) {
+        end = (b + 1) * DET_BLOCK < n ? (b + 1) * DET_BLOCK : n;
+        part = 0.0;
+        for (i = b * DET_BLOCK; i < end; i++) {
+            part += x[i];
         }
+        partial[b] = part;
+    }
+    for (b = 0; b < nb; b++) {
+        sum += partial[b];
     }
+    return sum;
+}
 
-    // temporary constraint matrix
-    int **cols, **rows;
-    MALLOC(cols, int **, num_col * sizeof(int *))
-    MALLOC(rows, int **, num_row * sizeof(int *))
-    for (i = 0; i < num_col; i++) {
-        MALLOC(cols[i], int *, num_row * sizeof(int))
+
+static double det_sum_negative(const scp_real *x, int n, const lagr_state *ls)
+{
+    int b, len;
+    double sum = 0.0;
+    double *partial = ls->partial;
+    const int nb = DET_BLOCKS(n);
+
+    #pragma omp parallel for if (ls->num_threads > 1) num_threads(ls->num_threads) private(len)
+    for (b = 0; b < nb; b++) {
+        len = n - b * DET_BLOCK < DET_BLOCK ? n - b * DET_BLOCK : DET_BLOCK;
+        partial[b] = scp_simd->sum_negative(x + b * DET_BLOCK, len);
     }
-    for (i = 0; i < num_row; i++) {
-        MALLOC(rows[i], int *, num_col * sizeof(int))
+    for (b = 0; b < nb; b++) {
+        sum += partial[b];
     }
+    return sum;
+}
 
-    MALLOC(col_sizes, int *, num_col * sizeof(int))
-    memset(col_sizes, 0, num_col * sizeof(int));
-    MALLOC(row_sizes, int *, num_row * sizeof(int))
-    memset(row_sizes, 0, num_row * sizeof(int));
-
-    // read rows (constraints)
-    int col_idx;
-    num_nonzero = 0;
 
-    for (i = 0; i < num_row; i++) {
-        GETLINE(buf, buf_size, fp)
-        STR_TOKEN(token, buf, " ")
-        row_sizes[i] = atoi(token);
-        num_nonzero += row_sizes[i];
-
-        for (j = 0, token = NULL; j < row_sizes[i]; token = strtok(NULL, " ")) {
-            if (token == NULL) {
-                GETLINE(buf, buf_size, fp)
-                STR_TOKEN(token, buf, " ")
-            }
+// adds the terms of row i (list entry k) of det_dd_sums to p0 and p1
+#define DD_TERMS(i, k)  if (y != NULL) {                                                    \
+                            p0 += dd[i] * y[i];                                              \
+                        } else {                                                             \
+                            value = dd[i];                                                   \
+                            p0 += value * value;                                             \
+                            p1 += value * (old_g[k] - g[i]);                                 \
+                        }
 
-            if (*token != '\n') {
-                if ((col_idx = atoi(token) - 1) < 0) {
-                    FILE_FORMAT_ERR; return -1;
-                }
-                cols[col_idx][col_sizes[col_idx]] = i;
-                col_sizes[col_idx]++;
-                rows[i][j++] = col_idx;
+static void det_dd_sums(const scp_real *dd, const int *idx, int n, const scp_real *y,
+                        const int *old_g, const int *g, const lagr_state *ls,
+                        double *s0, double *s1)
+{
+    int b, k, end, block;
+    double p0, p1, value;
+    double *partial = ls->partial;
+    const int nb = DET_BLOCKS(n);
+
+    *s0 = *s1 = 0.0;
+    if (ls->num_threads > 1) {
+        // the parallel iterations keep dd dense, idx is the identity
+        #pragma omp parallel for num_threads(ls->num_threads) private(k, end, p0, p1, value)
+        for (b = 0; b < nb; b++) {
+            end = (b + 1) * DET_BLOCK < n ? (b + 1) * DET_BLOCK : n;
+            p0 = p1 = 0.0;
+            for (k = b * DET_BLOCK; k < end; k++) {
+                DD_TERMS(k, k)
             }
+            partial[2*b] = p0;
+            partial[2*b+1] = p1;
         }
-    }
-
-    // create col-wise constraint matrix
-    MALLOC(col_wise_a, int *, num_nonzero * sizeof(int))
-    MALLOC(col_wise_idx, int *, (num_col+1) * sizeof(int))
-    k = 0;
-    for (i = 0; i < num_col; i++) {
-        col_wise_idx[i] = k; // start index of i-th column
-        for (j = 0; j < col_sizes[i]; j++) {
-            col_wise_a[k++] = cols[i][j];
+        for (b = 0; b < nb; b++) {
+            *s0 += partial[2*b];
+            *s1 += partial[2*b+1];
         }
+        return;
     }
-    col_wise_idx[num_col] = k;
 
-    // create row-wise constraint matrix
-    MALLOC(row_wise_a, int *, num_nonzero * sizeof(int))
-    MALLOC(row_wise_idx, int *, (num_row+1) * sizeof(int))
-    k = 0;
-    for (i = 0; i < num_row; i++) {
-        row_wise_idx[i] = k; // start index of i-th row
-        for (j = 0; j < row_sizes[i]; j++) {
-            row_wise_a[k++] = rows[i][j];
+    // blocks of the rows in the list, empty ones add nothing
+    p0 = p1 = 0.0;
+    block = -1;
+    for (k = 0; k < n; k++) {
+        if (idx[k] / DET_BLOCK != block) {
+            *s0 += p0;
+            *s1 += p1;
+            p0 = p1 = 0.0;
+            block = idx[k] / DET_BLOCK;
         }
+        DD_TERMS(idx[k], k)
     }
-    row_wise_idx[num_row] = k;
-
-    MALLOC(best_dual_copy, double *, num_row * sizeof(double))
-
-    // free temporary constraint matrix
-    for (i = 0; i < num_col; i++) {
-        free(cols[i]);
-    }
-    for (i = 0; i < num_row; i++) {
-        free(rows[i]);
-    }
-    free(cols);
-    free(rows);
-
-    return 0;
+    *s0 += p0;
+    *s1 += p1;
 }
 
 
 /* Initializes dual vector and computes its reduced cost and obj value.
 Returns the initial obj value. */
-static double init_dual_vector(double *dual, double *reduced_costs)
+static double init_dual_vector(const scp_instance *inst, scp_real *dual, lagr_state *ls)
 {
     int i, j, idx;
     double min_value, value, obj_value;
+    const int num_row = inst->num_row;
+    const int *costs = inst->costs;
+    const int *col_wise_idx = inst->col_wise_idx;
+    const int *row_wise_idx = inst->row_wise_idx;
+    const int *row_covered = ls->row_covered;
 
     obj_value = 0;
 
     // init dual_j = min (cost_i / size_i) for each col i in row j
+    #pragma omp parallel for if (ls->num_threads > 1) num_threads(ls->num_threads) \
+        private(j, idx, min_value, value) reduction(+:obj_value)
     for (i = 0; i < num_row; i++) {
-        min_value = costs[row_wise_a[row_wise_idx[i]]];
+        min_value = costs[ROW_AT(inst, row_wise_idx[i])];
         for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
-            idx = row_wise_a[j];
-            value = (double) costs[idx] / col_sizes[idx];
+            idx = ROW_AT(inst, j);
+            value = (double) costs[idx] / (col_wise_idx[idx+1] - col_wise_idx[idx]);
             if (value < min_value) {
                 min_value = value;
             }
         }
+        if (row_covered != NULL && row_covered[i]) {
+            min_value = 0.0;
+        }
         dual[i] = min_value;
-        obj_value += min_value;
+        obj_value += dual[i];
     }
+    if (ls->deterministic) obj_value = det_sum(dual, num_row, ls);
+
+    return init_reduced_costs(inst, dual, obj_value, ls);
+}
+
+
+/* Copies init_dual (negative entries raised to 0) to dual and computes its reduced cost
+and obj value. Rows covered by fixed columns get 0. init_dual of a presolved instance is
+indexed by original rows.
+Returns the initial obj value. */
+static double copy_dual_vector(const scp_instance *inst, const double *init_dual, scp_real *dual,
+                               lagr_state *ls)
+{
+    int i;
+    double obj_value = 0;
+    const int num_row = inst->num_row;
+    const int *row_covered = ls->row_covered;
+    const int *row_map = inst->row_map;
+
+    for (i = 0; i < num_row; i++) {
+        dual[i] = init_dual[row_map ? row_map[i] : i];
+        dual[i] = dual[i] > 0 ? dual[i] : 0.0;
+        if (row_covered != NULL && row_covered[i]) {
+            dual[i] = 0.0;
+        }
+        obj_value += dual[i];
+    }
+    if (ls->deterministic) obj_value = det_sum(dual, num_row, ls);
+
+    return init_reduced_costs(inst, dual, obj_value, ls);
+}
+
+
+/* Computes reduced costs of dual and the sum of their negative entries in one pass over
+col_wise_a, where dual_sum is the sum of dual entries.
+Returns obj value of dual. */
+static double init_reduced_costs(const scp_instance *inst, const scp_real *dual,
+                                 double dual_sum, lagr_state *ls)
+{
+    int i;
+    double value, neg_sum;
+    scp_real *reduced_costs = ls->reduced_costs;
+    const int num_col = inst->num_col;
+    const int *costs = inst->costs;
 
     // compute reduced cost
+    neg_sum = 0.0;
+    #pragma omp parallel for if (ls->num_threads > 1) num_threads(ls->num_threads) \
+        private(value) reduction(+:neg_sum)
     for (i = 0; i < num_col; i++) {
-        value = costs[i];
-        for (j = col_wise_idx[i]; j < col_wise_idx[i+1]; j++) {
-            idx = col_wise_a[j];
-            value -= dual[idx];
-        }
+        value = COL_CALL(gather, inst, i, dual, costs[i]);
         reduced_costs[i] = value;
+        if (value < 0) {
+            neg_sum += value;
+        }
     }
+    if (ls->deterministic) neg_sum = det_sum_negative(reduced_costs, num_col, ls);
 
-    return obj_value;
+    ls->neg_rc_sum = neg_sum;
+    return dual_sum + neg_sum + ls->fixed_cost;
 }
 
 
-/* Computes subgradient vector (sps)
-Returns -1 if current solution is optimal (i.e., subgradient vector becomes zero vector).
-Returns 0 otherwise. */
-static int compute_subg_vector_sps(int *subg, double *reduced_costs)
+int restore_sps_state(const scp_sps_state *state, int num_row, int M, const int *row_covered,
+                      scp_real *momentum, double *alpha, double *past_objs)
 {
-    int i, j;
+    int i;
 
+    if (state == NULL || !state->valid || state->num_row != num_row || state->memory != M) {
+        return 0;
+    }
     for (i = 0; i < num_row; i++) {
-        subg[i] = 1;
+        momentum[i] = state->momentum[i];
+        if (row_covered != NULL && row_covered[i]) {
+            momentum[i] = 0.0; // keeps the dual of covered rows at 0
+        }
     }
-    for (i = 0; i < num_col; i++) {
-        if (reduced_costs[i] < pow(10,-14)) {
-            for (j = col_wise_idx[i]; j < col_wise_idx[i+1]; j++) {
-                subg[col_wise_a[j]]--;
+    memcpy(past_objs, state->past_objs, M * sizeof(double));
+    *alpha = state->alpha;
+    return 1;
+}
+
+
+void save_sps_state(scp_sps_state *state, int num_row, int M, const scp_real *momentum,
+                    double alpha, const double *past_objs, int newest)
+{
+    int i, k;
+
+    if (state == NULL || state->num_row != num_row || state->memory != M) {
+        return;
+    }
+    for (i = 0; i < num_row; i++) {
+        state->momentum[i] = momentum[i];
+    }
+    for (k = 0; k < M; k++) {
+        state->past_objs[k] = past_objs[(newest + k) % M];
+    }
+    state->alpha = alpha;
+    state->valid = 1;
+}
+
+
+/* Subtracts scale * dd[i] from reduced costs of the columns in each row i of dd_idx,
+skipping rows whose shift is within ZERO_TOL, and keeps the sum of negative reduced costs
+up to date. If incremental, only the shifted columns are visited and the ones that may
+leave or enter the Lagrangian solution are queued for update_subg_vector. Otherwise the
+reduced costs are rescanned, or with several threads, the shift is gathered column by
+column over col_wise_a, so that each reduced cost is written by one thread only. The
+deterministic mode takes the sum of negative reduced costs with det_sum_negative, and with
+float working vectors always scatters, as the gather rounds once per column instead of once
+per row. */
+static void shift_reduced_costs(const scp_instance *inst, lagr_state *ls,
+                                const scp_real *dd, const int *dd_idx, int dd_size, double scale,
+                                unsigned char incremental)
+{
+    int i, k;
+    double value, delta;
+    scp_real *reduced_costs = ls->reduced_costs;
+
+    if (!incremental && ls->num_threads > 1
+        && !(ls->deterministic && sizeof(scp_real) != sizeof(double))) {
+        double neg_sum = 0.0;
+        scp_real *step = ls->step;
+        const int num_row = inst->num_row;
+        const int num_col = inst->num_col;
+
+        #pragma omp parallel num_threads(ls->num_threads) private(i, value)
+        {
+            #pragma omp for
+            for (i = 0; i < num_row; i++) {
+                step[i] = 0.0;
+            }
+            #pragma omp for
+            for (k = 0; k < dd_size; k++) {
+                i = dd_idx[k];
+                value = scale * dd[i];
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    step[i] = value;
+                }
+            }
+            // rows of a column are ascending, so this subtracts in the same order as the
+            // row-wise scatter
+            #pragma omp for reduction(+:neg_sum)
+            for (k = 0; k < num_col; k++) {
+                value = COL_CALL(gather, inst, k, step, reduced_costs[k]);
+                reduced_costs[k] = value;
+                if (value < 0) {
+                    neg_sum += value;
+                }
             }
         }
+        if (ls->deterministic) neg_sum = det_sum_negative(reduced_costs, num_col, ls);
+        ls->neg_rc_sum = neg_sum;
+        return;
     }
 
-    for(i = 0; i < num_row; i++) {
-        if (subg[i] != 0) {
+    if (!incremental) {
+        for (k = 0; k < dd_size; k++) {
+            i = dd_idx[k];
+            value = scale * dd[i];
+            if (value < - ZERO_TOL || value > ZERO_TOL) {
+                ROW_CALL(scatter, inst, i, reduced_costs, value);
+            }
+        }
+        ls->neg_rc_sum = ls->deterministic ? det_sum_negative(reduced_costs, inst->num_col, ls)
+                         : scp_simd->sum_negative(reduced_costs, inst->num_col);
+        return;
+    }
+
+    // columns whose state disagrees with the new reduced cost get queued, once
+    delta = 0.0;
+    for (k = 0; k < dd_size; k++) {
+        i = dd_idx[k];
+        value = scale * dd[i];
+        if (value < - ZERO_TOL || value > ZERO_TOL) {
+            delta = ROW_CALL(scatter_queue, inst, i, value, ls, delta);
+        }
+    }
+    ls->neg_rc_sum += delta;
+}
+
+
+/* Brings subgradient vector up to date with the reduced costs.
+If incremental, only the queued columns are checked, and the rows of the columns that
+crossed SUBG_TOL are adjusted. Otherwise the subgradient vector is rebuilt, row by row
+over row_wise_a when several threads are used. Rows covered by fixed columns get 0. */
+static void update_subg_vector(const scp_instance *inst, lagr_state *ls, unsigned char incremental)
+{
+    int i, k, idx, g, nonzero;
+    unsigned char below;
+    int *subg = ls->subg;
+    unsigned char *col_state = ls->col_state;
+    const scp_real *reduced_costs = ls->reduced_costs;
+    const int num_col = inst->num_col;
+    const int num_row = inst->num_row;
+    const int *row_covered = ls->row_covered;
+
+    if (!incremental && ls->num_threads > 1) {
+
+        nonzero = 0;
+        #pragma omp parallel num_threads(ls->num_threads) private(g)
+        {
+            #pragma omp for
+            for (i = 0; i < num_col; i += SIMD_BLOCK) {
+                scp_simd->below_mask(reduced_costs + i,
+                                     num_col - i < SIMD_BLOCK ? num_col - i : SIMD_BLOCK,
+                                     SUBG_TOL, col_state + i);
+            }
+            #pragma omp for reduction(+:nonzero)
+            for (i = 0; i < num_row; i++) {
+                g = 1 - ROW_CALL(count, inst, i, col_state);
+                if (row_covered != NULL && row_covered[i]) {
+                    g = 0;
+                }
+                subg[i] = g;
+                nonzero += g != 0;
+            }
+        }
+        ls->subg_nonzero = nonzero;
+        ls->queue_size = 0;
+        return;
+    }
+
+    if (!incremental) {
+        for (i = 0; i < num_row; i++) {
+            subg[i] = 1;
+        }
+        scp_simd->below_mask(reduced_costs, num_col, SUBG_TOL, col_state);
+        for (i = 0; i < num_col; i++) {
+            if (col_state[i]) {
+                COL_CALL(decrement, inst, i, subg);
+            }
+        }
+        nonzero = 0;
+        for (i = 0; i < num_row; i++) {
+            if (row_covered != NULL && row_covered[i]) {
+                subg[i] = 0;
+            }
+            nonzero += subg[i] != 0;
+        }
+        ls->subg_nonzero = nonzero;
+        ls->queue_size = 0;
+        return;
+    }
+
+    nonzero = ls->subg_nonzero;
+    for (k = 0; k < ls->queue_size; k++) {
+        idx = ls->queue[k];
+        below = reduced_costs[idx] < SUBG_TOL;
+        if (below == (col_state[idx] & COL_BELOW)) {
+            col_state[idx] = below; // crossed back, nothing to do
+            continue;
+        }
+        col_state[idx] = below;
+
+        nonzero = COL_CALL(shift_subg, inst, idx, below ? -1 : 1, subg, row_covered, nonzero);
+    }
+    ls->subg_nonzero = nonzero;
+    ls->queue_size = 0;
+}
+
+
+/* Computes subgradient vector (sps)
+Returns -1 if current solution is optimal (i.e., subgradient vector becomes zero vector).
+Returns 0 otherwise. */
+static int compute_subg_vector_sps(const scp_instance *inst, lagr_state *ls,
+                                   unsigned char incremental)
+{
+    update_subg_vector(inst, ls, incremental);
+
+    return ls->subg_nonzero == 0 ? -1 : 0;
+}
+
+
+static int reserve_line_search(scp_line_search *lsb, const scp_instance *inst)
+{
+    const int n = inst->num_col > 0 ? inst->num_col : 1;
+
+    if (lsb->slope != NULL && lsb->num_col >= inst->num_col) return 0;
+    free_line_search(lsb);
+    MALLOC(lsb->slope, double *, n * sizeof(double))
+    MALLOC(lsb->seen, unsigned char *, n * sizeof(unsigned char))
+    MALLOC(lsb->cols, int *, n * sizeof(int))
+    MALLOC(lsb->breaks, scp_breakpoint *, n * sizeof(scp_breakpoint))
+    memset(lsb->slope, 0, n * sizeof(double));
+    memset(lsb->seen, 0, n * sizeof(unsigned char));
+    lsb->num_col = inst->num_col;
+    return 0;
+}
+
+
+static void free_line_search(scp_line_search *lsb)
+{
+    free(lsb->slope);
+    free(lsb->seen);
+    free(lsb->cols);
+    free(lsb->breaks);
+    memset(lsb, 0, sizeof(scp_line_search));
+}
+
+
+static double wall_seconds()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static double run_heuristic(const scp_instance *inst, const lagr_state *ls, scp_result *res)
+{
+    double cover = lagrangian_cover(inst, ls->reduced_costs, &res->ws.heur);
+
+    if (cover < res->upper_bound) res->upper_bound = cover;
+    return cover;
+}
+
+
+// sorts breakpoints by decreasing tau
+static int compare_breakpoint(const void *a, const void *b)
+{
+    double x = ((const scp_breakpoint *) a)->tau, y = ((const scp_breakpoint *) b)->tau;
+    return x > y ? -1 : x < y;
+}
+
+
+static int breakpoint_line_search(const scp_instance *inst, const lagr_state *ls,
+                                  scp_line_search *lsb, const scp_real *dd, const int *dd_idx,
+                                  int dd_size, double obj, double accept0, double accept_slope,
+                                  int max_k, double *tau)
+{
+    int i, j, k, b, n, num_breaks;
+    double value, s, rc, rc0, slope, dd_sum, t, target;
+    const scp_real *reduced_costs = ls->reduced_costs;
+
+    // reduced costs move by -slope * tau, over the rows shift_reduced_costs moved
+    n = 0;
+    dd_sum = 0.0;
+    for (k = 0; k < dd_size; k++) {
+        i = dd_idx[k];
+        value = dd[i];
+        if (value < - ZERO_TOL || value > ZERO_TOL) {
+            dd_sum += value;
+            n = ROW_CALL(add_slope, inst, i, value, lsb, n);
+        }
+    }
+
+    // slope of the obj value just below tau = 1, and the sign changes within (0, 1)
+    slope = dd_sum;
+    num_breaks = 0;
+    for (j = 0; j < n; j++) {
+        k = lsb->cols[j];
+        s = lsb->slope[k];
+        rc = reduced_costs[k];
+        rc0 = rc + s;
+        if (rc < 0) slope -= s;
+        if ((s > 0 && rc0 > 0 && rc < 0) || (s < 0 && rc0 < 0 && rc > 0)) {
+            lsb->breaks[num_breaks].tau = rc0 / s;
+            lsb->breaks[num_breaks].weight = fabs(s);
+            num_breaks++;
+        }
+        lsb->slope[k] = 0.0;
+        lsb->seen[k] = 0;
+    }
+    qsort(lsb->breaks, num_breaks, sizeof(scp_breakpoint), compare_breakpoint);
+
+    // walk down from tau = 1, the slope grows by the weight of each kink passed
+    t = 1.0;
+    b = 0;
+    for (k = 1; ; k++) {
+        target = ldexp(1.0, -k);
+        for (; b < num_breaks && lsb->breaks[b].tau >= target; b++) {
+            obj -= (t - lsb->breaks[b].tau) * slope;
+            t = lsb->breaks[b].tau;
+            slope += lsb->breaks[b].weight;
+        }
+        obj -= (t - target) * slope;
+        t = target;
+        if (obj >= accept0 + t * accept_slope) break;
+        // past 2^-64 the step is far below ZERO_TOL for any dd entry
+        if ((max_k > 0 && k == max_k) || k == 64) {
+            *tau = t;
             return 0;
         }
     }
-    return -1;
+    *tau = t;
+    return 1;
+}
+
+
+#ifdef SCP_FLOAT
+/* Computes obj value of dual in double in one pass over col_wise_a, exact up to double
+rounding, as the float obj values of the iterations drift with every incremental step.
+Returns obj value of dual. */
+static double exact_obj_value(const scp_instance *inst, const double *dual, int nt)
+{
+    int i;
+    double value, obj = inst->fixed_cost;
+
+    for (i = 0; i < inst->num_row; i++) {
+        obj += dual[i];
+    }
+    #pragma omp parallel for if (nt > 1) num_threads(nt) private(value) reduction(+:obj)
+    for (i = 0; i < inst->num_col; i++) {
+        value = COL_CALL(gather_exact, inst, i, dual, inst->costs[i]);
+        if (value < 0) {
+            obj += value;
+        }
+    }
+    return obj;
+}
+
+
+/* Recomputes the reduced costs of ls from dual in one pass, dropping the rounding the float
+steps accumulated since the last refresh.
+Returns obj value of dual. */
+static double refresh_reduced_costs(const scp_instance *inst, const scp_real *dual,
+                                    lagr_state *ls)
+{
+    int i;
+    double dual_sum = 0.0;
+
+    for (i = 0; i < inst->num_row; i++) {
+        dual_sum += dual[i];
+    }
+    if (ls->deterministic) dual_sum = det_sum(dual, inst->num_row, ls);
+    return init_reduced_costs(inst, dual, dual_sum, ls);
+}
+#endif
+
+
+double store_best_dual(const scp_instance *inst, scp_result *res, const scp_real *best_dual,
+                       double best_obj, int num_threads)
+{
+    int i;
+
+    for (i = 0; i < inst->num_row; i++) {
+        res->best_dual[i] = best_dual[i];
+    }
+    res->working_obj = best_obj;
+#ifdef SCP_FLOAT
+    best_obj = exact_obj_value(inst, res->best_dual, num_threads);
+#endif
+    res->best_obj = best_obj;
+    return best_obj;
+}
+
+
+int check_termination(const scp_termination *term, stop_state *st, int itr, double best_obj)
+{
+    struct timespec now;
+    const int done = itr + 1;
+
+    if (best_obj > term->target_bound) return SCP_STOP_TARGET;
+
+    if (term->stall_itr > 0 && done - st->mark_itr >= term->stall_itr) {
+        if (best_obj - st->mark_obj <= term->stall_tol * fabs(best_obj)) return SCP_STOP_STALL;
+        st->mark_itr = done;
+        st->mark_obj = best_obj;
+    }
+
+    if (term->time_limit > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - st->begin.tv_sec) + (now.tv_nsec - st->begin.tv_nsec) * 1e-9
+            >= term->time_limit) return SCP_STOP_TIME;
+    }
+    return 0;
 }
 
 
 /************** Spectral projected subgradient **************
 Returns best (maximum) dual solution.
 Returns -1 on system failure. */
-double spectral_projected_subgradient(int max_itr)
+double spectral_projected_subgradient_ctrl(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state, scp_ctrl *ctrl)
 {
     double curr_obj, best_obj, worst_obj, sub_obj, *past_objs;
-    double *curr_dual, *old_dual, *best_dual, *dual1, *dual2;
-    double *reduced_costs, *momentum, *dd;
-    int worst_obj_idx, dd_size, *dd_idx;
-    int *curr_subg, *old_subg, *subg1, *subg2;
-    double alpha, alpha_deno, eta, eta_not, tau, accept, product, value;
-    int itr, i, j, k;
-    unsigned char is_opt;
-
-    const int M = 10;
-    const double mu = 0.7;
-    const double gamma = 0.1;
-
-    // allocate memory for local variables
-    MALLOC(reduced_costs, double *, num_col * sizeof(double));
-    MALLOC(dual1, double *, num_row * sizeof(double));
-    MALLOC(dual2, double *, num_row * sizeof(double));
-    MALLOC(subg1, int *, num_row * sizeof(int));
-    MALLOC(subg2, int *, num_row * sizeof(int));
-
-    MALLOC(past_objs, double *, M * sizeof(double));
-    MALLOC(momentum, double *, num_row * sizeof(double));
-    memset(momentum, 0, num_row * sizeof(double));
-    MALLOC(dd, double *, num_row * sizeof(double));
-    MALLOC(dd_idx, int *, num_row * sizeof(int)); // idx of nonzero values in vector dd
-    
+    scp_real *curr_dual, *old_dual, *best_dual, *dual1, *dual2;
+    scp_real *momentum, *dd;
+    int worst_obj_idx, newest_obj_idx, dd_size, *dd_idx, *dd_subg;
+    int *subg;
+    double alpha, alpha_deno, eta, eta_not, tau, back, accept, product, value, shift;
+    int itr, i, j, k, nt, halvings, stop;
+    long long touched;
+    unsigned char is_opt, incremental, parallel;
+    double phase_mark = 0.0, subg_norm = 0.0;
+    scp_perf *perf = NULL;
+    lagr_state ls;
+    stop_state st;
+    scp_trace_info info;
+    scp_workspace *ws = &res->ws;
+
+    const int M = params->sps_memory > 0 ? params->sps_memory : 1;
+    const double mu = params->sps_momentum;
+    const double gamma = params->sps_gamma;
+
+    const int num_col = inst->num_col;
+    const int num_row = inst->num_row;
+    const int *row_wise_idx = inst->row_wise_idx;
+    const int max_itr = params->max_itr;
+    const int max_halvings = params->term.max_halvings;
+    const int timers = params->phase_timers;
+    const int heur_interval = params->heur_interval;
+    const int breakpoints = params->sps_line_search == SCP_LS_BREAKPOINTS;
+    double *phase_time = res->phase_time;
+
+    if (params->backend != SCP_BACKEND_CPU) {
+#ifdef SCP_CUDA
+        return cuda_spectral_projected_subgradient(inst, res, params, init_dual, state, ctrl);
+#else
+        fprintf(stderr, "Error: built without the CUDA backend\n");
+        return -1;
+#endif
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+
+    // buffers of the result handle, allocated by the first solve
+    if (reserve_workspace(ws, inst, M)) return -1;
+    if (heur_interval > 0 && reserve_heuristic(&ws->heur, inst)) return -1;
+    if (breakpoints && reserve_line_search(&ws->ls, inst)) return -1;
+    if (timers && params->phase_counters) perf = open_scp_perf(res->phase_counters);
+    init_lagr_state(inst, &ls, ws, params);
+    nt = ls.num_threads;
+    parallel = nt > 1;
+    dual1 = ws->dual1;
+    dual2 = ws->dual2;
+
+    past_objs = ws->past_objs;
+    momentum = ws->momentum;
+    memset(momentum, 0, num_row * sizeof(scp_real));
+    dd = ws->dd;
+    dd_idx = ws->dd_idx; // idx of nonzero values in vector dd
+    dd_subg = ws->dd_subg; // subgradient of the rows in dd_idx
+    subg = ls.subg;
+
+    // parallel iterations keep dd dense (zero for unmoved rows) over all rows
+    if (parallel) {
+        for (i = 0; i < num_row; i++) {
+            dd_idx[i] = i;
+        }
+    }
+
     // init data
     old_dual = curr_dual = dual1;
     best_dual = dual2;
 
-    curr_obj = best_obj = worst_obj = past_objs[(worst_obj_idx=0)] 
-    = init_dual_vector(curr_dual, reduced_costs);
+    PHASE_MARK(timers, phase_mark);
+    if (init_dual != NULL) {
+        curr_obj = copy_dual_vector(inst, init_dual, curr_dual, &ls);
+    } else {
+        curr_obj = init_dual_vector(inst, curr_dual, &ls);
+    }
+    // the start is the best dual until an iteration improves on it, the buffer may hold the
+    // dual of a previous solve
+    memcpy(best_dual, curr_dual, num_row * sizeof(scp_real));
+    PHASE_ADD(timers, phase_mark, SCP_PHASE_INIT);
+    best_obj = worst_obj = past_objs[(worst_obj_idx=newest_obj_idx=0)] = curr_obj;
+
+    alpha = params->sps_alpha; // init alpha
+
+    // continue momentum, step length and line search history of a previous solve
+    if (restore_sps_state(state, num_row, M, ls.row_covered, momentum, &alpha, past_objs)) {
+        past_objs[0] = curr_obj;
+        for (j = 1; j < M; j++) {
+            if (past_objs[j] < worst_obj) {
+                worst_obj = past_objs[j];
+                worst_obj_idx = j;
+            }
+        }
+    }
 
-    is_opt = compute_subg_vector_sps(subg1, reduced_costs);
-    if (is_opt) goto cleanup;
+    itr = 0;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    is_opt = compute_subg_vector_sps(inst, &ls, 0);
+    PHASE_ADD(timers, phase_mark, SCP_PHASE_SUBGRADIENT);
+    if (is_opt || stop) goto cleanup;
 
     // compute eta_not
     eta_not = 0;
+    #pragma omp parallel for if (parallel) num_threads(nt) reduction(+:eta_not)
     for (i = 0; i < num_row; i++) {
-        eta_not += subg1[i] * subg1[i];
+        eta_not += subg[i] * subg[i];
     }
     eta_not = sqrt(eta_not);
 
-    alpha = 0.1; // init alpha
-
     for (itr = 0; itr < max_itr; itr++) {
-        // printf("%f\n", curr_obj);
-
-        // swap subg
-        if (itr % 2 == 0) {
-            old_subg = subg1;
-            curr_subg = subg2;
-        } else {
-            old_subg = subg2;
-            curr_subg = subg1;
+        PHASE_MARK(timers, phase_mark);
+        if (params->trace != NULL) {
+            subg_norm = 0.0;
+            for (i = 0; i < num_row; i++) {
+                subg_norm += subg[i] * subg[i];
+            }
+            subg_norm = sqrt(subg_norm);
         }
-        
+
         // update dual vector and objective value
         dd_size = 0;
-        sub_obj = 0.0;
+        sub_obj = ls.fixed_cost;
         product = 0.0;
-        for (i = 0; i < num_row; i++) {
-            momentum[i] = alpha * old_subg[i] + mu * momentum[i];
-            value = old_dual[i] + momentum[i];
-            if (value < 0) {
-                value = 0;
+        touched = 0;
+        if (parallel) {
+            #pragma omp parallel for num_threads(nt) private(value) \
+                reduction(+:sub_obj, product, touched)
+            for (i = 0; i < num_row; i++) {
+                momentum[i] = alpha * subg[i] + mu * momentum[i];
+                value = old_dual[i] + momentum[i];
+                if (value < 0) {
+                    value = 0;
+                }
+                value -= old_dual[i];
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    curr_dual[i] = old_dual[i] + value;
+                    product += value * momentum[i];
+                    touched += row_wise_idx[i+1] - row_wise_idx[i];
+                } else {
+                    curr_dual[i] = old_dual[i];
+                    value = 0.0;
+                }
+                dd[i] = value;
+                dd_subg[i] = subg[i];
+                sub_obj += curr_dual[i];
             }
-            value -= old_dual[i];
-            if (value < - ZERO_TOL || value > ZERO_TOL) {
-                dd[i]= value;
-                product += value * momentum[i];
-
-                curr_dual[i] = old_dual[i] + value;
-                for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
-                    reduced_costs[row_wise_a[j]] -= value;
+            dd_size = num_row;
+        } else {
+            for (i = 0; i < num_row; i++) {
+                momentum[i] = alpha * subg[i] + mu * momentum[i];
+                value = old_dual[i] + momentum[i];
+                if (value < 0) {
+                    value = 0;
                 }
+                value -= old_dual[i];
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    dd[i]= value;
+                    product += value * momentum[i];
 
-                dd_idx[dd_size] = i;
-                dd_size++;
-            } else {
-                curr_dual[i] = old_dual[i];
+                    curr_dual[i] = old_dual[i] + value;
+                    touched += row_wise_idx[i+1] - row_wise_idx[i];
+
+                    dd_subg[dd_size] = subg[i];
+                    dd_idx[dd_size] = i;
+                    dd_size++;
+                } else {
+                    curr_dual[i] = old_dual[i];
+                }
+                sub_obj += curr_dual[i];
             }
-            sub_obj += curr_dual[i];
         }
+        if (ls.deterministic) {
+            sub_obj = ls.fixed_cost + det_sum(curr_dual, num_row, &ls);
+            det_dd_sums(dd, dd_idx, dd_size, momentum, NULL, NULL, &ls, &product, &value);
+        }
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_DUAL);
+        incremental = USE_INCREMENTAL(touched, num_col);
+        shift_reduced_costs(inst, &ls, dd, dd_idx, dd_size, 1.0, incremental);
 
         // compute current obj value
-        curr_obj = sub_obj;
-        for (i = 0; i < num_col; i++) {
-            if (reduced_costs[i] < 0) {
-                curr_obj += reduced_costs[i];
-            }
-        }
+        curr_obj = sub_obj + ls.neg_rc_sum;
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_OBJECTIVE);
 
         // non-monotone line search along the direction dd
         product /= alpha;
         tau = 1.0;
         eta = eta_not / pow(itr, 1.1);
         accept = worst_obj + gamma * tau * product - eta;
+        halvings = 0;
         while (curr_obj < accept) {
-            tau *= 0.5;
+            if (max_halvings > 0 && halvings++ == max_halvings) {
+                stop = SCP_STOP_LINE_SEARCH;
+                break;
+            }
+            // step back by back * dd
+            if (breakpoints) {
+                if (!breakpoint_line_search(inst, &ls, &ws->ls, dd, dd_idx, dd_size, curr_obj,
+                                            worst_obj - eta, gamma * product, max_halvings,
+                                            &tau)) {
+                    stop = SCP_STOP_LINE_SEARCH;
+                }
+                back = 1.0 - tau;
+            } else {
+                tau *= 0.5;
+                back = tau;
+            }
             // adjust dual vector
-            for (k = 0; k < dd_size; k++) {
-                i = dd_idx[k];
-                value = tau * dd[i];
-                if (value < - ZERO_TOL || value > ZERO_TOL) {
-                    curr_dual[i] -= value;
-                    sub_obj -= value;
-                    for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
-                        reduced_costs[row_wise_a[j]] += value;
+            if (parallel) {
+                shift = 0.0;
+                #pragma omp parallel for num_threads(nt) private(i, value) reduction(+:shift)
+                for (k = 0; k < dd_size; k++) {
+                    i = dd_idx[k];
+                    value = back * dd[i];
+                    if (value < - ZERO_TOL || value > ZERO_TOL) {
+                        shift += step_down(&curr_dual[i], value);
                     }
                 }
-            }
-            // compute adjusted obj value
-            curr_obj = sub_obj;
-            for (i = 0; i < num_col; i++) {
-                if (reduced_costs[i] < 0) {
-                    curr_obj += reduced_costs[i];
+                sub_obj -= shift;
+            } else {
+                for (k = 0; k < dd_size; k++) {
+                    i = dd_idx[k];
+                    value = back * dd[i];
+                    if (value < - ZERO_TOL || value > ZERO_TOL) {
+                        sub_obj -= step_down(&curr_dual[i], value);
+                    }
                 }
             }
+            if (ls.deterministic) sub_obj = ls.fixed_cost + det_sum(curr_dual, num_row, &ls);
+            shift_reduced_costs(inst, &ls, dd, dd_idx, dd_size, -back, incremental);
+
+            // compute adjusted obj value
+            curr_obj = sub_obj + ls.neg_rc_sum;
+            // the sweep already tested tau, rounding of curr_obj must not send it back
+            if (breakpoints) break;
             accept -= gamma * tau * product;
         }
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_LINE_SEARCH);
+#ifdef SCP_FLOAT
+        if (itr % FLOAT_REFRESH == FLOAT_REFRESH - 1) {
+            curr_obj = refresh_reduced_costs(inst, curr_dual, &ls);
+            incremental = 0;
+            PHASE_ADD(timers, phase_mark, SCP_PHASE_OBJECTIVE);
+        }
+#endif
 
         // update best solution
         if (best_obj < curr_obj) {
@@ -383,23 +1245,63 @@ double spectral_projected_subgradient(int max_itr)
             old_dual = curr_dual;
         }
 
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = alpha;
+            info.tau = tau;
+            info.subg_norm = subg_norm;
+            for (k = info.dd_size = 0; k < dd_size; k++) {
+                info.dd_size += dd[dd_idx[k]] != 0.0; // dd is dense in parallel mode
+            }
+            params->trace(&info, params->trace_data);
+        }
+
+        // covers from the reduced costs of the current dual vector
+        if (heur_interval > 0 && itr % heur_interval == 0) {
+            PHASE_ADD(timers, phase_mark, SCP_PHASE_BOOKKEEPING);
+            run_heuristic(inst, &ls, res);
+            PHASE_ADD(timers, phase_mark, SCP_PHASE_HEURISTIC);
+        }
+
+        if (!stop && best_obj > res->upper_bound - 1 + GAP_TOL) stop = SCP_STOP_GAP;
+        if (!stop) stop = check_termination(&params->term, &st, itr, best_obj);
+        if (stop) {
+            itr++;
+            break;
+        }
+        if (ctrl != NULL && scp_ctrl_update(ctrl, itr, max_itr, best_obj)) {
+            stop = SCP_STOP_RACE;
+            itr++;
+            break;
+        }
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_BOOKKEEPING);
+
         // compute subgradient vector
-        is_opt = compute_subg_vector_sps(curr_subg, reduced_costs);
-        if (is_opt) 
+        is_opt = compute_subg_vector_sps(inst, &ls, incremental);
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_SUBGRADIENT);
+        if (is_opt) {
+            itr++; // count the finished iteration
             break;
+        }
 
         // update alpha
         alpha = 0.0;
         alpha_deno = 0.0;
-        for (k = 0; k < dd_size; k++) {
-            i = dd_idx[k];
-            value = dd[i];
-            alpha += value * value;
-            alpha_deno += value * (old_subg[i] - curr_subg[i]);
+        if (ls.deterministic) {
+            det_dd_sums(dd, dd_idx, dd_size, NULL, dd_subg, subg, &ls, &alpha, &alpha_deno);
+        } else {
+            #pragma omp parallel for if (parallel) num_threads(nt) reduction(+:alpha, alpha_deno)
+            for (k = 0; k < dd_size; k += SIMD_BLOCK) {
+                scp_simd->dd_dots(dd, dd_idx + k, dd_subg + k, subg,
+                                  dd_size - k < SIMD_BLOCK ? dd_size - k : SIMD_BLOCK,
+                                  &alpha, &alpha_deno);
+            }
         }
 
         if (alpha_deno < ZERO_TOL) {
-            alpha =  0.1;
+            alpha = params->sps_alpha;
         } else {
             alpha = tau * alpha / alpha_deno;
         }
@@ -408,6 +1310,7 @@ double spectral_projected_subgradient(int max_itr)
         // update worst_lb
         i = (itr+1) % M;
         past_objs[i] = curr_obj;
+        newest_obj_idx = i;
         if (i == worst_obj_idx) {
             if (curr_obj <= worst_obj) {
                 worst_obj = curr_obj;
@@ -424,72 +1327,66 @@ double spectral_projected_subgradient(int max_itr)
             worst_obj = curr_obj;
             worst_obj_idx = i;
         }
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_BOOKKEEPING);
     }
 
 
 cleanup:
     if (is_opt) {
-        best_dual = curr_dual;
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
         best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
+    }
+    if (ctrl != NULL && (stop == SCP_STOP_OPTIMAL || stop == SCP_STOP_TARGET)) {
+        scp_ctrl_optimal(ctrl, best_obj); // the other solves of the race are done as well
     }
 
-    memcpy(best_dual_copy, best_dual, num_row * sizeof(double));
+    best_obj = store_best_dual(inst, res, best_dual, best_obj, ls.deterministic ? 1 : nt);
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+    save_sps_state(state, num_row, M, momentum, alpha, past_objs, newest_obj_idx);
+    close_scp_perf(perf);
 
-    free(reduced_costs);
-    free(dual1);
-    free(dual2);
-    free(subg1);
-    free(subg2);
-    free(past_objs);
-    free(momentum);
-    free(dd);
-    free(dd_idx);
+    // old_dual is the dual vector of the reduced costs left in ws
+    ws->rc_inst = inst;
+    ws->rc_fix_version = inst->fix_version;
+    ws->rc_dual = old_dual;
 
     return best_obj;
 }
 
 
 /* Computes subgradient vector (basic) 
-Returns square norm of subgradient vector.
+Subgradient entries of rows with zero dual that would decrease are projected to zero in
+the step, ls->subg itself keeps the unprojected vector.
+Returns square norm of (projected) subgradient vector.
 Returns -1 if current solution is optimal.
 (i.e., subgradient vector becomes zero vector) */
-static long long compute_subg_vector_basic(int *subg, double *reduced_costs, double *dual)
+static long long compute_subg_vector_basic(const scp_instance *inst, lagr_state *ls,
+                                           scp_real *dual, unsigned char incremental)
 {
-    int i, j;
+    int i;
     long long norm;
-    unsigned char is_opt;
+    const int *subg = ls->subg;
+    const int num_row = inst->num_row;
 
-    for (i = 0; i < num_row; i++) {
-        subg[i] = 1;
-    }
-    for (i = 0; i < num_col; i++) {
-        if (reduced_costs[i] < pow(10,-14)) {
-            for (j = col_wise_idx[i]; j < col_wise_idx[i+1]; j++) {
-                subg[col_wise_a[j]]--;
-            }
-        }
+    update_subg_vector(inst, ls, incremental);
+    if (ls->subg_nonzero == 0) {
+        return -1;
     }
 
-    is_opt = 1;
     norm = 0;
+    #pragma omp parallel for if (ls->num_threads > 1) num_threads(ls->num_threads) \
+        reduction(+:norm)
     for(i = 0; i < num_row; i++) {
-        if (subg[i] != 0) {
-            is_opt = 0;
-
-            if (subg[i] < 0 && dual[i] < pow(10,-14)) {
-                subg[i] = 0;
-            } else {
-                norm += subg[i] * subg[i];
-            }
+        if (subg[i] > 0 || (subg[i] < 0 && dual[i] >= SUBG_TOL)) {
+            norm += subg[i] * subg[i];
         }
     }
 
-    if (is_opt) {
-        return -1;
-    } else {
-        if (norm == 0) norm = 1;
-        return norm;
-    }
+    if (norm == 0) norm = 1;
+    return norm;
 }
 
 
@@ -497,66 +1394,167 @@ static long long compute_subg_vector_basic(int *subg, double *reduced_costs, dou
 Optimal upperbound (primal opt soln of original SCP) is given for test purpose.
 Returns best (maximum) dual solution
 Returns -1 on system failure */
-double basic_subgradient(int max_itr, int upperbound)
+double basic_subgradient_ctrl(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual, scp_ctrl *ctrl)
 {
     double curr_obj, best_obj;
-    double *curr_dual, *old_dual, *best_dual, *dual1, *dual2;
-    double *reduced_costs;
-    int *subg;
-    int itr, counter, i, j;
-    long long norm;
+    scp_real *curr_dual, *old_dual, *best_dual, *dual1, *dual2;
+    scp_real *dd;
+    int *subg, dd_size, *dd_idx;
+    int itr, counter, i, g, nt, stop;
+    long long norm, touched;
     double lambda, step_size, value;
+    unsigned char incremental, parallel;
+    double phase_mark = 0.0;
+    scp_perf *perf = NULL;
+    lagr_state ls;
+    stop_state st;
+    scp_trace_info info;
+    scp_workspace *ws = &res->ws;
+
+    const int counter_limit = params->bsm_patience;
+
+    const int num_col = inst->num_col;
+    const int num_row = inst->num_row;
+    const int *row_wise_idx = inst->row_wise_idx;
+    const int max_itr = params->max_itr;
+    const int timers = params->phase_timers;
+    double *phase_time = res->phase_time;
+
+    // the step size needs an upperbound, the heuristic supplies one if none is given
+    double upperbound = params->upperbound > 0 ? params->upperbound : HUGE_VAL;
+    const int heur_interval = params->heur_interval > 0 ? params->heur_interval
+                              : params->upperbound > 0 ? 0 : SCP_HEUR_INTERVAL;
+
+    if (params->backend != SCP_BACKEND_CPU) {
+#ifdef SCP_CUDA
+        return cuda_basic_subgradient(inst, res, params, init_dual, ctrl);
+#else
+        fprintf(stderr, "Error: built without the CUDA backend\n");
+        return -1;
+#endif
+    }
 
-    const int counter_limit = 10;
-
-    // allocate memory for local variables
-    MALLOC(reduced_costs, double *, num_col * sizeof(double));
-    MALLOC(dual1, double *, num_row * sizeof(double));
-    MALLOC(dual2, double *, num_row * sizeof(double));
-    MALLOC(subg, int *, num_row * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &st.begin);
+    clear_phase_stats(res);
+    res->upper_bound = HUGE_VAL;
+
+    // buffers of the result handle, allocated by the first solve
+    if (reserve_workspace(ws, inst, 0)) return -1;
+    if (heur_interval > 0 && reserve_heuristic(&ws->heur, inst)) return -1;
+    if (timers && params->phase_counters) perf = open_scp_perf(res->phase_counters);
+    init_lagr_state(inst, &ls, ws, params);
+    nt = ls.num_threads;
+    parallel = nt > 1;
+    dual1 = ws->dual1;
+    dual2 = ws->dual2;
+    dd = ws->dd;
+    dd_idx = ws->dd_idx; // idx of nonzero values in vector dd
+    subg = ls.subg;
+
+    // parallel iterations keep dd dense (zero for unmoved rows) over all rows
+    if (parallel) {
+        for (i = 0; i < num_row; i++) {
+            dd_idx[i] = i;
+        }
+    }
 
     // init data
     old_dual = curr_dual = dual1;
     best_dual = dual2;
 
-    curr_obj = best_obj = init_dual_vector(curr_dual, reduced_costs);
+    PHASE_MARK(timers, phase_mark);
+    if (init_dual != NULL) {
+        curr_obj = copy_dual_vector(inst, init_dual, curr_dual, &ls);
+    } else {
+        curr_obj = init_dual_vector(inst, curr_dual, &ls);
+    }
+    // the start is the best dual until an iteration improves on it
+    memcpy(best_dual, curr_dual, num_row * sizeof(scp_real));
+    PHASE_ADD(timers, phase_mark, SCP_PHASE_INIT);
+    best_obj = curr_obj;
 
     itr = counter = 0;
     norm = 0;
-    lambda = 2.0;
-    for (itr = 0; itr < max_itr; itr++) {
-        // printf("%f\n", curr_obj);
+    lambda = params->bsm_lambda;
+    incremental = 0;
+    st.mark_itr = 0;
+    st.mark_obj = best_obj;
+    stop = best_obj > params->term.target_bound ? SCP_STOP_TARGET : 0;
+    for (itr = 0; itr < max_itr && !stop; itr++) {
+        PHASE_MARK(timers, phase_mark);
+
+        // covers from the reduced costs of the current dual vector
+        if (heur_interval > 0 && itr % heur_interval == 0) {
+            value = run_heuristic(inst, &ls, res);
+            upperbound = value < upperbound ? value : upperbound;
+            PHASE_ADD(timers, phase_mark, SCP_PHASE_HEURISTIC);
+        }
 
         // compute subgradient vector and step size
-        norm = compute_subg_vector_basic(subg, reduced_costs, old_dual);
+        norm = compute_subg_vector_basic(inst, &ls, old_dual, incremental);
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_SUBGRADIENT);
         if (norm < 0) 
             break;
 
         step_size = lambda * (1.05 * upperbound - curr_obj) / norm;
 
         // update dual vector and objective value
-        curr_obj = 0.0;
-        for (i = 0; i < num_row; i++) {
-            value = step_size * subg[i];
-            curr_dual[i] =  old_dual[i] + value;
-            if (curr_dual[i] < 0) {
-                value -= curr_dual[i];
-                curr_dual[i] = 0.0;
+        curr_obj = ls.fixed_cost;
+        dd_size = 0;
+        touched = 0;
+        if (parallel) {
+            #pragma omp parallel for num_threads(nt) private(g, value) \
+                reduction(+:curr_obj, touched)
+            for (i = 0; i < num_row; i++) {
+                g = subg[i];
+                if (g < 0 && old_dual[i] < SUBG_TOL) {
+                    g = 0; // projected
+                }
+                value = step_size * g;
+                curr_dual[i] =  old_dual[i] + value;
+                if (curr_dual[i] < 0) {
+                    value -= curr_dual[i];
+                    curr_dual[i] = 0.0;
+                }
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    touched += row_wise_idx[i+1] - row_wise_idx[i];
+                } else {
+                    value = 0.0;
+                }
+                dd[i] = value;
+                curr_obj += curr_dual[i];
             }
+            dd_size = num_row;
+        } else {
+            for (i = 0; i < num_row; i++) {
+                g = subg[i];
+                if (g < 0 && old_dual[i] < SUBG_TOL) {
+                    g = 0; // projected
+                }
+                value = step_size * g;
+                curr_dual[i] =  old_dual[i] + value;
+                if (curr_dual[i] < 0) {
+                    value -= curr_dual[i];
+                    curr_dual[i] = 0.0;
+                }
 
-            if (value < - ZERO_TOL || value > ZERO_TOL) {
-                for (j = row_wise_idx[i]; j < row_wise_idx[i+1]; j++) {
-                    reduced_costs[row_wise_a[j]] -= value;
+                if (value < - ZERO_TOL || value > ZERO_TOL) {
+                    dd[i] = value;
+                    dd_idx[dd_size++] = i;
+                    touched += row_wise_idx[i+1] - row_wise_idx[i];
                 }
+                curr_obj += curr_dual[i];
             }
-            curr_obj += curr_dual[i];
         }
+        if (ls.deterministic) curr_obj = ls.fixed_cost + det_sum(curr_dual, num_row, &ls);
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_DUAL);
+        incremental = USE_INCREMENTAL(touched, num_col);
+        shift_reduced_costs(inst, &ls, dd, dd_idx, dd_size, 1.0, incremental);
+
         // compute current obj value
-        for (i = 0; i < num_col; i++) {
-            if (reduced_costs[i] < 0) {
-                curr_obj += reduced_costs[i];
-            }
-        }
+        curr_obj += ls.neg_rc_sum;
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_OBJECTIVE);
 
         // update best solution
         if (best_obj < curr_obj) {
@@ -576,59 +1574,452 @@ double basic_subgradient(int max_itr, int upperbound)
             lambda *= 0.5;
             counter = 0;
         }
+
+        if (params->trace != NULL) {
+            info.itr = itr;
+            info.curr_obj = curr_obj;
+            info.best_obj = best_obj;
+            info.step = step_size;
+            info.tau = 1.0;
+            info.subg_norm = sqrt((double) norm);
+            for (i = info.dd_size = 0; i < dd_size; i++) {
+                info.dd_size += dd[dd_idx[i]] != 0.0; // dd is dense in parallel mode
+            }
+            params->trace(&info, params->trace_data);
+        }
+        PHASE_ADD(timers, phase_mark, SCP_PHASE_BOOKKEEPING);
+
+        if (best_obj > res->upper_bound - 1 + GAP_TOL) stop = SCP_STOP_GAP;
+        if (stop || (stop = check_termination(&params->term, &st, itr, best_obj)) != 0) {
+            itr++;
+            break;
+        }
+        if (ctrl != NULL && scp_ctrl_update(ctrl, itr, max_itr, best_obj)) {
+            stop = SCP_STOP_RACE;
+            itr++;
+            break;
+        }
     }
 
 
     if (norm < 0) {
-        best_dual = curr_dual;
+        // old_dual is the current (optimal) dual vector
+        best_dual = old_dual;
         best_obj = curr_obj;
+        stop = SCP_STOP_OPTIMAL;
     }
-    
-    memcpy(best_dual_copy, best_dual, num_row * sizeof(double));
+    if (ctrl != NULL && (stop == SCP_STOP_OPTIMAL || stop == SCP_STOP_TARGET)) {
+        scp_ctrl_optimal(ctrl, best_obj); // the other solves of the race are done as well
+    }
+
+    best_obj = store_best_dual(inst, res, best_dual, best_obj, ls.deterministic ? 1 : nt);
+    res->num_itr = itr;
+    res->stop_reason = stop ? stop : SCP_STOP_MAX_ITR;
+    close_scp_perf(perf);
 
-    free(reduced_costs);
-    free(dual1);
-    free(dual2);
-    free(subg);
+    // old_dual is the dual vector of the reduced costs left in ws
+    ws->rc_inst = inst;
+    ws->rc_fix_version = inst->fix_version;
+    ws->rc_dual = old_dual;
 
     return best_obj;
 }
 
 
-// Copies best dual vector to the input dual.
-void get_dual_vector(double *dual)
+void init_scp_params(scp_params *params)
 {
-    memcpy(dual, best_dual_copy, num_row * sizeof(double));
+    params->max_itr = 300;
+    params->upperbound = 0;
+    params->num_threads = 1;
+    params->method = SCP_SPS;
+    params->sps_memory = 10;
+    params->sps_momentum = 0.7;
+    params->sps_gamma = 0.1;
+    params->sps_alpha = 0.1;
+    params->sps_line_search = SCP_LS_HALVING;
+    params->bsm_lambda = 2.0;
+    params->bsm_patience = 10;
+    params->heur_interval = 0;
+    params->core_size = 5;
+    params->core_interval = 50;
+    params->term.time_limit = 0.0;
+    params->term.target_bound = HUGE_VAL;
+    params->term.stall_itr = 0;
+    params->term.stall_tol = 0.0;
+    params->term.max_halvings = 0;
+    params->trace = NULL;
+    params->trace_data = NULL;
+    params->phase_timers = 0;
+    params->phase_counters = 0;
+    params->backend = SCP_BACKEND_CPU;
+    params->deterministic = 0;
 }
 
 
-// Computes reduced costs of best dual vector.
-void get_reduced_costs(double *reduced_costs)
+double spectral_projected_subgradient_ex(const scp_instance *inst, scp_result *res,
+                                         const scp_params *params)
+{
+    return spectral_projected_subgradient_ctrl(inst, res, params, NULL, NULL, NULL);
+}
+
+
+double spectral_projected_subgradient_warm(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state)
+{
+    return spectral_projected_subgradient_ctrl(inst, res, params, init_dual, state, NULL);
+}
+
+
+double basic_subgradient_ex(const scp_instance *inst, scp_result *res, const scp_params *params)
+{
+    return basic_subgradient_ctrl(inst, res, params, NULL, NULL);
+}
+
+
+double basic_subgradient_warm(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual)
+{
+    return basic_subgradient_ctrl(inst, res, params, init_dual, NULL);
+}
+
+
+/* Creates empty SPS state for warm starts on inst with params->sps_memory.
+Returns NULL on failure. */
+scp_sps_state *create_scp_sps_state(const scp_instance *inst, const scp_params *params)
+{
+    scp_sps_state *state;
+
+    if ((state = (scp_sps_state *) calloc(1, sizeof(scp_sps_state))) == NULL) {
+        perror("Error malloc"); return NULL;
+    }
+    state->num_row = inst->num_row;
+    state->memory = params->sps_memory > 0 ? params->sps_memory : 1;
+    state->momentum = (double *) calloc(inst->num_row > 0 ? inst->num_row : 1, sizeof(double));
+    state->past_objs = (double *) calloc(state->memory, sizeof(double));
+    if (state->momentum == NULL || state->past_objs == NULL) {
+        perror("Error malloc"); free_scp_sps_state(state); return NULL;
+    }
+    return state;
+}
+
+
+void free_scp_sps_state(scp_sps_state *state)
+{
+    if (state == NULL) return;
+    free(state->momentum);
+    free(state->past_objs);
+    free(state);
+}
+
+
+double spectral_projected_subgradient_r(const scp_instance *inst, scp_result *res, int max_itr)
+{
+    scp_params params;
+
+    init_scp_params(&params);
+    params.max_itr = max_itr;
+    return spectral_projected_subgradient_ex(inst, res, &params);
+}
+
+
+double basic_subgradient_r(const scp_instance *inst, scp_result *res, int max_itr, int upperbound)
+{
+    scp_params params;
+
+    init_scp_params(&params);
+    params.max_itr = max_itr;
+    params.upperbound = upperbound;
+    return basic_subgradient_ex(inst, res, &params);
+}
+
+
+/* Copies best dual vector of res to the input dual. Rows removed by presolve get 0. */
+void get_dual_vector_r(const scp_result *res, double *dual)
+{
+    int i;
+
+    if (res->row_map == NULL) {
+        memcpy(dual, res->best_dual, res->num_row * sizeof(double));
+        return;
+    }
+    memset(dual, 0, res->orig_num_row * sizeof(double));
+    for (i = 0; i < res->num_row; i++) {
+        dual[res->row_map[i]] = res->best_dual[i];
+    }
+}
+
+
+// Returns number of iterations of the last solve on res.
+int get_num_itr_r(const scp_result *res) { return res->num_itr; }
+
+
+// Returns why the last solve on res ended (SCP_STOP_*), 0 if nothing was solved yet.
+int get_stop_reason_r(const scp_result *res) { return res->stop_reason; }
+
+
+// Returns cost of the best cover of the heuristic in the last solve on res.
+double get_upper_bound_r(const scp_result *res) { return res->upper_bound; }
+
+
+// Returns best bound of the last solve on res as tracked by its iterations.
+double get_working_bound_r(const scp_result *res) { return res->working_obj; }
+
+
+// Returns wall time spent in phase by the last solve on res.
+double get_phase_time_r(const scp_result *res, int phase)
+{
+    return phase >= 0 && phase < SCP_NUM_PHASES ? res->phase_time[phase] : 0.0;
+}
+
+
+// Returns short name of an SCP_PHASE_* phase.
+const char *get_phase_name(int phase)
 {
-    int i, j;
+    static const char *names[] = { "dual", "objective", "line_search", "subgradient",
+                                   "bookkeeping", "heuristic", "pricing", "init" };
+
+    return phase >= 0 && phase < SCP_NUM_PHASES ? names[phase] : "unknown";
+}
+
+
+// Returns count of counter in phase by the last solve on res, -1 if not counted.
+long long get_phase_counter_r(const scp_result *res, int phase, int counter)
+{
+    if (phase < 0 || phase >= SCP_NUM_PHASES || counter < 0 || counter >= SCP_NUM_COUNTERS) {
+        return -1;
+    }
+    return res->phase_counters[phase][counter];
+}
+
+
+// Returns short name of an SCP_COUNTER_* counter.
+const char *get_counter_name(int counter)
+{
+    static const char *names[] = { "cycles", "instructions", "llc_misses", "branch_misses",
+                                   "backend_stalls" };
+
+    return counter >= 0 && counter < SCP_NUM_COUNTERS ? names[counter] : "unknown";
+}
+
+
+// Returns 1 if backend (SCP_BACKEND_*) was built in and has a device, otherwise 0.
+int scp_backend_available(int backend)
+{
+#ifdef SCP_CUDA
+    if (backend == SCP_BACKEND_CUDA) return cuda_device_count() > 0;
+#endif
+    return backend == SCP_BACKEND_CPU;
+}
+
+
+// Returns short name of an SCP_STOP_* reason.
+const char *get_stop_reason_name(int reason)
+{
+    static const char *names[] = { "none", "max_itr", "optimal", "time", "target", "stall",
+                                   "line_search", "race", "gap" };
+
+    if (reason < 0 || reason >= sizeof(names) / sizeof(names[0])) return "unknown";
+    return names[reason];
+}
+
+
+/* Computes reduced costs of best dual vector of res. Columns of a presolved instance are
+reported by original index, removed columns are priced on the original instance.
+The reduced costs the last solve on inst left in the workspace are reused if the best dual
+vector differs from theirs in few rows. */
+void get_reduced_costs_r(const scp_instance *inst, const scp_result *res, double *reduced_costs)
+{
+    int i, j, row, col;
+    long long touched;
     double value;
-    for (i = 0; i < num_col; i++) {
-        value = costs[i];
-        for (j = col_wise_idx[i]; j < col_wise_idx[i+1]; j++) {
-            value -= best_dual_copy[col_wise_a[j]];
+    const double *best_dual = res->best_dual;
+    const scp_instance *parent = inst->parent;
+    const scp_workspace *ws = &res->ws;
+    const int *col_map = inst->col_map;
+
+    // float reduced costs of ws are not exact enough to be reported
+    touched = inst->num_nonzero;
+    if (sizeof(scp_real) == sizeof(double) && ws->rc_inst == inst
+        && ws->rc_fix_version == inst->fix_version) {
+        touched = 0;
+        for (i = 0; i < inst->num_row; i++) {
+            if (ws->rc_dual[i] != best_dual[i]) {
+                touched += inst->row_wise_idx[i+1] - inst->row_wise_idx[i];
+            }
+        }
+    }
+
+    if (2 * touched < inst->num_nonzero) {
+        // shift the rows in which the best dual vector differs
+        for (i = 0; i < inst->num_col; i++) {
+            reduced_costs[col_map ? col_map[i] : i] = ws->reduced_costs[i];
+        }
+        for (i = 0; i < inst->num_row; i++) {
+            value = best_dual[i] - ws->rc_dual[i];
+            if (value == 0.0) continue;
+            for (j = inst->row_wise_idx[i]; j < inst->row_wise_idx[i+1]; j++) {
+                col = ROW_AT(inst, j);
+                reduced_costs[col_map ? col_map[col] : col] -= value;
+            }
+        }
+    } else {
+        for (i = 0; i < inst->num_col; i++) {
+            value = COL_CALL(gather_exact, inst, i, best_dual, inst->costs[i]);
+            reduced_costs[col_map ? col_map[i] : i] = value;
+        }
+    }
+    if (parent == NULL) return;
+
+    for (i = 0; i < parent->num_col; i++) {
+        if (inst->col_index[i] >= 0) continue;
+        value = parent->costs[i];
+        for (j = parent->col_wise_idx[i]; j < parent->col_wise_idx[i+1]; j++) {
+            row = inst->row_index[COL_AT(parent, j)];
+            if (row >= 0) value -= best_dual[row];
         }
         reduced_costs[i] = value;
     }
 }
 
 
-int get_num_col() { return num_col; }
-int get_num_row() { return num_row; }
+/* Creates result handle sized for inst.
+Returns NULL on failure. */
+scp_result *create_scp_result(const scp_instance *inst)
+{
+    scp_result *res;
+
+    if ((res = (scp_result *) malloc(sizeof(scp_result))) == NULL) {
+        perror("Error malloc"); return NULL;
+    }
+    res->num_row = inst->num_row;
+    res->orig_num_row = get_num_row_r(inst);
+    res->row_map = inst->row_map;
+    res->best_obj = 0.0;
+    res->working_obj = 0.0;
+    res->num_itr = 0;
+    res->stop_reason = 0;
+    res->upper_bound = HUGE_VAL;
+    clear_phase_stats(res);
+    memset(&res->ws, 0, sizeof(scp_workspace));
+    if ((res->best_dual = (double *) calloc(inst->num_row > 0 ? inst->num_row : 1,
+                                            sizeof(double))) == NULL) {
+        perror("Error malloc"); free(res); return NULL;
+    }
+    return res;
+}
+
+
+void free_scp_result(scp_result *res)
+{
+    if (res == NULL) return;
+    free(res->best_dual);
+    free(res->ws.block);
+    free_heuristic(&res->ws.heur);
+    free_line_search(&res->ws.ls);
+#ifdef SCP_CUDA
+    free_scp_device(res->ws.dev);
+#endif
+    free(res);
+}
+
+
+/*** non-reentrant API on the process-wide instance ***/
+
+/* Installs inst as the process-wide instance.
+Returns 0 on success, otherwise returns -1. */
+static int set_global_instance(scp_instance *inst)
+{
+    if (inst == NULL) return -1;
+
+    free_scp_instance();
+    if ((global_res = create_scp_result(inst)) == NULL) {
+        free_scp_instance_r(inst);
+        return -1;
+    }
+    global_inst = inst;
+    return 0;
+}
+
+
+int load_scp_instance(char *filename)
+{
+    return set_global_instance(load_scp_instance_r(filename));
+}
+
+int load_scp_instance_mmap(char *filename)
+{
+    return set_global_instance(load_scp_instance_mmap_r(filename));
+}
+
+int load_scp_instance_bin(char *filename)
+{
+    return set_global_instance(load_scp_instance_bin_r(filename));
+}
+
+int write_scp_instance_bin(char *filename)
+{
+    return write_scp_instance_bin_r(global_inst, filename);
+}
+
+double spectral_projected_subgradient(int max_itr)
+{
+    return spectral_projected_subgradient_r(global_inst, global_res, max_itr);
+}
+
+double basic_subgradient(int max_itr, int upperbound)
+{
+    return basic_subgradient_r(global_inst, global_res, max_itr, upperbound);
+}
+
+double portfolio_subgradient(int max_itr, int upperbound)
+{
+    int num_configs;
+    scp_params base, configs[8];
+
+    init_scp_params(&base);
+    base.max_itr = max_itr;
+    base.upperbound = upperbound;
+    num_configs = init_scp_portfolio(&base, configs, 8);
+    return portfolio_subgradient_r(global_inst, global_res, configs, num_configs, NULL);
+}
+
+void get_dual_vector(double *dual) { get_dual_vector_r(global_res, dual); }
+
+void get_reduced_costs(double *reduced_costs)
+{
+    get_reduced_costs_r(global_inst, global_res, reduced_costs);
+}
+
+int get_num_col() { return get_num_col_r(global_inst); }
+int get_num_row() { return get_num_row_r(global_inst); }
+
+
+int presolve_scp_instance(scp_presolve_stats *stats)
+{
+    scp_instance *presolved;
+    scp_result *res;
+
+    if (global_inst == NULL) return -1;
+    if ((presolved = presolve_scp_instance_r(global_inst, stats)) == NULL) return -1;
+    if ((res = create_scp_result(presolved)) == NULL) {
+        free_scp_instance_r(presolved);
+        return -1;
+    }
+    free_scp_result(global_res);
+    global_res = res;
+    global_parent = global_inst;
+    global_inst = presolved;
+    return 0;
+}
 
 
 void free_scp_instance()
 {
-    free(costs);
-    free(col_wise_a);
-    free(col_wise_idx);
-    free(row_wise_a);
-    free(row_wise_idx);
-    free(col_sizes);
-    free(row_sizes);
-    free(best_dual_copy);
+    free_scp_result(global_res);
+    free_scp_instance_r(global_inst);
+    free_scp_instance_r(global_parent);
+    global_res = NULL;
+    global_inst = NULL;
+    global_parent = NULL;
 }
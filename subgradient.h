@@ -18,6 +18,19 @@ Naval Research Logistics, 37(1), 151–164."
 Returns 0 on success, otherwise returns -1. */
 int load_scp_instance(char *filename);
 
+/* Same as load_scp_instance, but maps the file into memory and scans it in place.
+Returns 0 on success, otherwise returns -1. */
+int load_scp_instance_mmap(char *filename);
+
+/* Maps binary SCP instance file (.scpb) written by write_scp_instance_bin.
+The constraint matrix is used in place (read-only, shareable between processes).
+Returns 0 on success, otherwise returns -1. */
+int load_scp_instance_bin(char *filename);
+
+/* Writes loaded SCP instance to binary file (.scpb).
+Returns 0 on success, otherwise returns -1. */
+int write_scp_instance_bin(char *filename);
+
 /* Spectral projected subgradient 
 Returns best (maximum) dual solution.
 Returns -1 on system failure. */
@@ -29,6 +42,12 @@ Returns best (maximum) dual solution
 Returns -1 on system failure */
 double basic_subgradient(int max_itr, int upperbound);
 
+/* Runs the default portfolio of SPS and BSM configurations concurrently,
+see portfolio_subgradient_r. BSM is included only if upperbound > 0.
+Returns best (maximum) dual solution, its dual vector is read with get_dual_vector.
+Returns -1 on system failure */
+double portfolio_subgradient(int max_itr, int upperbound);
+
 // Copies best dual vector to the input dual.
 void get_dual_vector(double *dual);
 
@@ -40,4 +59,393 @@ int get_num_row();
 
 void free_scp_instance();
 
+
+/*** reentrant API
+
+The functions above work on one process-wide instance. The _r variants below
+work on explicit handles instead: an scp_instance holds the (read-only) problem
+and an scp_result holds the outcome of a solve. Solves on different result
+handles may run concurrently, also when they share one instance.
+***/
+
+typedef struct scp_instance scp_instance;
+typedef struct scp_result scp_result;
+typedef struct scp_sps_state scp_sps_state;
+
+#define SCP_SPS     1   // spectral projected subgradient
+#define SCP_BSM     2   // basic subgradient
+
+/* Termination policy on top of max_itr, a solve returns as soon as one of the enabled
+criteria fires. Each criterion is disabled by its init_scp_params default. */
+typedef struct {
+    double time_limit;      // wall-clock budget of a solve in seconds, 0 = none
+    double target_bound;    // stop once the bound exceeds it, HUGE_VAL = none; with integer
+                            // costs and incumbent UB, UB - 1 stops as soon as the node prunes
+    int stall_itr;          // stop if the bound improved by less than stall_tol (relative)
+    double stall_tol;       // over the last stall_itr iterations, 0 = none
+    int max_halvings;       // SPS: stop if the line search of an iteration halves the step
+                            // more often (the step is kept as it is), 0 = none
+} scp_termination;
+
+// reasons for the end of a solve, see get_stop_reason_r
+#define SCP_STOP_MAX_ITR        1   // iteration limit
+#define SCP_STOP_OPTIMAL        2   // zero subgradient, the dual solution is optimal
+#define SCP_STOP_TIME           3   // time_limit
+#define SCP_STOP_TARGET         4   // target_bound
+#define SCP_STOP_STALL          5   // stall_itr / stall_tol
+#define SCP_STOP_LINE_SEARCH    6   // max_halvings
+#define SCP_STOP_RACE           7   // behind the other solves of a portfolio
+#define SCP_STOP_GAP            8   // bound rounds up to the cost of a heuristic cover
+
+/* State of a solve after one iteration, passed to the trace callback of scp_params. */
+typedef struct {
+    int itr;
+    double curr_obj;        // bound of the current dual vector
+    double best_obj;        // best bound so far
+    double step;            // SPS: spectral step length alpha, BSM: step size
+    double tau;             // SPS: step fraction accepted by the line search, BSM: 1
+    int dd_size;            // rows whose dual moved
+    double subg_norm;       // norm of the subgradient the step was taken along
+} scp_trace_info;
+
+typedef void (*scp_trace_fn)(const scp_trace_info *info, void *data);
+
+// phases of an iteration, see get_phase_time_r
+#define SCP_PHASE_DUAL          0   // dual vector update
+#define SCP_PHASE_OBJECTIVE     1   // reduced costs and objective value of the step
+#define SCP_PHASE_LINE_SEARCH   2   // SPS: line search (halvings or breakpoint sweep)
+#define SCP_PHASE_SUBGRADIENT   3   // subgradient vector
+#define SCP_PHASE_BOOKKEEPING   4   // best solution, termination, alpha and worst_obj
+#define SCP_PHASE_HEURISTIC     5   // Lagrangian heuristic
+#define SCP_PHASE_PRICING       6   // core_subgradient_r: pricing all columns, core rebuild
+#define SCP_PHASE_INIT          7   // initial dual vector and its reduced costs
+#define SCP_NUM_PHASES          8
+
+// hardware counters of a phase, see get_phase_counter_r
+#define SCP_COUNTER_CYCLES          0
+#define SCP_COUNTER_INSTRUCTIONS    1
+#define SCP_COUNTER_LLC_MISSES      2   // last level cache misses (the generic cache-misses)
+#define SCP_COUNTER_BRANCH_MISSES   3
+#define SCP_COUNTER_BACKEND_STALLS  4   // cycles stalled in the backend, mostly on memory
+#define SCP_NUM_COUNTERS            5
+
+/* Solver parameters. Set defaults with init_scp_params, then override fields. */
+typedef struct {
+    int max_itr;            // iteration limit
+    int upperbound;         // upperbound of the SCP optimum, used by basic subgradient step size;
+                            // 0 = BSM finds one with the Lagrangian heuristic
+    int num_threads;        // threads of the iteration kernels, 1 = serial, 0 = all available
+    int deterministic;      // sums in fixed blocks: results bit-identical for any num_threads
+    int method;             // SCP_SPS or SCP_BSM, solver of a portfolio entry
+    int sps_memory;         // SPS: number of past objective values of the non-monotone line search
+    double sps_momentum;    // SPS: weight of the previous step in the momentum term
+    double sps_gamma;       // SPS: sufficient increase factor of the line search
+    double sps_alpha;       // SPS: initial (and fallback) spectral step length
+    int sps_line_search;    // SPS: SCP_LS_HALVING or SCP_LS_BREAKPOINTS
+    double bsm_lambda;      // BSM: initial step size factor
+    int bsm_patience;       // BSM: iterations without improvement before lambda is halved
+    int heur_interval;      // iterations between runs of the Lagrangian heuristic, whose covers
+                            // stop the solve once the bound rounds up to them, 0 = none (BSM
+                            // without upperbound then runs it every SCP_HEUR_INTERVAL)
+    int core_size;          // core_subgradient_r: cheapest columns of each row in the core
+    int core_interval;      // core_subgradient_r: iterations between pricings of all columns
+    scp_termination term;   // early termination
+    scp_trace_fn trace;     // called after every iteration with trace_data if not NULL
+    void *trace_data;
+    int phase_timers;       // accumulate wall time per phase (SCP_PHASE_*) in the result
+    int phase_counters;     // with phase_timers, also hardware counters (SCP_COUNTER_*) per
+                            // phase, Linux perf_event_open on the solving thread, CPU SPS/BSM
+    int backend;            // SCP_BACKEND_CPU or SCP_BACKEND_CUDA, device of the iterations
+} scp_params;
+
+#define SCP_HEUR_INTERVAL   10
+
+// line search modes of SPS, both take the largest tau = 2^-k that passes the accept test
+#define SCP_LS_HALVING      0   // halve tau and shift the reduced costs until accepted
+#define SCP_LS_BREAKPOINTS  1   // sweep the sorted sign changes of the reduced costs along
+                                // dd once, then shift to the chosen tau
+
+/* Backends of the SPS and BSM iterations. SCP_BACKEND_CUDA (built with make CUDA=1) keeps
+the matrix and the working vectors in GPU memory for the whole solve, which pays off on
+instances with millions of nonzeros; the breakpoint line search then runs as halving and
+num_threads is ignored. Results are the same handles and units as on the CPU. */
+#define SCP_BACKEND_CPU     0
+#define SCP_BACKEND_CUDA    1
+
+void init_scp_params(scp_params *params);
+
+// Returns 1 if backend (SCP_BACKEND_*) was built in and has a device, otherwise 0.
+int scp_backend_available(int backend);
+
+/* Loaders, same formats as above.
+Return new instance, or NULL on failure. */
+scp_instance *load_scp_instance_r(const char *filename);
+scp_instance *load_scp_instance_mmap_r(const char *filename);
+scp_instance *load_scp_instance_bin_r(const char *filename);
+/* Same as load_scp_instance_mmap_r, but reads the instance straight into the compact layout
+(see compact_scp_instance_r), so the int index arrays that it replaces are never built. */
+scp_instance *load_scp_instance_compact_r(const char *filename);
+
+/* Writes instance to binary file (.scpb).
+Returns 0 on success, otherwise returns -1. */
+int write_scp_instance_bin_r(const scp_instance *inst, const char *filename);
+
+/* Switches inst to the compact layout: the redundant size arrays are dropped, and the
+index arrays whose range fits in 16 bits (at most 65536 rows or columns) are replaced by
+16-bit ones, which halves their memory and the index traffic of the iterations. All readers
+(heuristic, presolve, fixing, file writer) take either width. The int arrays of an instance
+mapped from a .scpb file stay mapped next to the 16-bit ones.
+Returns 0 on success, otherwise returns -1. */
+int compact_scp_instance_r(scp_instance *inst);
+
+int get_num_col_r(const scp_instance *inst);
+int get_num_row_r(const scp_instance *inst);
+int get_num_nonzero_r(const scp_instance *inst);
+
+void free_scp_instance_r(scp_instance *inst);
+
+/* Creates result handle sized for inst. The handle also keeps the working buffers of the
+solvers, allocated by its first solve and reused by the next ones, so repeated solves on
+one handle (as in branch and bound) do not allocate.
+Returns NULL on failure. */
+scp_result *create_scp_result(const scp_instance *inst);
+
+void free_scp_result(scp_result *res);
+
+/* Spectral projected subgradient on inst, best dual vector is stored in res.
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double spectral_projected_subgradient_r(const scp_instance *inst, scp_result *res, int max_itr);
+
+/* Beasley's subgradient method on inst, best dual vector is stored in res.
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double basic_subgradient_r(const scp_instance *inst, scp_result *res, int max_itr, int upperbound);
+
+/* Same as the _r variants above, with all settings taken from params.
+With num_threads > 1, the per-iteration work is split over OpenMP threads. The sums of the
+objective, the line search and the step length then depend on the number of threads,
+unless deterministic is set: they are then taken over fixed blocks of rows and columns in
+a fixed order, so that the results of the CPU backend only depend on the input (and the
+SCP_SIMD kernel variant), at the cost of one more pass over the dual vector per sum.
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double spectral_projected_subgradient_ex(const scp_instance *inst, scp_result *res,
+                                         const scp_params *params);
+double basic_subgradient_ex(const scp_instance *inst, scp_result *res, const scp_params *params);
+
+/* Warm starts: the solve begins at init_dual (negative entries are raised to 0) instead of
+the min(cost/size) heuristic; init_dual = NULL gives the cold start of the _ex variants.
+If state is not NULL, SPS also continues from the momentum, step length and line search
+history saved in it by the previous solve (ignored while empty or if it was created for
+a different number of rows or sps_memory), and saves its own final state there.
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double spectral_projected_subgradient_warm(const scp_instance *inst, scp_result *res,
+                                           const scp_params *params, const double *init_dual,
+                                           scp_sps_state *state);
+double basic_subgradient_warm(const scp_instance *inst, scp_result *res, const scp_params *params,
+                              const double *init_dual);
+
+/* Creates empty SPS state for warm starts on inst with params->sps_memory.
+Returns NULL on failure. */
+scp_sps_state *create_scp_sps_state(const scp_instance *inst, const scp_params *params);
+
+void free_scp_sps_state(scp_sps_state *state);
+
+/* Fills configs with the default portfolio derived from base: SPS with several
+momentum/line search settings and, if base->upperbound > 0, BSM with two step sizes.
+Returns number of configurations (at most max_configs). */
+int init_scp_portfolio(const scp_params *base, scp_params *configs, int max_configs);
+
+/* Runs the configurations configs[0..num_configs) on separate threads against inst.
+The solves share the best bound found so far; a solve stops once it cannot catch up
+with it at its recent rate of progress, and all stop when one proves optimality.
+Best dual vector of all is stored in res, the index of its configuration in winner
+(if not NULL).
+Returns best (maximum) dual solution.
+Returns -1 on system failure. */
+double portfolio_subgradient_r(const scp_instance *inst, scp_result *res,
+                               const scp_params *configs, int num_configs, int *winner);
+
+/*** column fixing (branch-and-bound)
+
+Fixing a column to 0 removes it, fixing it to 1 pays its cost and removes the rows it
+covers. Solves on a fixed instance work on the remaining subproblem: fixed columns never
+enter the Lagrangian solution (get_reduced_costs_r reports huge reduced costs for
+them), duals of covered rows stay 0, and the bound includes the cost of the columns
+fixed to 1. A subproblem with an uncoverable row gets a huge bound, so it is pruned.
+Fixing and undoing must not overlap with solves on the same instance.
+***/
+
+#define SCP_FIX_0   1
+#define SCP_FIX_1   2
+
+/* Fixes column col of inst to 0 (value = SCP_FIX_0) or 1 (value = SCP_FIX_1). A presolved
+instance can only be fixed if it comes from presolve_scp_instance_fixable_r.
+Returns 0 on success, otherwise returns -1 (bad column or value, already fixed, or column
+reductions of presolve). */
+int fix_scp_column_r(scp_instance *inst, int col, int value);
+
+// Undoes the latest fixings of inst until num_fixed fixings remain.
+void undo_scp_fixes_r(scp_instance *inst, int num_fixed);
+
+// Returns number of fixed columns of inst (the depth to pass to undo_scp_fixes_r).
+int get_num_fixed_r(const scp_instance *inst);
+
+/*** presolve
+
+Reduces an instance before solving: rows with a single column force that column to 1,
+columns whose rows can be covered more cheaply by other columns (or that are contained
+in a column of lower cost) are removed, and rows containing another row are removed.
+The presolved instance solves like any other, its bounds include the cost of the forced
+columns, and results are reported in the indices of the original instance: removed rows
+get a 0 dual, get_reduced_costs_r returns original columns.
+The column reductions are only valid for the instance as given, since a column removed
+in favour of another one may be needed once that one is fixed to 0. So instances to be
+fixed in branch and bound come from presolve_scp_instance_fixable_r, which only removes
+dominated rows and keeps all columns, and fix_scp_column_r takes original columns there;
+fix_scp_column_r rejects the instances of presolve_scp_instance_r.
+The original instance must stay loaded and unchanged while the presolved one is in use.
+***/
+
+typedef struct {
+    int orig_num_row, orig_num_col, orig_num_nonzero;
+    int num_row, num_col, num_nonzero;      // after presolve
+    int forced_cols;            // columns fixed to 1 by singleton rows
+    int dominated_cols;         // columns removed by dominance
+    int dominated_rows;         // rows removed by dominance
+    int empty_cols;             // columns left without rows
+    int rounds;                 // passes over all reductions
+    int work_limit_hit;         // pairwise dominance checks stopped early
+    double fixed_cost;          // cost of the forced columns
+    double time;                // seconds
+} scp_presolve_stats;
+
+/* Creates presolved copy of inst, which must not be fixed or presolved already. Reduction
+statistics are stored in stats (if not NULL).
+Returns NULL on failure or if presolve proves inst infeasible. */
+scp_instance *presolve_scp_instance_r(const scp_instance *inst, scp_presolve_stats *stats);
+
+/* Creates presolved copy of inst with dominated rows removed only, which can be fixed like
+inst itself. Arguments and return value as for presolve_scp_instance_r. */
+scp_instance *presolve_scp_instance_fixable_r(const scp_instance *inst,
+                                              scp_presolve_stats *stats);
+
+/* Replaces the process-wide instance by its presolved copy, the original is kept until
+free_scp_instance.
+Returns 0 on success, otherwise returns -1. */
+int presolve_scp_instance(scp_presolve_stats *stats);
+
+/*** reordering
+
+Renumbers rows and columns of an instance by reverse Cuthill-McKee on its row-column
+graph, so that rows sharing columns (and columns sharing rows) get close indices and the
+scatters of each iteration stay within fewer cache lines. Like a presolved instance, the
+reordered one reports results in the indices of the instance it was made from, which
+must stay loaded. Presolve, if any, comes first.
+***/
+
+typedef struct {
+    double row_span_before;     // average distance of first and last column of a row
+    double row_span_after;
+    double col_span_before;     // average distance of first and last row of a column
+    double col_span_after;
+    double time;                // seconds
+} scp_reorder_stats;
+
+/* Creates reordered copy of inst, which must not be fixed. Locality statistics are stored
+in stats (if not NULL).
+Returns NULL on failure. */
+scp_instance *reorder_scp_instance_r(const scp_instance *inst, scp_reorder_stats *stats);
+
+/*** core problem
+
+On instances with many more columns than rows, most columns keep large reduced costs and
+never enter the Lagrangian solution. A core problem solve iterates on the core_size
+columns of lowest reduced cost of each row (plus those with negative reduced cost), and
+every core_interval iterations prices all columns of the instance against the best dual
+vector of the core, which gives a bound of the full instance and the next core. Results
+are those of the full instance, as in a solve of the _ex variants.
+***/
+
+typedef struct {
+    int rounds;                 // core solves, each followed by a pricing
+    int core_cols;              // columns of the last core
+    int max_core_cols;          // columns of the largest core
+    int num_col;                // columns of the instance
+    double time;                // seconds spent pricing and building cores
+} scp_core_stats;
+
+/* Runs params->method (SCP_SPS or SCP_BSM) on core problems of inst, which must not be
+fixed. Core statistics are stored in stats (if not NULL).
+Returns best (maximum) dual solution of inst.
+Returns -1 on system failure. */
+double core_subgradient_r(const scp_instance *inst, scp_result *res, const scp_params *params,
+                          scp_core_stats *stats);
+
+/*** batched solves
+
+Several solves on one instance (multi-start, the step sizes of a portfolio, warm starts of
+the sibling nodes of a branch) can run in lockstep, so that each pass of an iteration over
+the constraint matrix serves all of them: their dual vectors, reduced costs and
+subgradients are stored interleaved, and a pass reads each index once for all lanes. The
+time per solve drops with the number of lanes until the arithmetic of the lanes, rather
+than the index traffic, bounds a pass. The lanes share the fixings of the instance.
+***/
+
+/* Runs basic subgradient on num_lanes lanes in lockstep, lane k with the settings of
+params[k] (max_itr, upperbound, bsm_lambda, bsm_patience, heur_interval, term) from
+init_duals[k] (cold start if init_duals or init_duals[k] is NULL), its best dual vector
+stored in res[k] and its bound in bounds[k]. The kernels read the int index arrays
+and recompute all reduced costs each iteration, so the lanes are not bit-identical to
+basic_subgradient_warm; num_threads is that of params[0], the trace, phase timers and
+backend settings are ignored.
+Returns 0 on success, otherwise returns -1. */
+int basic_subgradient_multi(const scp_instance *inst, scp_result *const *res,
+                            const scp_params *params, const double *const *init_duals,
+                            int num_lanes, double *bounds);
+
+// Copies best dual vector of res to the input dual.
+void get_dual_vector_r(const scp_result *res, double *dual);
+
+// Returns number of iterations of the last solve on res.
+int get_num_itr_r(const scp_result *res);
+
+/* Returns cost of the best cover found by the Lagrangian heuristic in the last solve on res
+(including forced and fixed columns), HUGE_VAL if the heuristic did not run. */
+double get_upper_bound_r(const scp_result *res);
+
+/* Returns best bound of the last solve on res as its iterations tracked it. Built with float
+working vectors (make FLOAT=-DSCP_FLOAT), the returned bound of a solve is instead
+recomputed in double from its dual vector, and the two differ by the rounding of the
+iterations; otherwise they are equal. */
+double get_working_bound_r(const scp_result *res);
+
+// Returns why the last solve on res ended (SCP_STOP_*), 0 if nothing was solved yet.
+int get_stop_reason_r(const scp_result *res);
+
+// Returns short name of an SCP_STOP_* reason ("max_itr", "optimal", "time", ...).
+const char *get_stop_reason_name(int reason);
+
+/* Returns wall time in seconds spent in phase (SCP_PHASE_*) by the last solve on res,
+0 unless it ran with phase_timers. */
+double get_phase_time_r(const scp_result *res, int phase);
+
+// Returns short name of an SCP_PHASE_* phase ("dual", "objective", ...).
+const char *get_phase_name(int phase);
+
+/* Returns count of counter (SCP_COUNTER_*) in phase by the last solve on res, -1 unless it
+ran with phase_counters and the event could be opened (on Linux, with a PMU the kernel
+lets user space count, see perf_event_paranoid). Only the calling thread is counted, so
+with num_threads > 1 the OpenMP workers are missing. */
+long long get_phase_counter_r(const scp_result *res, int phase, int counter);
+
+// Returns short name of an SCP_COUNTER_* counter ("cycles", "instructions", ...).
+const char *get_counter_name(int counter);
+
+/* Computes reduced costs of best dual vector of res, from the reduced costs left by the
+last solve if inst was not fixed or undone since. */
+void get_reduced_costs_r(const scp_instance *inst, const scp_result *res, double *reduced_costs);
+
 #endif /* Subgradient_h */